@@ -0,0 +1,71 @@
+/**
+ * HF Workshop - AMF3 byte arrays
+ */
+
+#include "amf_byte_array.hpp"
+
+#include <json.hpp>
+
+#include "amf3.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		constexpr uint8_t NULL_MARKER = 0x01;
+
+		/// Reads a U29 at `data[pos]`, returning false if it's cut short
+		bool readU29(const vector<uint8_t> &data, size_t &pos, uint32_t &value) {
+			value = 0;
+			for (int i = 0; i < 4; ++i) {
+				if (pos >= data.size()) {
+					return false;
+				}
+				uint8_t b = data[pos++];
+				if (i == 3) {
+					value = (value << 8) | b;
+					return true;
+				}
+				value = (value << 7) | (b & 0x7F);
+				if ((b & 0x80) == 0) {
+					return true;
+				}
+			}
+			return true;
+		}
+
+	} // anonymous namespace
+
+	AmfByteArrayReader::AmfByteArrayReader() : decoded() {}
+
+	AmfByteArrayReader::~AmfByteArrayReader() = default;
+
+	bool AmfByteArrayReader::next(const vector<uint8_t> &data, size_t &pos, const uint8_t *&bytes, size_t &length) {
+		if (pos < data.size() && data[pos] == swf::AMF3::BYTE_ARRAY_MARKER) {
+			size_t p = pos + 1;
+			uint32_t u;
+			// Inline, not a reference, and complete
+			if (readU29(data, p, u) && (u & 1) != 0 && (u >> 1) <= data.size() - p) {
+				bytes = data.data() + p;
+				length = u >> 1;
+				pos = p + length;
+				return true;
+			}
+		} else if (pos < data.size() && data[pos] == NULL_MARKER) {
+			++pos;
+			return false;
+		}
+
+		decoded = make_unique<swf::AMF3>(data.data(), pos);
+		if (decoded->object->type != swf::AMF3::BYTE_ARRAY_MARKER) {
+			return false;
+		}
+		auto ba = static_cast<swf::AMF3_BYTEARRAY *>(decoded->object.get());
+		bytes = ba->binaryData.data();
+		length = ba->binaryData.size();
+		return true;
+	}
+
+} // hf_workshop
@@ -0,0 +1,48 @@
+/**
+ * HF Workshop - AMF3 byte arrays
+ *
+ * Reads the AMF3 byte arrays that hold the objects of a data file, without
+ * copying them out of the file.
+ */
+
+#ifndef AMF_BYTE_ARRAY_HPP
+#define AMF_BYTE_ARRAY_HPP
+
+#include <memory>  // unique_ptr
+#include <vector>
+#include <cstdint> // uint8_t
+#include <cstddef> // size_t
+
+namespace swf {
+	class AMF3;
+}
+
+namespace hf_workshop {
+
+	/**
+	 * Reads the AMF3 values of a data file that should be byte arrays.
+	 * Byte arrays written inline, which is all of them in the game files,
+	 * are read in place; anything else is decoded by libswf.
+	 */
+	class AmfByteArrayReader {
+	public:
+		AmfByteArrayReader();
+		~AmfByteArrayReader();
+		AmfByteArrayReader(const AmfByteArrayReader &) = delete;
+		AmfByteArrayReader &operator=(const AmfByteArrayReader &) = delete;
+
+		/**
+		 * Reads the AMF3 value at `data[pos]` and moves `pos` past it.
+		 * Returns true if it is a byte array, pointing `bytes` to its contents,
+		 * which stay valid until the next call or until `data` changes.
+		 */
+		bool next(const std::vector<uint8_t> &data, size_t &pos, const uint8_t *&bytes, size_t &length);
+
+	private:
+		/// The last value decoded by libswf
+		std::unique_ptr<swf::AMF3> decoded;
+	};
+
+} // hf_workshop
+
+#endif // AMF_BYTE_ARRAY_HPP
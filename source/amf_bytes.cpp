@@ -0,0 +1,117 @@
+/**
+ * HF Workshop - AMF bytes
+ */
+
+#include "amf_bytes.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace amf_bytes {
+
+		void writeU29(vector<uint8_t> &out, uint32_t n) {
+			if (n < 0x80) {
+				out.emplace_back(static_cast<uint8_t>(n));
+			} else if (n < 0x4000) {
+				out.emplace_back(static_cast<uint8_t>((n >> 7) | 0x80));
+				out.emplace_back(static_cast<uint8_t>(n & 0x7F));
+			} else if (n < 0x200000) {
+				out.emplace_back(static_cast<uint8_t>((n >> 14) | 0x80));
+				out.emplace_back(static_cast<uint8_t>(((n >> 7) & 0x7F) | 0x80));
+				out.emplace_back(static_cast<uint8_t>(n & 0x7F));
+			} else if (n < 0x20000000) {
+				out.emplace_back(static_cast<uint8_t>((n >> 22) | 0x80));
+				out.emplace_back(static_cast<uint8_t>(((n >> 15) & 0x7F) | 0x80));
+				out.emplace_back(static_cast<uint8_t>(((n >> 8) & 0x7F) | 0x80));
+				out.emplace_back(static_cast<uint8_t>(n));
+			} else {
+				throw runtime_error("Value is too large for AMF3.");
+			}
+		}
+
+		void skipAmf0(Reader &r, int depth) {
+			if (depth > MAX_DEPTH) {
+				throw runtime_error("AMF0 value is nested too deeply.");
+			}
+			uint8_t marker = r.u8();
+			switch (marker) {
+				case amf0::NUMBER:
+					r.bytes(8);
+					break;
+				case amf0::BOOLEAN:
+					r.bytes(1);
+					break;
+				case amf0::STRING:
+					r.bytes(r.be(2));
+					break;
+				case amf0::LONG_STRING:
+				case amf0::XML_DOCUMENT:
+					r.bytes(r.be(4));
+					break;
+				case amf0::NULL_MARKER:
+				case amf0::UNDEFINED:
+					break;
+				case amf0::REFERENCE:
+					r.bytes(2);
+					break;
+				case amf0::DATE:
+					r.bytes(10);
+					break;
+				case amf0::STRICT_ARRAY:
+					for (uint32_t i = 0, n = r.be(4); i < n; ++i) {
+						skipAmf0(r, depth + 1);
+					}
+					break;
+				case amf0::TYPED_OBJECT:
+					r.bytes(r.be(2));
+					[[fallthrough]];
+				case amf0::ECMA_ARRAY:
+					if (marker == amf0::ECMA_ARRAY) {
+						r.bytes(4);
+					}
+					[[fallthrough]];
+				case amf0::OBJECT:
+					for (size_t len = r.be(2); ; len = r.be(2)) {
+						if (len == 0 && r.u8() == amf0::OBJECT_END) {
+							break;
+						} else if (len == 0) {
+							throw runtime_error("Empty AMF0 property name.");
+						}
+						r.bytes(len);
+						skipAmf0(r, depth + 1);
+					}
+					break;
+				default:
+					throw runtime_error("Unsupported AMF0 marker " + to_string(marker) + ".");
+			}
+		}
+
+		vector<pair<string_view, size_t>> amf0Properties(Reader &r, int depth) {
+			vector<pair<string_view, size_t>> properties;
+			for (size_t len = r.be(2); ; len = r.be(2)) {
+				if (len == 0) {
+					if (r.u8() != amf0::OBJECT_END) {
+						throw runtime_error("Empty AMF0 property name.");
+					}
+					break;
+				}
+				std::string_view name = r.str(len);
+				properties.emplace_back(name, r.pos);
+				skipAmf0(r, depth + 1);
+			}
+			return properties;
+		}
+
+		bool ordinalKeys(const vector<pair<string_view, size_t>> &properties) {
+			for (size_t i = 0; i < properties.size(); ++i) {
+				if (properties[i].first != to_string(i)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+	} // amf_bytes
+
+} // hf_workshop
@@ -0,0 +1,202 @@
+/**
+ * HF Workshop - AMF bytes
+ *
+ * Markers, bounds-checked reads and writes shared by the code that works
+ * on serialized AMF0 and AMF3 directly.
+ */
+
+#ifndef AMF_BYTES_HPP
+#define AMF_BYTES_HPP
+
+#include <string>
+#include <string_view>
+#include <stdexcept> // runtime_error
+#include <utility>   // pair
+#include <vector>
+#include <cstdint>   // uint8_t, uint32_t, uint64_t
+#include <cstddef>   // size_t
+#include <cstring>   // memcpy
+#include <cmath>     // isfinite, fpclassify, signbit, trunc
+
+namespace hf_workshop {
+
+	namespace amf_bytes {
+
+		namespace amf0 {
+			constexpr uint8_t NUMBER = 0x00;
+			constexpr uint8_t BOOLEAN = 0x01;
+			constexpr uint8_t STRING = 0x02;
+			constexpr uint8_t OBJECT = 0x03;
+			constexpr uint8_t NULL_MARKER = 0x05;
+			constexpr uint8_t UNDEFINED = 0x06;
+			constexpr uint8_t REFERENCE = 0x07;
+			constexpr uint8_t ECMA_ARRAY = 0x08;
+			constexpr uint8_t OBJECT_END = 0x09;
+			constexpr uint8_t STRICT_ARRAY = 0x0A;
+			constexpr uint8_t DATE = 0x0B;
+			constexpr uint8_t LONG_STRING = 0x0C;
+			constexpr uint8_t XML_DOCUMENT = 0x0F;
+			constexpr uint8_t TYPED_OBJECT = 0x10;
+		}
+
+		namespace amf3 {
+			constexpr uint8_t UNDEFINED = 0x00;
+			constexpr uint8_t NULL_MARKER = 0x01;
+			constexpr uint8_t FALSE_MARKER = 0x02;
+			constexpr uint8_t TRUE_MARKER = 0x03;
+			constexpr uint8_t INTEGER = 0x04;
+			constexpr uint8_t DOUBLE = 0x05;
+			constexpr uint8_t STRING = 0x06;
+			constexpr uint8_t XML_DOC = 0x07;
+			constexpr uint8_t DATE = 0x08;
+			constexpr uint8_t ARRAY = 0x09;
+			constexpr uint8_t OBJECT = 0x0A;
+			constexpr uint8_t XML = 0x0B;
+			constexpr uint8_t BYTE_ARRAY = 0x0C;
+
+			constexpr uint8_t EMPTY_STRING = 0x01;
+
+			constexpr long long INT_MIN_29 = -(1 << 28);
+			constexpr long long INT_MAX_29 = (1 << 28) - 1;
+			constexpr size_t MAX_LENGTH = (1 << 28) - 1;
+		}
+
+		constexpr int MAX_DEPTH = 1024;
+
+		/// True if `d` is written as an AMF3 integer: integral, 29 bits and not -0
+		inline bool isAmf3Integer(double d) {
+			return std::isfinite(d) && std::fpclassify(d - std::trunc(d)) == FP_ZERO &&
+			       !(std::fpclassify(d) == FP_ZERO && std::signbit(d)) &&
+			       d >= static_cast<double>(amf3::INT_MIN_29) && d <= static_cast<double>(amf3::INT_MAX_29);
+		}
+
+		/// Bounds-checked big-endian reads
+		class Reader {
+		public:
+			Reader(const uint8_t *_data, size_t _size, size_t _pos) : data(_data), size(_size), pos(_pos) {}
+			Reader(const Reader &) = delete;
+			Reader &operator=(const Reader &) = delete;
+
+			const uint8_t *data;
+			size_t size;
+			size_t pos;
+
+			void need(size_t bytes) const {
+				if (pos > size || size - pos < bytes) {
+					throw std::runtime_error("AMF value is truncated.");
+				}
+			}
+
+			uint8_t u8() {
+				need(1);
+				return data[pos++];
+			}
+
+			uint32_t be(size_t bytes) {
+				need(bytes);
+				uint32_t n = 0;
+				for (size_t i = 0; i < bytes; ++i) {
+					n = (n << 8) | data[pos++];
+				}
+				return n;
+			}
+
+			const uint8_t *bytes(size_t n) {
+				need(n);
+				const uint8_t *p = data + pos;
+				pos += n;
+				return p;
+			}
+
+			std::string_view str(size_t n) {
+				return std::string_view(reinterpret_cast<const char *>(bytes(n)), n);
+			}
+
+			double number() {
+				need(8);
+				uint64_t bits = 0;
+				for (int i = 0; i < 8; ++i) {
+					bits = (bits << 8) | data[pos++];
+				}
+				double d;
+				std::memcpy(&d, &bits, sizeof(d));
+				return d;
+			}
+
+			uint32_t u29() {
+				uint32_t value = 0;
+				for (int i = 0; i < 4; ++i) {
+					uint8_t b = u8();
+					if (i == 3) {
+						return (value << 8) | b;
+					}
+					value = (value << 7) | (b & 0x7F);
+					if ((b & 0x80) == 0) {
+						break;
+					}
+				}
+				return value;
+			}
+
+			/**
+			 * Contents of the inline AMF3 byte array at `pos`.
+			 * Throws std::runtime_error if there is none.
+			 */
+			std::string_view byteArray() {
+				if (u8() != amf3::BYTE_ARRAY) {
+					throw std::runtime_error("Element is not inside an AMF3 ByteArray.");
+				}
+				uint32_t u = u29();
+				if ((u & 1) == 0) {
+					throw std::runtime_error("Element is a reference to another ByteArray.");
+				}
+				return str(u >> 1);
+			}
+		};
+
+		inline void writeBe(std::vector<uint8_t> &out, uint32_t n, size_t bytes) {
+			for (size_t i = bytes; i-- > 0; ) {
+				out.emplace_back(static_cast<uint8_t>(n >> (8 * i)));
+			}
+		}
+
+		inline void writeBytes(std::vector<uint8_t> &out, std::string_view s) {
+			const auto *p = reinterpret_cast<const uint8_t *>(s.data());
+			out.insert(out.end(), p, p + s.size());
+		}
+
+		inline void writeDouble(std::vector<uint8_t> &out, double d) {
+			uint64_t bits;
+			std::memcpy(&bits, &d, sizeof(bits));
+			for (int shift = 56; shift >= 0; shift -= 8) {
+				out.emplace_back(static_cast<uint8_t>(bits >> shift));
+			}
+		}
+
+		void writeU29(std::vector<uint8_t> &out, uint32_t n);
+
+		/// Position right after the AMF0 value at `r.pos`
+		void skipAmf0(Reader &r, int depth);
+
+		/**
+		 * Reads the properties of an AMF0 object or ECMA array, returning
+		 * their names and the positions of their values. The reader is left
+		 * after the object end marker.
+		 */
+		std::vector<std::pair<std::string_view, size_t>> amf0Properties(Reader &r, int depth);
+
+		/// True for "0", "1", ... "n-1"
+		bool ordinalKeys(const std::vector<std::pair<std::string_view, size_t>> &properties);
+
+		/// Wraps `amf` in an inline AMF3 byte array
+		inline void writeByteArray(std::vector<uint8_t> &out, const std::vector<uint8_t> &amf) {
+			out.emplace_back(amf3::BYTE_ARRAY);
+			writeU29(out, static_cast<uint32_t>((amf.size() << 1) | 1));
+			out.insert(out.end(), amf.begin(), amf.end());
+		}
+
+	} // amf_bytes
+
+} // hf_workshop
+
+#endif // AMF_BYTES_HPP
@@ -0,0 +1,445 @@
+/**
+ * HF Workshop - AMF to JSON
+ */
+
+#include "amf_json.hpp"
+
+#include <charconv>  // to_chars
+#include <cmath>     // isfinite, fpclassify, signbit
+#include <cstring>   // memcpy
+#include <utility>   // move
+
+#include <json.hpp>
+
+#include "amf0.hpp"
+#include "amf3.hpp"
+#include "text_scan.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		/// Thrown by AmfJsonWriter for anything it doesn't support
+		struct Unsupported {};
+
+		constexpr int MAX_DEPTH = 256;
+
+		namespace amf0 {
+			constexpr uint8_t NUMBER = 0x00;
+			constexpr uint8_t BOOLEAN = 0x01;
+			constexpr uint8_t STRING = 0x02;
+			constexpr uint8_t OBJECT = 0x03;
+			constexpr uint8_t NULL_MARKER = 0x05;
+			constexpr uint8_t OBJECT_END = 0x09;
+			constexpr uint8_t STRICT_ARRAY = 0x0A;
+			constexpr uint8_t LONG_STRING = 0x0C;
+		}
+
+		namespace amf3 {
+			constexpr uint8_t NULL_MARKER = 0x01;
+			constexpr uint8_t FALSE_MARKER = 0x02;
+			constexpr uint8_t TRUE_MARKER = 0x03;
+			constexpr uint8_t INTEGER = 0x04;
+			constexpr uint8_t DOUBLE = 0x05;
+			constexpr uint8_t STRING = 0x06;
+			constexpr uint8_t ARRAY = 0x09;
+			constexpr uint8_t OBJECT = 0x0A;
+		}
+
+	} // anonymous namespace
+
+	AmfJsonWriter::AmfJsonWriter() : data(nullptr), size(0), pos(0), out(nullptr),
+	                                 arenaBuffer(ARENA_SIZE),
+	                                 arena(arenaBuffer.data(), arenaBuffer.size()),
+	                                 strings(&arena), traits(&arena) {}
+
+	AmfJsonWriter::~AmfJsonWriter() = default;
+
+	bool AmfJsonWriter::writeAmf0(const uint8_t *_data, size_t _size, std::string &_out) {
+		begin(_data, _size, 0, _out);
+		try {
+			amf0Value(0);
+		} catch (const Unsupported &) {
+			return false;
+		}
+		return true;
+	}
+
+	bool AmfJsonWriter::writeAmf3(const uint8_t *_data, size_t _size, size_t &_pos, std::string &_out) {
+		begin(_data, _size, _pos, _out);
+		try {
+			amf3Value(0);
+		} catch (const Unsupported &) {
+			return false;
+		}
+		_pos = pos;
+		return true;
+	}
+
+	void AmfJsonWriter::begin(const uint8_t *_data, size_t _size, size_t _pos, std::string &_out) {
+		data = _data;
+		size = _size;
+		pos = _pos;
+		out = &_out;
+		out->clear();
+		strings.clear();
+		traits.clear();
+	}
+
+	void AmfJsonWriter::releaseMemory() {
+		// Nothing may point into the arena once it's released
+		strings = std::pmr::vector<string_view>(&arena);
+		traits = std::pmr::vector<Traits>(&arena);
+		arena.release();
+	}
+
+	void AmfJsonWriter::need(size_t bytes) {
+		if (pos > size || size - pos < bytes) {
+			throw Unsupported();
+		}
+	}
+
+	/*
+	 * Same layout as nlohmann::json::dump(4): "{\n    \"key\": value,\n...\n}"
+	 */
+	void AmfJsonWriter::newline(int depth) {
+		out->push_back('\n');
+		out->append(INDENT * static_cast<size_t>(depth), ' ');
+	}
+
+	/*
+	 * Same escapes as nlohmann::json::dump(), which keeps valid UTF-8 as it
+	 * is. Plain characters are copied in runs.
+	 */
+	void AmfJsonWriter::writeString(string_view s) {
+		const auto *p = reinterpret_cast<const uint8_t *>(s.data());
+		size_t n = s.size();
+		out->push_back('"');
+		for (size_t i = 0; ; ) {
+			size_t run = jsonPlainRun(s.data() + i, n - i);
+			out->append(s.data() + i, run);
+			i += run;
+			if (i == n) {
+				break;
+			}
+
+			uint32_t c;
+			size_t len = decodeUtf8(p + i, n - i, c);
+			if (len == 0) {
+				throw Unsupported();
+			}
+			switch (c) {
+				case '"':  out->append("\\\""); break;
+				case '\\': out->append("\\\\"); break;
+				case '\b': out->append("\\b"); break;
+				case '\f': out->append("\\f"); break;
+				case '\n': out->append("\\n"); break;
+				case '\r': out->append("\\r"); break;
+				case '\t': out->append("\\t"); break;
+				default:
+					if (c < 0x20) {
+						writeEscape(c);
+					} else {
+						out->append(s.data() + i, len);
+					}
+					break;
+			}
+			i += len;
+		}
+		out->push_back('"');
+	}
+
+	void AmfJsonWriter::writeEscape(uint32_t unit) {
+		static const char hex[] = "0123456789abcdef";
+		out->append("\\u");
+		for (int shift = 12; shift >= 0; shift -= 4) {
+			out->push_back(hex[(unit >> shift) & 0xF]);
+		}
+	}
+
+	void AmfJsonWriter::writeNumber(double d) {
+		// libswf keeps NaN and such in its own way
+		if (!isfinite(d) || (fpclassify(d) == FP_ZERO && signbit(d))) {
+			throw Unsupported();
+		}
+		// nlohmann's own number formatting, a number doesn't allocate
+		out->append(swf::json(d).dump());
+	}
+
+	void AmfJsonWriter::writeInteger(long long n) {
+		char buf[24];
+		auto res = to_chars(buf, buf + sizeof(buf), n);
+		out->append(buf, res.ptr);
+	}
+
+	void AmfJsonWriter::amf0Value(int depth) {
+		if (depth > MAX_DEPTH) {
+			throw Unsupported();
+		}
+		need(1);
+		uint8_t marker = data[pos++];
+
+		switch (marker) {
+			case amf0::NUMBER: {
+				need(8);
+				uint64_t bits = 0;
+				for (int i = 0; i < 8; ++i) {
+					bits = (bits << 8) | data[pos++];
+				}
+				double d;
+				memcpy(&d, &bits, sizeof(d));
+				writeNumber(d);
+				break;
+			}
+			case amf0::BOOLEAN:
+				need(1);
+				out->append(data[pos++] != 0 ? "true" : "false");
+				break;
+			case amf0::STRING:
+			case amf0::LONG_STRING: {
+				size_t len = 0;
+				size_t lenBytes = (marker == amf0::STRING ? 2 : 4);
+				need(lenBytes);
+				for (size_t i = 0; i < lenBytes; ++i) {
+					len = (len << 8) | data[pos++];
+				}
+				need(len);
+				writeString(string_view(reinterpret_cast<const char *>(data + pos), len));
+				pos += len;
+				break;
+			}
+			case amf0::OBJECT: {
+				out->push_back('{');
+				bool first = true;
+				while (true) {
+					need(2);
+					size_t len = static_cast<size_t>((data[pos] << 8) | data[pos+1]);
+					pos += 2;
+					if (len == 0) {
+						need(1);
+						if (data[pos++] != amf0::OBJECT_END) {
+							throw Unsupported();
+						}
+						break;
+					}
+					need(len);
+					if (!first) {
+						out->push_back(',');
+					}
+					newline(depth + 1);
+					writeString(string_view(reinterpret_cast<const char *>(data + pos), len));
+					pos += len;
+					out->append(": ");
+					amf0Value(depth + 1);
+					first = false;
+				}
+				if (!first) {
+					newline(depth);
+				}
+				out->push_back('}');
+				break;
+			}
+			case amf0::NULL_MARKER:
+				out->append("null");
+				break;
+			case amf0::STRICT_ARRAY: {
+				need(4);
+				size_t count = 0;
+				for (int i = 0; i < 4; ++i) {
+					count = (count << 8) | data[pos++];
+				}
+				out->push_back('[');
+				for (size_t i = 0; i < count; ++i) {
+					if (i > 0) {
+						out->push_back(',');
+					}
+					newline(depth + 1);
+					amf0Value(depth + 1);
+				}
+				if (count > 0) {
+					newline(depth);
+				}
+				out->push_back(']');
+				break;
+			}
+			default:
+				// undefined, references, ECMA arrays, dates, XML, typed objects, ...
+				throw Unsupported();
+		}
+	}
+
+	uint32_t AmfJsonWriter::amf3U29() {
+		uint32_t value = 0;
+		for (int i = 0; i < 4; ++i) {
+			need(1);
+			uint8_t b = data[pos++];
+			if (i == 3) {
+				return (value << 8) | b;
+			}
+			value = (value << 7) | (b & 0x7F);
+			if ((b & 0x80) == 0) {
+				break;
+			}
+		}
+		return value;
+	}
+
+	string_view AmfJsonWriter::amf3String() {
+		uint32_t u = amf3U29();
+		if ((u & 1) == 0) {
+			size_t index = u >> 1;
+			if (index >= strings.size()) {
+				throw Unsupported();
+			}
+			return strings[index];
+		}
+		size_t len = u >> 1;
+		need(len);
+		string_view s(reinterpret_cast<const char *>(data + pos), len);
+		pos += len;
+		// The empty string is never sent by reference
+		if (len > 0) {
+			strings.emplace_back(s);
+		}
+		return s;
+	}
+
+	void AmfJsonWriter::amf3Value(int depth) {
+		if (depth > MAX_DEPTH) {
+			throw Unsupported();
+		}
+		need(1);
+		uint8_t marker = data[pos++];
+
+		switch (marker) {
+			case amf3::NULL_MARKER:
+				out->append("null");
+				break;
+			case amf3::FALSE_MARKER:
+				out->append("false");
+				break;
+			case amf3::TRUE_MARKER:
+				out->append("true");
+				break;
+			case amf3::INTEGER: {
+				uint32_t u = amf3U29();
+				// 29 bit two's complement
+				long long n = (u & 0x10000000) ? static_cast<long long>(u) - 0x20000000 : static_cast<long long>(u);
+				writeInteger(n);
+				break;
+			}
+			case amf3::DOUBLE: {
+				need(8);
+				uint64_t bits = 0;
+				for (int i = 0; i < 8; ++i) {
+					bits = (bits << 8) | data[pos++];
+				}
+				double d;
+				memcpy(&d, &bits, sizeof(d));
+				writeNumber(d);
+				break;
+			}
+			case amf3::STRING:
+				writeString(amf3String());
+				break;
+			case amf3::ARRAY: {
+				uint32_t u = amf3U29();
+				if ((u & 1) == 0) {
+					throw Unsupported(); // reference
+				}
+				size_t count = u >> 1;
+				if (!amf3String().empty()) {
+					throw Unsupported(); // associative part
+				}
+				out->push_back('[');
+				for (size_t i = 0; i < count; ++i) {
+					if (i > 0) {
+						out->push_back(',');
+					}
+					newline(depth + 1);
+					amf3Value(depth + 1);
+				}
+				if (count > 0) {
+					newline(depth);
+				}
+				out->push_back(']');
+				break;
+			}
+			case amf3::OBJECT: {
+				uint32_t u = amf3U29();
+				if ((u & 1) == 0) {
+					throw Unsupported(); // reference
+				}
+				size_t traitsIndex;
+				if ((u & 3) == 1) {
+					traitsIndex = u >> 2;
+					if (traitsIndex >= traits.size()) {
+						throw Unsupported();
+					}
+				} else {
+					if ((u & 7) == 7) {
+						throw Unsupported(); // externalizable
+					}
+					Traits t{(u & 8) != 0, std::pmr::vector<string_view>(&arena)};
+					size_t sealedCount = u >> 4;
+					if (!amf3String().empty()) {
+						throw Unsupported(); // class name
+					}
+					for (size_t i = 0; i < sealedCount; ++i) {
+						t.sealed.emplace_back(amf3String());
+					}
+					traitsIndex = traits.size();
+					traits.emplace_back(move(t));
+				}
+
+				out->push_back('{');
+				bool first = true;
+				auto member = [&](string_view key) {
+					if (!first) {
+						out->push_back(',');
+					}
+					newline(depth + 1);
+					writeString(key);
+					out->append(": ");
+					amf3Value(depth + 1);
+					first = false;
+				};
+				// The table may grow while reading the members
+				size_t sealedCount = traits[traitsIndex].sealed.size();
+				for (size_t i = 0; i < sealedCount; ++i) {
+					member(traits[traitsIndex].sealed[i]);
+				}
+				if (traits[traitsIndex].dynamic) {
+					for (string_view key = amf3String(); !key.empty(); key = amf3String()) {
+						member(key);
+					}
+				}
+				if (!first) {
+					newline(depth);
+				}
+				out->push_back('}');
+				break;
+			}
+			default:
+				// undefined, XML, dates, byte arrays, vectors, dictionaries
+				throw Unsupported();
+		}
+	}
+
+	const std::string &AmfJsonExporter::amf0(const uint8_t *data, size_t size) {
+		if (!writer.writeAmf0(data, size, out)) {
+			out = swf::AMF0{data}.to_json_str();
+		}
+		return out;
+	}
+
+	const std::string &AmfJsonExporter::amf3(const uint8_t *data, size_t size, size_t &pos) {
+		if (!writer.writeAmf3(data, size, pos, out)) {
+			out = swf::AMF3{data, pos}.to_json_str();
+		}
+		return out;
+	}
+
+} // hf_workshop
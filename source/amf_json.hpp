@@ -0,0 +1,118 @@
+/**
+ * HF Workshop - AMF to JSON
+ *
+ * Writes JSON text straight from serialized AMF0 and AMF3 values, without
+ * building a JSON document first.
+ */
+
+#ifndef AMF_JSON_HPP
+#define AMF_JSON_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource> // monotonic_buffer_resource
+#include <cstddef> // byte, size_t
+#include <cstdint> // uint8_t
+
+namespace hf_workshop {
+
+	/**
+	 * Streaming writer for the AMF values found in HF data files: objects,
+	 * dense arrays, strings, numbers, booleans and null. Anything else
+	 * (references, class names, dates, byte arrays, invalid UTF-8, ...)
+	 * makes it give up, so that the caller can use libswf instead.
+	 *
+	 * The text is laid out as libswf's to_json_str(), that is,
+	 * nlohmann::json::dump(4): members and elements on their own lines
+	 * indented by 4 spaces, ": " after the keys, empty objects and arrays as
+	 * {} and [], UTF-8 text as it is, AMF numbers in nlohmann's format (2.0
+	 * stays 2.0), AMF3 integers as integers and no newline at the end.
+	 */
+	class AmfJsonWriter {
+	public:
+		AmfJsonWriter();
+		AmfJsonWriter(const AmfJsonWriter &) = delete;
+		AmfJsonWriter &operator=(const AmfJsonWriter &) = delete;
+		~AmfJsonWriter();
+
+		/**
+		 * Writes the AMF0 value at the start of `data` to `out`, replacing its
+		 * contents. Returns false if the value has anything unsupported.
+		 */
+		bool writeAmf0(const uint8_t *data, size_t size, std::string &out);
+
+		/**
+		 * Writes the AMF3 value at `data[pos]` to `out`, replacing its contents,
+		 * and moves `pos` past it. Returns false, leaving `pos` unchanged,
+		 * if the value has anything unsupported.
+		 */
+		bool writeAmf3(const uint8_t *data, size_t size, size_t &pos, std::string &out);
+
+		/**
+		 * Frees the memory of the reference tables at once. The tables take
+		 * their memory from an arena, so that the traits of the objects of a
+		 * data file cost a pointer bump each and nothing to free.
+		 */
+		void releaseMemory();
+
+	private:
+		struct Traits {
+			bool dynamic;
+			std::pmr::vector<std::string_view> sealed;
+		};
+
+		static constexpr size_t ARENA_SIZE = 64 * 1024;
+		static constexpr size_t INDENT = 4;
+
+		const uint8_t *data;
+		size_t size;
+		size_t pos;
+		std::string *out;
+
+		// AMF3 reference tables
+		std::vector<std::byte> arenaBuffer;
+		std::pmr::monotonic_buffer_resource arena;
+		std::pmr::vector<std::string_view> strings;
+		std::pmr::vector<Traits> traits;
+
+		void begin(const uint8_t *data, size_t size, size_t pos, std::string &out);
+		void need(size_t bytes);
+
+		void amf0Value(int depth);
+		void amf3Value(int depth);
+		uint32_t amf3U29();
+		std::string_view amf3String();
+
+		void newline(int depth);
+		void writeString(std::string_view s);
+		void writeEscape(uint32_t unit);
+		void writeNumber(double d);
+		void writeInteger(long long n);
+	};
+
+	/**
+	 * AMF to JSON for exportData: the AmfJsonWriter, and libswf's
+	 * to_json_str() for the objects the writer doesn't support.
+	 */
+	class AmfJsonExporter {
+	public:
+		AmfJsonExporter() : writer(), out() {}
+
+		/// JSON of the AMF0 value at the start of `data`
+		const std::string &amf0(const uint8_t *data, size_t size);
+
+		/// JSON of the AMF3 value at `data[pos]`, moving `pos` past it
+		const std::string &amf3(const uint8_t *data, size_t size, size_t &pos);
+
+		/// To be called once the values of a data file are converted
+		void releaseMemory() { writer.releaseMemory(); }
+
+	private:
+		AmfJsonWriter writer;
+		std::string out;
+	};
+
+} // hf_workshop
+
+#endif // AMF_JSON_HPP
@@ -0,0 +1,113 @@
+/**
+ * HF Workshop - AMF reference tables
+ */
+
+#include "amf_references.hpp"
+
+#include <algorithm> // fill
+#include <cstring>   // memcmp
+
+#include "xxhash.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		constexpr size_t INITIAL_SLOTS = 64;
+
+		/// Mixes the bits of an object number, which are often sequential
+		uint64_t mix(uint64_t x) {
+			x ^= x >> 33;
+			x *= 0xFF51AFD7ED558CCDULL;
+			x ^= x >> 33;
+			return x;
+		}
+
+		/// Slot of `hash` in a table of `slots` size, a power of 2, after any collisions
+		size_t freeSlot(const vector<uint32_t> &slots, uint64_t hash) {
+			size_t mask = slots.size() - 1;
+			size_t slot = hash & mask;
+			while (slots[slot] != 0) {
+				slot = (slot + 1) & mask;
+			}
+			return slot;
+		}
+
+	} // anonymous namespace
+
+	AmfStringTable::AmfStringTable() : data(), entries(), slots(INITIAL_SLOTS, 0) {}
+
+	AmfStringTable::~AmfStringTable() = default;
+
+	uint32_t AmfStringTable::findOrAdd(string_view s) {
+		uint64_t hash = xxh64(s.data(), s.size());
+
+		size_t mask = slots.size() - 1;
+		for (size_t slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+			const Entry &e = entries[slots[slot] - 1];
+			if (e.hash == hash && e.length == s.size() &&
+			    memcmp(data.data() + e.offset, s.data(), s.size()) == 0) {
+				return slots[slot] - 1;
+			}
+		}
+
+		// At most half full
+		if (2 * (entries.size() + 1) > slots.size()) {
+			grow();
+		}
+		entries.push_back({hash, data.size(), s.size()});
+		slots[freeSlot(slots, hash)] = static_cast<uint32_t>(entries.size());
+		data.append(s);
+		return NOT_FOUND;
+	}
+
+	void AmfStringTable::clear() {
+		data.clear();
+		entries.clear();
+		fill(slots.begin(), slots.end(), 0);
+	}
+
+	void AmfStringTable::grow() {
+		slots.assign(slots.size() * 2, 0);
+		for (size_t i = 0; i < entries.size(); ++i) {
+			slots[freeSlot(slots, entries[i].hash)] = static_cast<uint32_t>(i + 1);
+		}
+	}
+
+	AmfObjectTable::AmfObjectTable() : ids(), slots(INITIAL_SLOTS, 0) {}
+
+	AmfObjectTable::~AmfObjectTable() = default;
+
+	uint32_t AmfObjectTable::findOrAdd(uint64_t id) {
+		uint64_t hash = mix(id);
+
+		size_t mask = slots.size() - 1;
+		for (size_t slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+			if (ids[slots[slot] - 1] == id) {
+				return slots[slot] - 1;
+			}
+		}
+
+		if (2 * (ids.size() + 1) > slots.size()) {
+			grow();
+		}
+		ids.emplace_back(id);
+		slots[freeSlot(slots, hash)] = static_cast<uint32_t>(ids.size());
+		return NOT_FOUND;
+	}
+
+	void AmfObjectTable::clear() {
+		ids.clear();
+		fill(slots.begin(), slots.end(), 0);
+	}
+
+	void AmfObjectTable::grow() {
+		slots.assign(slots.size() * 2, 0);
+		for (size_t i = 0; i < ids.size(); ++i) {
+			slots[freeSlot(slots, mix(ids[i]))] = static_cast<uint32_t>(i + 1);
+		}
+	}
+
+} // hf_workshop
@@ -0,0 +1,80 @@
+/**
+ * HF Workshop - AMF reference tables
+ *
+ * Open addressing hash tables giving the index of the strings, traits and
+ * objects already written, which AMF sends again as back-references.
+ */
+
+#ifndef AMF_REFERENCES_HPP
+#define AMF_REFERENCES_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint> // uint32_t, uint64_t
+#include <cstddef> // size_t
+
+namespace hf_workshop {
+
+	/**
+	 * Strings by index, in the order they were added. The strings are
+	 * copied, so views of temporaries can be added.
+	 */
+	class AmfStringTable {
+	public:
+		static constexpr uint32_t NOT_FOUND = static_cast<uint32_t>(-1);
+
+		AmfStringTable();
+		~AmfStringTable();
+
+		/// Index of `s` if it was added before, otherwise adds it and returns NOT_FOUND
+		uint32_t findOrAdd(std::string_view s);
+
+		size_t size() const { return entries.size(); }
+
+		/// Empties the table, keeping its memory
+		void clear();
+
+	private:
+		struct Entry {
+			uint64_t hash;
+			size_t offset;  // in 'data'
+			size_t length;
+		};
+
+		std::string data;
+		std::vector<Entry> entries;
+		std::vector<uint32_t> slots;  // index in 'entries' + 1, 0 if empty
+
+		void grow();
+	};
+
+	/**
+	 * Objects by index, in the order they were added. Objects are known by
+	 * a number of the caller's choosing, such as their position.
+	 */
+	class AmfObjectTable {
+	public:
+		static constexpr uint32_t NOT_FOUND = static_cast<uint32_t>(-1);
+
+		AmfObjectTable();
+		~AmfObjectTable();
+
+		/// Index of `id` if it was added before, otherwise adds it and returns NOT_FOUND
+		uint32_t findOrAdd(uint64_t id);
+
+		size_t size() const { return ids.size(); }
+
+		/// Empties the table, keeping its memory
+		void clear();
+
+	private:
+		std::vector<uint64_t> ids;
+		std::vector<uint32_t> slots;  // index in 'ids' + 1, 0 if empty
+
+		void grow();
+	};
+
+} // hf_workshop
+
+#endif // AMF_REFERENCES_HPP
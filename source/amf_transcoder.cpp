@@ -0,0 +1,540 @@
+/**
+ * HF Workshop - AMF0/AMF3 transcoder
+ */
+
+#include "amf_transcoder.hpp"
+
+#include <stdexcept>     // runtime_error
+#include <string>
+#include <string_view>
+
+#include "amf_bytes.hpp"
+#include "amf_references.hpp"
+#include "data_file_index.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		using namespace amf_bytes;
+
+		class Amf0ToAmf3 {
+		public:
+			Amf0ToAmf3(const uint8_t *data, size_t size, vector<uint8_t> &_out)
+				: in(data, size, 0), out(_out), strings(), traits(), traitsKey(), objects(), objectCount(0) {}
+			Amf0ToAmf3(const Amf0ToAmf3 &) = delete;
+			Amf0ToAmf3 &operator=(const Amf0ToAmf3 &) = delete;
+
+			void convert() {
+				value(0);
+			}
+
+		private:
+			/// An AMF0 object, as AMF3 refers to it
+			struct Object {
+				uint8_t marker;
+				uint32_t index;
+			};
+
+			Reader in;
+			vector<uint8_t> &out;
+			AmfStringTable strings;
+			AmfStringTable traits;   // class name, member names and kind, separated by NULs
+			std::string traitsKey;
+			vector<Object> objects;  // by AMF0 reference index
+			uint32_t objectCount;    // in the AMF3 reference table
+
+			void string(string_view s) {
+				// The empty string is never sent by reference
+				if (s.empty()) {
+					out.emplace_back(amf3::EMPTY_STRING);
+					return;
+				}
+				uint32_t index = strings.findOrAdd(s);
+				if (index != AmfStringTable::NOT_FOUND) {
+					writeU29(out, index << 1);
+					return;
+				}
+				if (s.size() > amf3::MAX_LENGTH) {
+					throw runtime_error("String is too long for AMF3.");
+				}
+				writeU29(out, static_cast<uint32_t>((s.size() << 1) | 1));
+				writeBytes(out, s);
+			}
+
+			/// Writes the traits of an object, by reference if they were written before
+			void writeTraits(string_view className, const vector<string_view> &sealed, bool dynamic) {
+				traitsKey.assign(className);
+				traitsKey += '\0';
+				for (auto name : sealed) {
+					traitsKey += name;
+					traitsKey += '\0';
+				}
+				traitsKey += (dynamic ? 'D' : 'S');
+				uint32_t index = traits.findOrAdd(traitsKey);
+				if (index != AmfStringTable::NOT_FOUND) {
+					writeU29(out, (index << 2) | 1);
+					return;
+				}
+				if (sealed.size() > (amf3::MAX_LENGTH >> 3)) {
+					throw runtime_error("Object has too many members for AMF3.");
+				}
+				writeU29(out, static_cast<uint32_t>((sealed.size() << 4) | (dynamic ? 0x08 : 0) | 0x03));
+				string(className);
+				for (auto name : sealed) {
+					string(name);
+				}
+			}
+
+			/// Adds a complex value to both reference tables
+			void addObject(uint8_t marker) {
+				objects.push_back({marker, objectCount++});
+			}
+
+			void value(int depth) {
+				if (depth > MAX_DEPTH) {
+					throw runtime_error("AMF0 value is nested too deeply.");
+				}
+				uint8_t marker = in.u8();
+
+				switch (marker) {
+					case amf0::NUMBER: {
+						double d = in.number();
+						if (isAmf3Integer(d)) {
+							out.emplace_back(amf3::INTEGER);
+							writeU29(out, static_cast<uint32_t>(static_cast<long long>(d)) & 0x1FFFFFFF);
+						} else {
+							out.emplace_back(amf3::DOUBLE);
+							writeDouble(out, d);
+						}
+						break;
+					}
+					case amf0::BOOLEAN:
+						out.emplace_back(in.u8() != 0 ? amf3::TRUE_MARKER : amf3::FALSE_MARKER);
+						break;
+					case amf0::STRING:
+						out.emplace_back(amf3::STRING);
+						string(in.str(in.be(2)));
+						break;
+					case amf0::LONG_STRING:
+						out.emplace_back(amf3::STRING);
+						string(in.str(in.be(4)));
+						break;
+					case amf0::NULL_MARKER:
+						out.emplace_back(amf3::NULL_MARKER);
+						break;
+					case amf0::UNDEFINED:
+						out.emplace_back(amf3::UNDEFINED);
+						break;
+					case amf0::REFERENCE: {
+						uint32_t index = in.be(2);
+						if (index >= objects.size()) {
+							throw runtime_error("AMF0 reference is out of range.");
+						}
+						out.emplace_back(objects[index].marker);
+						writeU29(out, objects[index].index << 1);
+						break;
+					}
+					case amf0::OBJECT: {
+						addObject(amf3::OBJECT);
+						out.emplace_back(amf3::OBJECT);
+						writeTraits({}, {}, true);
+						for (size_t len = in.be(2); len != 0; len = in.be(2)) {
+							string(in.str(len));
+							value(depth + 1);
+						}
+						if (in.u8() != amf0::OBJECT_END) {
+							throw runtime_error("Empty AMF0 property name.");
+						}
+						out.emplace_back(amf3::EMPTY_STRING);
+						break;
+					}
+					case amf0::TYPED_OBJECT: {
+						string_view className = in.str(in.be(2));
+						addObject(amf3::OBJECT);
+						auto properties = amf0Properties(in, depth);
+						size_t end = in.pos;
+
+						vector<string_view> sealed;
+						for (auto &p : properties) {
+							sealed.emplace_back(p.first);
+						}
+						out.emplace_back(amf3::OBJECT);
+						writeTraits(className, sealed, false);
+						for (auto &p : properties) {
+							in.pos = p.second;
+							value(depth + 1);
+						}
+						in.pos = end;
+						break;
+					}
+					case amf0::ECMA_ARRAY: {
+						in.bytes(4); // associative count, not reliable
+						addObject(amf3::ARRAY);
+						auto properties = amf0Properties(in, depth);
+						size_t end = in.pos;
+
+						out.emplace_back(amf3::ARRAY);
+						if (ordinalKeys(properties)) {
+							writeU29(out, static_cast<uint32_t>((properties.size() << 1) | 1));
+							out.emplace_back(amf3::EMPTY_STRING);
+							for (auto &p : properties) {
+								in.pos = p.second;
+								value(depth + 1);
+							}
+						} else {
+							writeU29(out, 1);
+							for (auto &p : properties) {
+								string(p.first);
+								in.pos = p.second;
+								value(depth + 1);
+							}
+							out.emplace_back(amf3::EMPTY_STRING);
+						}
+						in.pos = end;
+						break;
+					}
+					case amf0::STRICT_ARRAY: {
+						uint32_t count = in.be(4);
+						addObject(amf3::ARRAY);
+						out.emplace_back(amf3::ARRAY);
+						writeU29(out, (count << 1) | 1);
+						out.emplace_back(amf3::EMPTY_STRING);
+						for (uint32_t i = 0; i < count; ++i) {
+							value(depth + 1);
+						}
+						break;
+					}
+					case amf0::DATE: {
+						double ms = in.number();
+						in.bytes(2); // time zone, always 0
+						++objectCount;
+						out.emplace_back(amf3::DATE);
+						writeU29(out, 1);
+						writeDouble(out, ms);
+						break;
+					}
+					case amf0::XML_DOCUMENT: {
+						string_view xml = in.str(in.be(4));
+						if (xml.size() > amf3::MAX_LENGTH) {
+							throw runtime_error("XML is too long for AMF3.");
+						}
+						++objectCount;
+						out.emplace_back(amf3::XML_DOC);
+						writeU29(out, static_cast<uint32_t>((xml.size() << 1) | 1));
+						writeBytes(out, xml);
+						break;
+					}
+					default:
+						throw runtime_error("AMF0 marker " + to_string(marker) + " has no AMF3 equivalent.");
+				}
+			}
+		};
+
+		class Amf3ToAmf0 {
+		public:
+			Amf3ToAmf0(const uint8_t *data, size_t size, size_t pos, vector<uint8_t> &_out)
+				: in(data, size, pos), out(_out), strings(), traits(), objects(), objectCount(0), keyBuffer() {}
+			Amf3ToAmf0(const Amf3ToAmf0 &) = delete;
+			Amf3ToAmf0 &operator=(const Amf3ToAmf0 &) = delete;
+
+			size_t convert() {
+				value(0);
+				return in.pos;
+			}
+
+		private:
+			struct Traits {
+				string_view className;
+				vector<string_view> sealed;
+				bool dynamic;
+			};
+
+			static constexpr uint32_t NOT_REFERABLE = 0xFFFFFFFF;
+
+			Reader in;
+			vector<uint8_t> &out;
+			vector<string_view> strings;
+			vector<Traits> traits;
+			vector<uint32_t> objects;  // AMF0 reference index by AMF3 reference index
+			uint32_t objectCount;      // in the AMF0 reference table
+			std::string keyBuffer;
+
+			string_view string() {
+				uint32_t u = in.u29();
+				if ((u & 1) == 0) {
+					if ((u >> 1) >= strings.size()) {
+						throw runtime_error("AMF3 string reference is out of range.");
+					}
+					return strings[u >> 1];
+				}
+				string_view s = in.str(u >> 1);
+				if (!s.empty()) {
+					strings.emplace_back(s);
+				}
+				return s;
+			}
+
+			void writeString(string_view s) {
+				if (s.size() <= 0xFFFF) {
+					out.emplace_back(amf0::STRING);
+					writeBe(out, static_cast<uint32_t>(s.size()), 2);
+				} else {
+					if (s.size() > 0xFFFFFFFF) {
+						throw runtime_error("String is too long for AMF0.");
+					}
+					out.emplace_back(amf0::LONG_STRING);
+					writeBe(out, static_cast<uint32_t>(s.size()), 4);
+				}
+				writeBytes(out, s);
+			}
+
+			void writeKey(string_view key) {
+				if (key.empty() || key.size() > 0xFFFF) {
+					throw runtime_error("Property name can't be written in AMF0.");
+				}
+				writeBe(out, static_cast<uint32_t>(key.size()), 2);
+				writeBytes(out, key);
+			}
+
+			void writeObjectEnd() {
+				out.emplace_back(0);
+				out.emplace_back(0);
+				out.emplace_back(amf0::OBJECT_END);
+			}
+
+			/**
+			 * Reads the U29 that starts a complex value. Writes an AMF0 reference
+			 * and returns false if it's a reference, returns true otherwise.
+			 */
+			bool inlineValue(uint32_t &u) {
+				u = in.u29();
+				if ((u & 1) != 0) {
+					return true;
+				}
+				size_t index = u >> 1;
+				if (index >= objects.size() || objects[index] == NOT_REFERABLE) {
+					throw runtime_error("AMF3 reference can't be written in AMF0.");
+				}
+				if (objects[index] > 0xFFFF) {
+					throw runtime_error("Too many objects for AMF0 references.");
+				}
+				out.emplace_back(amf0::REFERENCE);
+				writeBe(out, objects[index], 2);
+				return false;
+			}
+
+			void value(int depth) {
+				if (depth > MAX_DEPTH) {
+					throw runtime_error("AMF3 value is nested too deeply.");
+				}
+				uint8_t marker = in.u8();
+
+				switch (marker) {
+					case amf3::UNDEFINED:
+						out.emplace_back(amf0::UNDEFINED);
+						break;
+					case amf3::NULL_MARKER:
+						out.emplace_back(amf0::NULL_MARKER);
+						break;
+					case amf3::FALSE_MARKER:
+					case amf3::TRUE_MARKER:
+						out.emplace_back(amf0::BOOLEAN);
+						out.emplace_back(marker == amf3::TRUE_MARKER ? 1 : 0);
+						break;
+					case amf3::INTEGER: {
+						uint32_t u = in.u29();
+						// 29 bit two's complement
+						long long n = (u & 0x10000000) ? static_cast<long long>(u) - 0x20000000 : static_cast<long long>(u);
+						out.emplace_back(amf0::NUMBER);
+						writeDouble(out, static_cast<double>(n));
+						break;
+					}
+					case amf3::DOUBLE:
+						out.emplace_back(amf0::NUMBER);
+						writeDouble(out, in.number());
+						break;
+					case amf3::STRING:
+						writeString(string());
+						break;
+					case amf3::XML_DOC:
+					case amf3::XML: {
+						uint32_t u = in.u29();
+						if ((u & 1) == 0) {
+							throw runtime_error("AMF3 reference can't be written in AMF0.");
+						}
+						objects.push_back(NOT_REFERABLE);
+						string_view xml = in.str(u >> 1);
+						out.emplace_back(amf0::XML_DOCUMENT);
+						writeBe(out, static_cast<uint32_t>(xml.size()), 4);
+						writeBytes(out, xml);
+						break;
+					}
+					case amf3::DATE: {
+						uint32_t u = in.u29();
+						if ((u & 1) == 0) {
+							throw runtime_error("AMF3 reference can't be written in AMF0.");
+						}
+						objects.push_back(NOT_REFERABLE);
+						out.emplace_back(amf0::DATE);
+						writeDouble(out, in.number());
+						writeBe(out, 0, 2); // time zone
+						break;
+					}
+					case amf3::ARRAY: {
+						uint32_t u;
+						if (!inlineValue(u)) {
+							break;
+						}
+						objects.push_back(objectCount++);
+						size_t denseCount = u >> 1;
+
+						out.emplace_back(amf0::ECMA_ARRAY);
+						size_t countPos = out.size();
+						writeBe(out, 0, 4);
+						size_t count = 0;
+						for (string_view key = string(); !key.empty(); key = string()) {
+							writeKey(key);
+							value(depth + 1);
+							++count;
+						}
+						for (size_t i = 0; i < denseCount; ++i) {
+							keyBuffer = to_string(i);
+							writeKey(keyBuffer);
+							value(depth + 1);
+						}
+						count += denseCount;
+						if (count > 0xFFFFFFFF) {
+							throw runtime_error("Array is too long for AMF0.");
+						}
+						for (size_t i = 0; i < 4; ++i) {
+							out[countPos + i] = static_cast<uint8_t>(count >> (8 * (3 - i)));
+						}
+						writeObjectEnd();
+						break;
+					}
+					case amf3::OBJECT: {
+						uint32_t u;
+						if (!inlineValue(u)) {
+							break;
+						}
+						objects.push_back(objectCount++);
+
+						size_t traitsIndex;
+						if ((u & 3) == 1) {
+							traitsIndex = u >> 2;
+							if (traitsIndex >= traits.size()) {
+								throw runtime_error("AMF3 traits reference is out of range.");
+							}
+						} else {
+							if ((u & 7) == 7) {
+								throw runtime_error("Externalizable AMF3 objects can't be written in AMF0.");
+							}
+							Traits t{string(), {}, (u & 8) != 0};
+							for (size_t i = 0, n = u >> 4; i < n; ++i) {
+								t.sealed.emplace_back(string());
+							}
+							traitsIndex = traits.size();
+							traits.push_back(move(t));
+						}
+
+						// The table may grow while reading the members
+						string_view className = traits[traitsIndex].className;
+						if (className.empty()) {
+							out.emplace_back(amf0::OBJECT);
+						} else {
+							if (className.size() > 0xFFFF) {
+								throw runtime_error("Class name is too long for AMF0.");
+							}
+							out.emplace_back(amf0::TYPED_OBJECT);
+							writeBe(out, static_cast<uint32_t>(className.size()), 2);
+							writeBytes(out, className);
+						}
+						for (size_t i = 0; i < traits[traitsIndex].sealed.size(); ++i) {
+							writeKey(traits[traitsIndex].sealed[i]);
+							value(depth + 1);
+						}
+						if (traits[traitsIndex].dynamic) {
+							for (string_view key = string(); !key.empty(); key = string()) {
+								writeKey(key);
+								value(depth + 1);
+							}
+						}
+						writeObjectEnd();
+						break;
+					}
+					default:
+						throw runtime_error("AMF3 marker " + to_string(marker) + " has no AMF0 equivalent.");
+				}
+			}
+		};
+
+		void writeUtf(vector<uint8_t> &out, const std::string &s) {
+			writeBe(out, static_cast<uint32_t>(s.size()), 2);
+			writeBytes(out, s);
+		}
+
+	} // anonymous namespace
+
+	void amf0ToAmf3(const uint8_t *data, size_t size, vector<uint8_t> &out) {
+		Amf0ToAmf3(data, size, out).convert();
+	}
+
+	void amf3ToAmf0(const uint8_t *data, size_t size, size_t &pos, vector<uint8_t> &out) {
+		pos = Amf3ToAmf0(data, size, pos, out).convert();
+	}
+
+	vector<uint8_t> convertDataFile(const vector<uint8_t> &data) {
+		DataFileIndex index = indexDataFile(data);
+
+		const pair<const char *, const char *> types[] = {
+			{"limbInfo", "limbInfoO"}, {"Spt", "SptO"}, {"Bg", "BgO"}
+		};
+		std::string target;
+		bool toHfx = false;
+		for (auto &t : types) {
+			if (index.fileType == t.first) {
+				target = t.second;
+				toHfx = true;
+			} else if (index.fileType == t.second) {
+				target = t.first;
+			}
+		}
+		if (index.fileType == "gdat") {
+			return data;
+		} else if (target.empty()) {
+			throw runtime_error("Unknown data file type '" + index.fileType + "'.");
+		}
+
+		vector<uint8_t> out;
+		out.reserve(data.size() + data.size() / 4);
+		writeUtf(out, target);
+
+		vector<uint8_t> amf0;
+		for (const DataSection &section : index.sections) {
+			if (section.countOffset != DataSection::NO_COUNT) {
+				writeBe(out, static_cast<uint32_t>(section.elements.size()), 4);
+			}
+			for (const DataElement &e : section.elements) {
+				if (section.name == "PNG") {
+					// Byte arrays or nulls either way
+					out.insert(out.end(), data.begin() + static_cast<ptrdiff_t>(e.begin),
+					           data.begin() + static_cast<ptrdiff_t>(e.end));
+				} else if (toHfx) {
+					Reader r(data.data(), e.end, e.begin);
+					string_view bytes = r.byteArray();
+					amf0ToAmf3(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size(), out);
+				} else {
+					amf0.clear();
+					size_t pos = e.begin;
+					amf3ToAmf0(data.data(), e.end, pos, amf0);
+					writeByteArray(out, amf0);
+				}
+			}
+		}
+		return out;
+	}
+
+} // hf_workshop
@@ -0,0 +1,51 @@
+/**
+ * HF Workshop - AMF0/AMF3 transcoder
+ *
+ * Converts serialized AMF0 values to AMF3 and back without decoding them,
+ * so that data files can move between HF v0.7 and HFX.
+ */
+
+#ifndef AMF_TRANSCODER_HPP
+#define AMF_TRANSCODER_HPP
+
+#include <vector>
+#include <cstdint> // uint8_t
+#include <cstddef> // size_t
+
+namespace hf_workshop {
+
+	/**
+	 * Appends the AMF3 equivalent of the AMF0 value at the start of `data`
+	 * to `out`.
+	 *
+	 * Anonymous objects become dynamic objects and typed objects become
+	 * objects of the same class with sealed members. ECMA arrays with the keys
+	 * "0", "1", ... in order become dense arrays, other ECMA arrays become
+	 * associative ones. Integral numbers that fit in 29 bits become integers.
+	 * Throws std::runtime_error if the value is malformed or has something
+	 * with no AMF3 equivalent.
+	 */
+	void amf0ToAmf3(const uint8_t *data, size_t size, std::vector<uint8_t> &out);
+
+	/**
+	 * Appends the AMF0 equivalent of the AMF3 value at `data[pos]` to `out`
+	 * and moves `pos` past it.
+	 *
+	 * Arrays become ECMA arrays, as HF uses no others, and objects with a
+	 * class name become typed objects.
+	 * Throws std::runtime_error if the value is malformed or has something
+	 * with no AMF0 equivalent, such as byte arrays, vectors and dictionaries.
+	 */
+	void amf3ToAmf0(const uint8_t *data, size_t size, size_t &pos, std::vector<uint8_t> &out);
+
+	/**
+	 * Converts an inflated data file of HF v0.7 to the HFX format, or the
+	 * other way around: limbInfo <-> limbInfoO, Spt <-> SptO and Bg <-> BgO.
+	 * Game data files (gdat) are the same in both and are returned as they are.
+	 * Throws std::runtime_error if the file can't be converted.
+	 */
+	std::vector<uint8_t> convertDataFile(const std::vector<uint8_t> &data);
+
+} // hf_workshop
+
+#endif // AMF_TRANSCODER_HPP
@@ -0,0 +1,237 @@
+/**
+ * HF Workshop - Batch mode
+ */
+
+#include "batch.hpp"
+
+#include <algorithm>    // min, max, mismatch
+#include <chrono>       // steady_clock
+#include <exception>    // exception
+#include <filesystem>   // path, directory_iterator, create_directories
+#include <set>
+#include <stdexcept>    // runtime_error
+#include <system_error> // error_code
+
+#include <rlutil/rlutil.h>
+
+#include "minizip_wrapper.hpp"
+#include "swf_stream.hpp"
+#include "swf_tags.hpp"
+#include "utils.hpp"
+
+// Because of libintl conflict with json, this header must come last
+#include "io_wrapper.hpp"
+
+using namespace std;
+using namespace swf;
+using namespace l18n;
+namespace fs = std::filesystem;
+
+namespace hf_workshop {
+
+	namespace {
+
+		struct BatchResult {
+			bool ok = false;
+			string message = "";
+			size_t inputSize = 0;
+			size_t outputSize = 0;
+			double seconds = 0;
+		};
+
+		bool isGameFile(const fs::path &path) {
+			string extension = path.extension().string();
+			return equalsIgnoreCase(extension, ".swf") || equalsIgnoreCase(extension, ".apk");
+		}
+
+		/// The game as an uncompressed SWF, inflated here if it can be, or else by libswf
+		vector<uint8_t> uncompressedGame(const vector<uint8_t> &game) {
+			try {
+				return uncompressedSwf(game);
+			} catch (const exception &) {
+				return SWF(game).exportSwf(CompressionChoice::uncompressed);
+			}
+		}
+
+		BatchResult process(const BatchOptions &options, const string &input, const string &output) {
+
+			BatchResult result;
+			auto start = chrono::steady_clock::now();
+			try {
+				vector<uint8_t> game = readGame(input);
+				result.inputSize = game.size();
+
+				vector<uint8_t> out;
+				bool written = false;
+				switch (options.operation) {
+					case BatchOperation::verify: {
+						vector<uint8_t> fws = uncompressedGame(game);
+						out = SWF(game).exportSwf(CompressionChoice::uncompressed);
+						if (out == fws) {
+							result.ok = true;
+						} else {
+							size_t at = static_cast<size_t>(mismatch(fws.begin(), fws.begin() + static_cast<ptrdiff_t>(min(fws.size(), out.size())),
+							                                         out.begin()).first - fws.begin());
+							result.message = "differs from byte " + to_string(at);
+						}
+						break;
+					}
+					case BatchOperation::exportSwf:
+						out = SWF(game).exportSwf(options.compression);
+						result.ok = true;
+						break;
+					case BatchOperation::recompress:
+						out = uncompressedGame(game);
+						if (options.compression == CompressionChoice::lzma) {
+							out = SWF(out).exportSwf(CompressionChoice::lzma);
+						} else {
+							// Deflated straight into the file
+							FileSink file(output);
+							streamSwf(out, {}, options.compression == CompressionChoice::zlib, file);
+							file.commit();
+							result.outputSize = static_cast<size_t>(file.size());
+							written = true;
+						}
+						result.ok = true;
+						break;
+					default:
+						break;
+				}
+				if (!written) {
+					result.outputSize = out.size();
+					if (!output.empty()) {
+						writeBinaryFile(output, out);
+					}
+				}
+			} catch (const exception &e) {
+				result.ok = false;
+				result.message = e.what();
+			}
+			result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			return result;
+		}
+
+	} // anonymous namespace
+
+	bool isGameSwfEntry(const string &name) {
+		return startsWith(name, "assets/HeroFighterX") && endsWith(name, ".swf");
+	}
+
+	vector<uint8_t> readGame(const string &filename) {
+		vector<uint8_t> buffer;
+		try {
+			minizip::Unzipper unzipper(filename);
+			for (const auto &ze : unzipper.getEntries()) {
+				if (isGameSwfEntry(ze.name)) {
+					unzipper.extractEntryToMemory(ze.name, buffer);
+					return buffer;
+				}
+			}
+			throw runtime_error("SWF not found inside the archive file.");
+		} catch (const minizip::minizip_exception &) {
+			readBinaryFile(filename, buffer);
+		}
+		return buffer;
+	}
+
+	vector<string> expandBatchInputs(const vector<string> &inputs) {
+
+		vector<string> files;
+		set<string> seen;
+		auto add = [&](const fs::path &path) {
+			string name = path.string();
+			if (seen.insert(name).second) {
+				files.push_back(name);
+			}
+		};
+
+		for (const auto &input : inputs) {
+			fs::path path(input);
+			error_code ec;
+			string pattern = path.filename().string();
+
+			if (pattern.find_first_of("*?") != string::npos) {
+				fs::path directory = path.has_parent_path() ? path.parent_path() : fs::path(".");
+				vector<fs::path> matches;
+				for (const auto &entry : fs::directory_iterator(directory, ec)) {
+					if (entry.is_regular_file(ec) && wildcardMatch(pattern, entry.path().filename().string())) {
+						matches.push_back(entry.path());
+					}
+				}
+				sort(matches.begin(), matches.end());
+				for_each(matches.begin(), matches.end(), add);
+			} else if (fs::is_directory(path, ec)) {
+				vector<fs::path> matches;
+				for (const auto &entry : fs::directory_iterator(path, ec)) {
+					if (entry.is_regular_file(ec) && isGameFile(entry.path())) {
+						matches.push_back(entry.path());
+					}
+				}
+				sort(matches.begin(), matches.end());
+				for_each(matches.begin(), matches.end(), add);
+			} else {
+				// Errors for files that don't exist are reported in the table
+				add(path);
+			}
+		}
+		return files;
+	}
+
+	size_t runBatch(const BatchOptions &options) {
+
+		localization io;
+		vector<string> files = expandBatchInputs(options.inputs);
+		if (files.empty()) {
+			printf_error(io.getText("No input files.\n"));
+			return 0;
+		}
+
+		// Outputs are named after the inputs, with a number added if two inputs have the same name
+		vector<string> outputs(files.size());
+		if (options.operation != BatchOperation::verify) {
+			error_code ec;
+			fs::create_directories(options.outputDirectory, ec);
+			set<string> used;
+			for (size_t i = 0; i < files.size(); ++i) {
+				string stem = fs::path(files[i]).stem().string();
+				string name = stem + ".swf";
+				for (int n = 2; !used.insert(name).second; ++n) {
+					name = stem + "-" + to_string(n) + ".swf";
+				}
+				outputs[i] = (fs::path(options.outputDirectory) / name).string();
+			}
+		}
+
+		unsigned jobs = max(1u, min<unsigned>(options.jobs, static_cast<unsigned>(files.size())));
+		printf_normal(io.getText("Processing %zu file(s) on %u thread(s)...\n"), files.size(), jobs);
+
+		vector<BatchResult> results(files.size());
+		parallelFor(files.size(), [&](size_t i) {
+			results[i] = process(options, files[i], outputs[i]);
+		}, jobs);
+
+		size_t width = 4;
+		for (const auto &f : files) {
+			width = max(width, f.size());
+		}
+
+		size_t failed = 0;
+		printf_colored(rlutil::YELLOW, "%-*s  %-6s  %12s  %12s  %8s  %s\n", static_cast<int>(width), io.getText("File"),
+		               io.getText("Result"), io.getText("Input"), io.getText("Output"), io.getText("Seconds"), io.getText("Notes"));
+		for (size_t i = 0; i < files.size(); ++i) {
+			const BatchResult &r = results[i];
+			printf_normal("%-*s  ", static_cast<int>(width), files[i].c_str());
+			if (r.ok) {
+				printf_colored(rlutil::LIGHTGREEN, "%-6s", "OK");
+			} else {
+				printf_colored(rlutil::LIGHTRED, "%-6s", "FAIL");
+				++failed;
+			}
+			printf_normal("  %12zu  %12zu  %8.2f  %s\n", r.inputSize, r.outputSize, r.seconds,
+			              (outputs[i].empty() || !r.ok ? r.message : outputs[i]).c_str());
+		}
+		printf_colored(rlutil::YELLOW, io.getText("%zu of %zu file(s) failed.\n"), failed, files.size());
+		return failed;
+	}
+
+} // hf_workshop
@@ -0,0 +1,59 @@
+/**
+ * HF Workshop - Batch mode
+ *
+ * Applies the same operation to many games at once, without the menus, for
+ * scripts and CI.
+ */
+
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint> // uint8_t
+
+#include "swf.hpp"
+#include "parallel.hpp"
+
+namespace hf_workshop {
+
+	enum class BatchOperation {
+		verify,     // parse the game and check that exporting it uncompressed gives back its bytes
+		exportSwf,  // parse the game and export it again with libswf
+		recompress  // compress the game as it is, without parsing it
+	};
+
+	struct BatchOptions {
+		BatchOperation operation = BatchOperation::verify;
+		swf::CompressionChoice compression = swf::CompressionChoice::zlib;
+		std::string outputDirectory = "hfw_batch";  // of exportSwf and recompress
+		unsigned jobs = defaultThreadCount();       // games processed at the same time
+		std::vector<std::string> inputs = {};       // files, directories and patterns
+	};
+
+	/// Whether an entry of an APK is the game
+	bool isGameSwfEntry(const std::string &name);
+
+	/**
+	 * The game in a SWF, EXE or APK file. Throws std::runtime_error if it
+	 * can't be read or an APK doesn't have it.
+	 */
+	std::vector<uint8_t> readGame(const std::string &filename);
+
+	/**
+	 * The files named by the inputs, in order and without duplicates: files
+	 * as they are, the SWF and APK files of directories, and the files that
+	 * match patterns with * and ? in their last component.
+	 */
+	std::vector<std::string> expandBatchInputs(const std::vector<std::string> &inputs);
+
+	/**
+	 * Processes the files, holding at most `jobs` games in memory, and prints
+	 * a table with the result of each one. Returns the number of files that
+	 * failed.
+	 */
+	size_t runBatch(const BatchOptions &options);
+
+} // hf_workshop
+
+#endif // BATCH_HPP
@@ -0,0 +1,130 @@
+/**
+ * HF Workshop - Cache of compressed data files
+ */
+
+#include "compression_cache.hpp"
+#include "xxhash.hpp"
+
+#include <algorithm>    // sort
+#include <cstdlib>      // getenv
+#include <filesystem>   // path, create_directories, rename, directory_iterator
+#include <system_error> // error_code
+#include <utility>      // pair
+
+#include "zlib_wrapper.hpp"
+#include "io_wrapper.hpp" // readBinaryFile, writeBinaryFile
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace hf_workshop {
+
+	namespace {
+
+		bool isEntry(const fs::directory_entry &e, error_code &ec) {
+			return e.is_regular_file(ec) && e.path().extension() == ".zlib";
+		}
+
+	} // anonymous namespace
+
+	CompressionCache::CompressionCache(const string &_directory, uint64_t _maxSize) : directory(_directory),
+	                                   maxSize(_maxSize), size(0), sizeKnown(false) {}
+
+	string CompressionCache::defaultDirectory() {
+	#ifdef _WIN32
+		const char *base = getenv("LOCALAPPDATA");
+		if (base != nullptr && *base != '\0') {
+			return (fs::path(base) / "hfworkshop" / "data").string();
+		}
+	#else
+		const char *base = getenv("XDG_CACHE_HOME");
+		if (base != nullptr && *base != '\0') {
+			return (fs::path(base) / "hfworkshop" / "data").string();
+		}
+		const char *home = getenv("HOME");
+		if (home != nullptr && *home != '\0') {
+			return (fs::path(home) / ".cache" / "hfworkshop" / "data").string();
+		}
+	#endif
+		return (fs::path(".hfw_cache") / "data").string();
+	}
+
+	vector<uint8_t> CompressionCache::compress(const vector<uint8_t> &data, uint64_t hash, int level) {
+
+		fs::path entry = fs::path(directory) / (hashToHex(hash) + "_" + to_string(data.size()) +
+		                                         "_" + to_string(level) + ".zlib");
+
+		// The cache is best effort, any error falls back to compressing
+		error_code ec;
+		if (fs::exists(entry, ec)) {
+			try {
+				vector<uint8_t> compressed;
+				l18n::readBinaryFile(entry.string(), compressed);
+				if (zlib::zlib_decompress(compressed) == data) {
+					// Recently used
+					fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+					return compressed;
+				}
+			} catch (const exception &) {}
+			fs::remove(entry, ec);
+		}
+
+		vector<uint8_t> compressed = zlib::zlib_compress(data, level);
+
+		try {
+			fs::create_directories(directory, ec);
+			l18n::writeBinaryFile(entry.string(), compressed);
+			size += compressed.size();
+			evict();
+		} catch (const exception &) {}
+
+		return compressed;
+	}
+
+	void CompressionCache::evict() {
+		if (sizeKnown && size <= maxSize) {
+			return;
+		}
+
+		error_code ec;
+		vector<pair<fs::file_time_type, fs::path>> entries;
+		uint64_t total = 0;
+		for (const auto &e : fs::directory_iterator(directory, ec)) {
+			if (isEntry(e, ec)) {
+				total += e.file_size(ec);
+				entries.emplace_back(e.last_write_time(ec), e.path());
+			}
+		}
+		if (total > maxSize) {
+			// Oldest first
+			sort(entries.begin(), entries.end());
+			for (const auto &e : entries) {
+				if (total <= maxSize) {
+					break;
+				}
+				uint64_t entrySize = fs::file_size(e.second, ec);
+				if (!ec && fs::remove(e.second, ec)) {
+					total -= entrySize;
+				}
+			}
+		}
+		size = total;
+		sizeKnown = true;
+	}
+
+	void CompressionCache::clear() {
+		error_code ec;
+		vector<fs::path> entries;
+		for (const auto &e : fs::directory_iterator(directory, ec)) {
+			if (isEntry(e, ec)) {
+				entries.push_back(e.path());
+			}
+		}
+		for (const auto &path : entries) {
+			fs::remove(path, ec);
+		}
+		size = 0;
+		sizeKnown = true;
+	}
+
+} // hf_workshop
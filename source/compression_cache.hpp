@@ -0,0 +1,62 @@
+/**
+ * HF Workshop - Cache of compressed data files
+ */
+
+#ifndef COMPRESSION_CACHE_HPP
+#define COMPRESSION_CACHE_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint> // uint8_t, uint64_t
+
+namespace hf_workshop {
+
+	/**
+	 * Content-addressed cache of zlib compressed data.
+	 *
+	 * Entries are keyed by the XXH64 hash of the uncompressed data and the
+	 * compression level, and are kept as files in a cache directory so that
+	 * they are reused between runs. A cached entry is only used after checking
+	 * that it inflates back to the same data, so a corrupted or colliding entry
+	 * is never written into the game.
+	 *
+	 * The directory is kept under `maxSize` bytes by removing the entries
+	 * that were least recently used, going by their modification time, which
+	 * is updated whenever an entry is used.
+	 */
+	class CompressionCache {
+	public:
+		static constexpr uint64_t DEFAULT_MAX_SIZE = 256 << 20;
+
+		explicit CompressionCache(const std::string &directory = defaultDirectory(),
+		                          uint64_t maxSize = DEFAULT_MAX_SIZE);
+
+		/**
+		 * Returns `data` compressed with zlib. `hash` must be the XXH64 hash of `data`.
+		 * Compresses and stores the result only if there is no valid cached entry.
+		 */
+		std::vector<uint8_t> compress(const std::vector<uint8_t> &data, uint64_t hash, int level);
+
+		/**
+		 * Per-user cache directory:
+		 * %LOCALAPPDATA%\hfworkshop\data on Windows,
+		 * $XDG_CACHE_HOME/hfworkshop/data or ~/.cache/hfworkshop/data elsewhere.
+		 */
+		static std::string defaultDirectory();
+
+		/// Removes all the entries
+		void clear();
+
+	private:
+		std::string directory;
+		uint64_t maxSize;
+		uint64_t size;  // of the entries, once known
+		bool sizeKnown;
+
+		/// Removes the least recently used entries until they fit in maxSize
+		void evict();
+	};
+
+} // hf_workshop
+
+#endif // COMPRESSION_CACHE_HPP
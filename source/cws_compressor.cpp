@@ -0,0 +1,180 @@
+/**
+ * HF Workshop - Incremental zlib compression of SWF files
+ */
+
+#include "cws_compressor.hpp"
+#include "swf_tags.hpp"
+
+#include <array>     // array
+#include <algorithm> // min, max, mismatch
+#include <limits>    // numeric_limits
+#include <stdexcept> // runtime_error
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		constexpr size_t deflateWindowSize = 32768;
+		constexpr size_t outputChunkSize = 65536;
+
+		/**
+		 * RAII wrapper for a raw deflate stream (no zlib header or trailer).
+		 */
+		class DeflateStream {
+		public:
+			explicit DeflateStream(int level) : zs() {
+				if (deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+					throw runtime_error("zlib: Failed to initialize deflate stream.");
+				}
+			}
+			~DeflateStream() {
+				deflateEnd(&zs);
+			}
+
+			void setDictionary(const uint8_t *dict, size_t len) {
+				if (deflateSetDictionary(&zs, dict, static_cast<uInt>(len)) != Z_OK) {
+					throw runtime_error("zlib: Failed to set deflate dictionary.");
+				}
+			}
+
+			/**
+			 * Compresses `len` bytes and appends the output to `out`.
+			 * With Z_SYNC_FLUSH or Z_FINISH all pending output is written.
+			 */
+			void write(const uint8_t *data, size_t len, int flush, vector<uint8_t> &out) {
+				do {
+					uInt n = static_cast<uInt>(min<size_t>(len, numeric_limits<uInt>::max()));
+					zs.next_in = const_cast<Bytef *>(data);
+					zs.avail_in = n;
+					data += n;
+					len -= n;
+					int f = (len == 0 ? flush : Z_NO_FLUSH);
+					do {
+						size_t have = out.size();
+						out.resize(have + outputChunkSize);
+						zs.next_out = out.data() + have;
+						zs.avail_out = static_cast<uInt>(outputChunkSize);
+						if (deflate(&zs, f) == Z_STREAM_ERROR) {
+							throw runtime_error("zlib: Deflate stream error.");
+						}
+						out.resize(have + outputChunkSize - zs.avail_out);
+					} while (zs.avail_out == 0);
+				} while (len > 0);
+			}
+
+			DeflateStream(const DeflateStream &) = delete;
+			DeflateStream &operator=(const DeflateStream &) = delete;
+		private:
+			z_stream zs;
+		};
+
+		uLong updateAdler(uLong adler, const uint8_t *data, size_t len) {
+			while (len > 0) {
+				uInt n = static_cast<uInt>(min<size_t>(len, numeric_limits<uInt>::max()));
+				adler = adler32(adler, data, n);
+				data += n;
+				len -= n;
+			}
+			return adler;
+		}
+
+		/**
+		 * zlib stream header (RFC 1950) for a 32 KiB window and the given level.
+		 */
+		array<uint8_t, 2> zlibHeader(int level) {
+			uint8_t cmf = 0x78;
+			uint8_t flevel = (level < 2 ? 0 : (level < 6 ? 1 : (level == 6 ? 2 : 3)));
+			unsigned flg = static_cast<unsigned>(flevel << 6);
+			flg += 31 - ((cmf * 256u + flg) % 31);
+			return { cmf, static_cast<uint8_t>(flg) };
+		}
+
+	} // anonymous namespace
+
+	CwsCompressor::CwsCompressor(int _level, size_t _checkpointInterval)
+			: level(_level), checkpointInterval(_checkpointInterval), reusedBytes(0),
+			  body(), deflated(), checkpoints() {}
+
+	void CwsCompressor::reset() {
+		body.clear();
+		body.shrink_to_fit();
+		deflated.clear();
+		deflated.shrink_to_fit();
+		checkpoints.clear();
+		reusedBytes = 0;
+	}
+
+	vector<uint8_t> CwsCompressor::compress(const vector<uint8_t> &fws) {
+
+		// Also validates the signature
+		vector<TagRecord> tags = scanTags(fws.data(), fws.size());
+
+		const uint8_t *in = fws.data() + 8;
+		size_t inLen = fws.size() - 8;
+
+		try {
+			// First byte that differs from the previous export
+			size_t maxCommon = min(inLen, body.size());
+			size_t common = static_cast<size_t>(mismatch(body.begin(), body.begin() + static_cast<ptrdiff_t>(maxCommon), in).first - body.begin());
+
+			// Resume from the last checkpoint before it
+			Checkpoint start{0, 0, adler32(0L, nullptr, 0)};
+			size_t kept = 0;
+			while (kept < checkpoints.size() && checkpoints[kept].in <= common) {
+				start = checkpoints[kept++];
+			}
+			checkpoints.resize(kept);
+			deflated.resize(start.out);
+			deflated.reserve(start.out + (inLen - start.in) / 2);
+			reusedBytes = start.out;
+
+			DeflateStream ds(level);
+			if (start.in > 0) {
+				size_t dictLen = min(start.in, deflateWindowSize);
+				ds.setDictionary(in + start.in - dictLen, dictLen);
+			}
+
+			size_t pos = start.in;
+			uLong adler = start.adler;
+			for (const auto &tag : tags) {
+				size_t boundary = tag.end() - 8;
+				if (boundary >= inLen) {
+					break;
+				}
+				if (boundary <= pos || boundary - pos < checkpointInterval) {
+					continue;
+				}
+				ds.write(in + pos, boundary - pos, Z_SYNC_FLUSH, deflated);
+				adler = updateAdler(adler, in + pos, boundary - pos);
+				pos = boundary;
+				checkpoints.push_back({pos, deflated.size(), adler});
+			}
+			ds.write(in + pos, inLen - pos, Z_FINISH, deflated);
+			adler = updateAdler(adler, in + pos, inLen - pos);
+
+			body.assign(in, in + inLen);
+
+			vector<uint8_t> cws;
+			cws.reserve(8 + 2 + deflated.size() + 4);
+			cws.insert(cws.end(), {'C', 'W', 'S'});
+			// zlib compression requires SWF version 6 or above
+			cws.emplace_back(max<uint8_t>(fws[3], 6));
+			// Uncompressed file length
+			cws.insert(cws.end(), fws.begin() + 4, fws.begin() + 8);
+
+			auto header = zlibHeader(level);
+			cws.insert(cws.end(), header.begin(), header.end());
+			cws.insert(cws.end(), deflated.begin(), deflated.end());
+			cws.insert(cws.end(), { static_cast<uint8_t>(adler >> 24), static_cast<uint8_t>(adler >> 16),
+			                        static_cast<uint8_t>(adler >> 8), static_cast<uint8_t>(adler) });
+			return cws;
+
+		} catch (...) {
+			reset();
+			throw;
+		}
+	}
+
+} // hf_workshop
@@ -0,0 +1,65 @@
+/**
+ * HF Workshop - Incremental zlib compression of SWF files
+ */
+
+#ifndef CWS_COMPRESSOR_HPP
+#define CWS_COMPRESSOR_HPP
+
+#include <vector>
+#include <cstdint> // uint8_t
+#include <cstddef> // size_t
+
+#include <zlib.h>
+
+namespace hf_workshop {
+
+	/**
+	 * Compresses uncompressed SWF files into zlib compressed ('CWS') SWF files.
+	 *
+	 * While compressing, the deflate stream is sync-flushed at tag boundaries
+	 * roughly every `checkpointInterval` bytes. A sync flush ends the output on a
+	 * byte boundary, so the compressed bytes before it can be reused as they are.
+	 * The compressor keeps the previous input, its raw deflate output and the
+	 * checkpoints. On the next call, everything up to the last checkpoint
+	 * before the first changed byte is copied, and deflate is resumed from there
+	 * with the preceding 32 KiB of input as the dictionary.
+	 *
+	 * Re-exporting after replacing a file near the end of the SWF only
+	 * compresses the tags after it.
+	 */
+	class CwsCompressor {
+	public:
+		explicit CwsCompressor(int level = Z_BEST_COMPRESSION, size_t checkpointInterval = 1 << 20);
+
+		/**
+		 * Compresses an uncompressed ('FWS') SWF file.
+		 * Throws std::runtime_error if the input is not an uncompressed SWF
+		 * or if zlib fails.
+		 */
+		std::vector<uint8_t> compress(const std::vector<uint8_t> &fws);
+
+		/// Forgets the previous export
+		void reset();
+
+		/// Number of compressed bytes reused from the previous export in the last call
+		inline size_t getReusedBytes() const { return reusedBytes; }
+
+	private:
+		struct Checkpoint {
+			size_t in;   // offset in the SWF body
+			size_t out;  // offset in the raw deflate stream
+			uLong adler; // adler-32 of the body up to 'in'
+		};
+
+		int level;
+		size_t checkpointInterval;
+		size_t reusedBytes;
+
+		std::vector<uint8_t> body;     // SWF without the 8 bytes of the file header
+		std::vector<uint8_t> deflated; // raw deflate stream of 'body'
+		std::vector<Checkpoint> checkpoints;
+	};
+
+} // hf_workshop
+
+#endif // CWS_COMPRESSOR_HPP
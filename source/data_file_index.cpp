@@ -0,0 +1,330 @@
+/**
+ * HF Workshop - Data file index
+ */
+
+#include "data_file_index.hpp"
+
+#include <stdexcept> // runtime_error, out_of_range
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		constexpr int MAX_DEPTH = 1024;
+
+		namespace amf3 {
+			constexpr uint8_t UNDEFINED = 0x00;
+			constexpr uint8_t NULL_MARKER = 0x01;
+			constexpr uint8_t FALSE_MARKER = 0x02;
+			constexpr uint8_t TRUE_MARKER = 0x03;
+			constexpr uint8_t INTEGER = 0x04;
+			constexpr uint8_t DOUBLE = 0x05;
+			constexpr uint8_t STRING = 0x06;
+			constexpr uint8_t XML_DOC = 0x07;
+			constexpr uint8_t DATE = 0x08;
+			constexpr uint8_t ARRAY = 0x09;
+			constexpr uint8_t OBJECT = 0x0A;
+			constexpr uint8_t XML = 0x0B;
+			constexpr uint8_t BYTE_ARRAY = 0x0C;
+			constexpr uint8_t VECTOR_INT = 0x0D;
+			constexpr uint8_t VECTOR_UINT = 0x0E;
+			constexpr uint8_t VECTOR_DOUBLE = 0x0F;
+			constexpr uint8_t VECTOR_OBJECT = 0x10;
+			constexpr uint8_t DICTIONARY = 0x11;
+		}
+
+		/**
+		 * Skips over AMF3 values. Only the traits table is kept, as the
+		 * number of sealed members of an object can't be known without it;
+		 * references to strings and objects take no further bytes.
+		 */
+		class Amf3Skipper {
+		public:
+			Amf3Skipper(const uint8_t *_data, size_t _size, size_t _pos) : data(_data), size(_size), pos(_pos), traits() {}
+			Amf3Skipper(const Amf3Skipper &) = delete;
+			Amf3Skipper &operator=(const Amf3Skipper &) = delete;
+
+			size_t skip() {
+				value(0);
+				return pos;
+			}
+
+		private:
+			struct Traits {
+				bool dynamic;
+				size_t sealedCount;
+			};
+
+			const uint8_t *data;
+			size_t size;
+			size_t pos;
+			vector<Traits> traits;
+
+			void need(size_t bytes) {
+				if (pos > size || size - pos < bytes) {
+					throw runtime_error("AMF3 value is truncated.");
+				}
+			}
+
+			uint32_t u29() {
+				uint32_t value = 0;
+				for (int i = 0; i < 4; ++i) {
+					need(1);
+					uint8_t b = data[pos++];
+					if (i == 3) {
+						return (value << 8) | b;
+					}
+					value = (value << 7) | (b & 0x7F);
+					if ((b & 0x80) == 0) {
+						break;
+					}
+				}
+				return value;
+			}
+
+			/**
+			 * Reads the U29 that starts strings, byte arrays and such.
+			 * Returns the inline length, or 0 for a reference.
+			 */
+			size_t inlineLength() {
+				uint32_t u = u29();
+				return (u & 1) != 0 ? (u >> 1) : 0;
+			}
+
+			void skipBytes(size_t bytes) {
+				need(bytes);
+				pos += bytes;
+			}
+
+			void skipString() {
+				skipBytes(inlineLength());
+			}
+
+			void value(int depth) {
+				if (depth > MAX_DEPTH) {
+					throw runtime_error("AMF3 value is nested too deeply.");
+				}
+				need(1);
+				uint8_t marker = data[pos++];
+
+				switch (marker) {
+					case amf3::UNDEFINED:
+					case amf3::NULL_MARKER:
+					case amf3::FALSE_MARKER:
+					case amf3::TRUE_MARKER:
+						break;
+					case amf3::INTEGER:
+						u29();
+						break;
+					case amf3::DOUBLE:
+						skipBytes(8);
+						break;
+					case amf3::STRING:
+					case amf3::XML_DOC:
+					case amf3::XML:
+					case amf3::BYTE_ARRAY:
+						skipBytes(inlineLength());
+						break;
+					case amf3::DATE:
+						if ((u29() & 1) != 0) {
+							skipBytes(8);
+						}
+						break;
+					case amf3::ARRAY: {
+						uint32_t u = u29();
+						if ((u & 1) == 0) {
+							break;
+						}
+						// Associative part, up to the empty string
+						while (!emptyString()) {
+							value(depth + 1);
+						}
+						for (size_t i = 0, n = u >> 1; i < n; ++i) {
+							value(depth + 1);
+						}
+						break;
+					}
+					case amf3::OBJECT:
+						object(depth);
+						break;
+					case amf3::VECTOR_INT:
+					case amf3::VECTOR_UINT:
+					case amf3::VECTOR_DOUBLE: {
+						uint32_t u = u29();
+						if ((u & 1) == 0) {
+							break;
+						}
+						size_t count = u >> 1;
+						size_t itemBytes = (marker == amf3::VECTOR_DOUBLE ? 8 : 4);
+						need(1);
+						++pos; // fixed length
+						if (count > (size - pos) / itemBytes) {
+							throw runtime_error("AMF3 value is truncated.");
+						}
+						pos += count * itemBytes;
+						break;
+					}
+					case amf3::VECTOR_OBJECT: {
+						uint32_t u = u29();
+						if ((u & 1) == 0) {
+							break;
+						}
+						skipBytes(1); // fixed length
+						skipString(); // type name
+						for (size_t i = 0, n = u >> 1; i < n; ++i) {
+							value(depth + 1);
+						}
+						break;
+					}
+					case amf3::DICTIONARY: {
+						uint32_t u = u29();
+						if ((u & 1) == 0) {
+							break;
+						}
+						skipBytes(1); // weak keys
+						for (size_t i = 0, n = u >> 1; i < n; ++i) {
+							value(depth + 1);
+							value(depth + 1);
+						}
+						break;
+					}
+					default:
+						throw runtime_error("Unknown AMF3 marker " + to_string(marker) + ".");
+				}
+			}
+
+			void object(int depth) {
+				uint32_t u = u29();
+				if ((u & 1) == 0) {
+					return; // reference
+				}
+
+				Traits t;
+				if ((u & 3) == 1) {
+					size_t index = u >> 2;
+					if (index >= traits.size()) {
+						throw runtime_error("AMF3 traits reference is out of range.");
+					}
+					t = traits[index];
+				} else {
+					if ((u & 7) == 7) {
+						// The class alone knows how its data is written
+						throw runtime_error("Externalizable AMF3 objects are not supported.");
+					}
+					t = {(u & 8) != 0, u >> 4};
+					skipString(); // class name
+					for (size_t i = 0; i < t.sealedCount; ++i) {
+						skipString();
+					}
+					traits.push_back(t);
+				}
+
+				for (size_t i = 0; i < t.sealedCount; ++i) {
+					value(depth + 1);
+				}
+				if (t.dynamic) {
+					while (!emptyString()) {
+						value(depth + 1);
+					}
+				}
+			}
+
+			/**
+			 * Skips a member name, returning true if it is the empty string
+			 * that ends the dynamic members.
+			 */
+			bool emptyString() {
+				uint32_t u = u29();
+				if (u == 1) {
+					return true;
+				}
+				if ((u & 1) != 0) {
+					skipBytes(u >> 1);
+				}
+				return false;
+			}
+		};
+
+		uint32_t readU32(const vector<uint8_t> &data, size_t pos) {
+			if (pos > data.size() || data.size() - pos < 4) {
+				throw runtime_error("Data file is truncated.");
+			}
+			return (static_cast<uint32_t>(data[pos]) << 24) | (static_cast<uint32_t>(data[pos+1]) << 16) |
+			       (static_cast<uint32_t>(data[pos+2]) << 8) | data[pos+3];
+		}
+
+		/// Indexes `count` elements starting at `pos`, moving `pos` past them
+		DataSection readSection(const vector<uint8_t> &data, size_t &pos, const char *name,
+		                        size_t count, size_t countOffset) {
+			DataSection section{name, countOffset, {}};
+			// Every element takes at least a byte
+			if (count > data.size() - pos) {
+				throw runtime_error("Data file is truncated.");
+			}
+			section.elements.reserve(count);
+			for (size_t i = 0; i < count; ++i) {
+				size_t end = skipAmf3Value(data.data(), data.size(), pos);
+				section.elements.push_back({pos, end});
+				pos = end;
+			}
+			return section;
+		}
+
+		/// Indexes a section preceded by its count
+		DataSection readCountedSection(const vector<uint8_t> &data, size_t &pos, const char *name) {
+			size_t countOffset = pos;
+			size_t count = readU32(data, pos);
+			pos += 4;
+			return readSection(data, pos, name, count, countOffset);
+		}
+
+	} // anonymous namespace
+
+	const DataSection &DataFileIndex::section(string_view name) const {
+		for (const auto &s : sections) {
+			if (s.name == name) {
+				return s;
+			}
+		}
+		throw out_of_range("No section '" + std::string(name) + "' in data file.");
+	}
+
+	size_t skipAmf3Value(const uint8_t *data, size_t size, size_t pos) {
+		return Amf3Skipper(data, size, pos).skip();
+	}
+
+	DataFileIndex indexDataFile(const vector<uint8_t> &data) {
+		DataFileIndex index{{}, 0, {}};
+
+		// The file type is an UTF string: a big-endian 16 bit length and the characters
+		if (data.size() < 2) {
+			throw runtime_error("Data file is truncated.");
+		}
+		size_t len = static_cast<size_t>((data[0] << 8) | data[1]);
+		if (data.size() - 2 < len) {
+			throw runtime_error("Data file is truncated.");
+		}
+		index.fileType.assign(data.begin() + 2, data.begin() + 2 + static_cast<ptrdiff_t>(len));
+		index.headerEnd = 2 + len;
+
+		size_t pos = index.headerEnd;
+		const string &type = index.fileType;
+		if (type == "limbInfo" || type == "limbInfoO") {
+			index.sections.push_back(readCountedSection(data, pos, "LimbPic"));
+			size_t numLP = index.sections.back().elements.size();
+			index.sections.push_back(readSection(data, pos, "PNG", numLP, DataSection::NO_COUNT));
+			index.sections.push_back(readCountedSection(data, pos, "Limb"));
+		} else if (type == "gdat") {
+			index.sections.push_back(readCountedSection(data, pos, "Attack"));
+			index.sections.push_back(readCountedSection(data, pos, "PtWithName"));
+		} else if (type == "Spt" || type == "SptO") {
+			index.sections.push_back(readSection(data, pos, "Spt", 1, DataSection::NO_COUNT));
+		} else if (type == "Bg" || type == "BgO") {
+			index.sections.push_back(readSection(data, pos, "BgInfoFile", 1, DataSection::NO_COUNT));
+		}
+		return index;
+	}
+
+} // hf_workshop
@@ -0,0 +1,73 @@
+/**
+ * HF Workshop - Data file index
+ *
+ * Finds where the elements of an inflated data file are by reading only
+ * AMF3 markers and lengths, without decoding the elements.
+ */
+
+#ifndef DATA_FILE_INDEX_HPP
+#define DATA_FILE_INDEX_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint> // uint8_t
+#include <cstddef> // size_t
+
+namespace hf_workshop {
+
+	/// Byte range of one AMF3 value of a data file
+	struct DataElement {
+		size_t begin;
+		size_t end;
+	};
+
+	/**
+	 * A run of elements of the same kind, such as the LimbPics or the PNGs
+	 * of a limb info file.
+	 */
+	struct DataSection {
+		static constexpr size_t NO_COUNT = static_cast<size_t>(-1);
+
+		std::string name;        // "LimbPic", "PNG", "Limb", "Attack", "PtWithName", "Spt" or "BgInfoFile"
+		size_t countOffset;      // position of the big-endian 32 bit count, NO_COUNT if there's none
+		std::vector<DataElement> elements;
+	};
+
+	/**
+	 * Layout of an inflated data file.
+	 *
+	 * Limb info files are the file type, the number of LimbPics, the LimbPics,
+	 * their PNGs (or null), the number of Limbs and the Limbs. Game data files
+	 * are the file type, the Attacks and the PtWithNames, each run preceded
+	 * by its count. Sprite and background files hold a single element.
+	 */
+	struct DataFileIndex {
+		std::string fileType;
+		size_t headerEnd;  // end of the file type
+		std::vector<DataSection> sections;
+
+		/**
+		 * The section with the given name.
+		 * Throws std::out_of_range if the file has none.
+		 */
+		const DataSection &section(std::string_view name) const;
+	};
+
+	/**
+	 * Indexes an inflated data file. Sections are only found for known file
+	 * types. Throws std::runtime_error if the file is truncated or has
+	 * values that can't be skipped over.
+	 */
+	DataFileIndex indexDataFile(const std::vector<uint8_t> &data);
+
+	/**
+	 * Position right after the AMF3 value at `data[pos]`. The value is read
+	 * with reference tables of its own, as each element of a data file is.
+	 * Throws std::runtime_error if the value is truncated or externalizable.
+	 */
+	size_t skipAmf3Value(const uint8_t *data, size_t size, size_t pos);
+
+} // hf_workshop
+
+#endif // DATA_FILE_INDEX_HPP
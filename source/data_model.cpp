@@ -0,0 +1,339 @@
+/**
+ * HF Workshop - Data model
+ */
+
+#include "data_model.hpp"
+
+#include <cstdio>    // snprintf
+#include <cstdlib>   // strtod
+#include <cstring>   // memcmp
+#include <stdexcept> // runtime_error, out_of_range
+#include <utility>   // move
+
+#include "amf_bytes.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	using namespace amf_bytes;
+
+	DataModel::DataModel(vector<uint8_t> _data)
+		: data(move(_data)), fileIndex(indexDataFile(data)), amf0(false), sectionRecords(),
+		  shapes(), shapeIds(), records(), values(), pendingValues(), pendingNames(), shapeKey() {
+
+		const string &type = fileIndex.fileType;
+		if (type == "limbInfo" || type == "Spt" || type == "Bg" || type == "gdat") {
+			// gdat is AMF0 in byte arrays in both versions
+			amf0 = true;
+		} else if (type != "limbInfoO" && type != "SptO" && type != "BgO") {
+			throw runtime_error("Unknown data file type '" + type + "'.");
+		}
+
+		for (const DataSection &section : fileIndex.sections) {
+			sectionRecords.emplace_back();
+			if (section.name == "PNG") {
+				continue;
+			}
+			auto &elementRecords = sectionRecords.back();
+			elementRecords.reserve(section.elements.size());
+
+			for (const DataElement &e : section.elements) {
+				// Each element has reference tables of its own
+				DataValue v;
+				if (amf0) {
+					Reader outer(data.data(), e.end, e.begin);
+					string_view bytes = outer.byteArray();
+					size_t begin = static_cast<size_t>(reinterpret_cast<const uint8_t *>(bytes.data()) - data.data());
+					Reader r(data.data(), begin + bytes.size(), begin);
+					vector<uint32_t> objects;
+					v = amf0Value(r, objects, 0);
+				} else {
+					Reader r(data.data(), e.end, e.begin);
+					Amf3Tables tables{};
+					v = amf3Value(r, tables, 0);
+				}
+				if (v.type != DataType::record) {
+					throw runtime_error("Element of '" + section.name + "' is not an object.");
+				}
+				elementRecords.emplace_back(v.ref);
+			}
+		}
+	}
+
+	string dataNumberText(double d) {
+		char buffer[32];
+		for (int precision = 1; precision <= 17; ++precision) {
+			snprintf(buffer, sizeof(buffer), "%.*g", precision, d);
+			double back = strtod(buffer, nullptr);
+			if (memcmp(&back, &d, sizeof(d)) == 0) {
+				break;
+			}
+		}
+		return buffer;
+	}
+
+	const vector<uint32_t> &DataModel::elements(string_view section) const {
+		for (size_t i = 0; i < fileIndex.sections.size(); ++i) {
+			if (fileIndex.sections[i].name == section) {
+				return sectionRecords[i];
+			}
+		}
+		throw out_of_range("No section '" + std::string(section) + "' in data file.");
+	}
+
+	const DataValue *DataModel::field(uint32_t r, string_view name) const {
+		const DataRecord &rec = records[r];
+		const auto &fields = shapes[rec.shape].fields;
+		for (size_t i = 0; i < fields.size(); ++i) {
+			if (fields[i] == name) {
+				return &values[rec.first + i];
+			}
+		}
+		return nullptr;
+	}
+
+	uint32_t DataModel::internShape(string_view className, size_t namesBegin, size_t denseCount, bool array) {
+		bool dense = array && namesBegin == pendingNames.size();
+
+		// Class name, member names and the kind, separated by NULs
+		shapeKey.assign(className);
+		shapeKey += '\0';
+		for (size_t i = namesBegin; i < pendingNames.size(); ++i) {
+			shapeKey += pendingNames[i];
+			shapeKey += '\0';
+		}
+		if (!dense) {
+			for (size_t i = 0; i < denseCount; ++i) {
+				shapeKey += to_string(i);
+				shapeKey += '\0';
+			}
+		}
+		shapeKey += (dense ? 'D' : array ? 'A' : 'O');
+
+		auto it = shapeIds.find(shapeKey);
+		if (it != shapeIds.end()) {
+			return it->second;
+		}
+
+		DataShape shape{std::string(className), {}, array};
+		for (size_t i = namesBegin; i < pendingNames.size(); ++i) {
+			shape.fields.emplace_back(pendingNames[i]);
+		}
+		if (!dense) {
+			for (size_t i = 0; i < denseCount; ++i) {
+				shape.fields.emplace_back(to_string(i));
+			}
+		}
+
+		auto id = static_cast<uint32_t>(shapes.size());
+		shapes.emplace_back(move(shape));
+		shapeIds.emplace(shapeKey, id);
+		return id;
+	}
+
+	uint32_t DataModel::beginRecord(vector<uint32_t> &objects) {
+		auto r = static_cast<uint32_t>(records.size());
+		records.push_back({0, 0, 0});
+		objects.emplace_back(r);
+		return r;
+	}
+
+	void DataModel::endRecord(uint32_t r, size_t valuesBegin, size_t namesBegin, string_view className,
+	                          size_t denseCount, bool array) {
+		DataRecord &rec = records[r];
+		rec.shape = internShape(className, namesBegin, denseCount, array);
+		rec.first = static_cast<uint32_t>(values.size());
+		rec.count = static_cast<uint32_t>(pendingValues.size() - valuesBegin);
+		values.insert(values.end(), pendingValues.begin() + static_cast<ptrdiff_t>(valuesBegin), pendingValues.end());
+		pendingValues.resize(valuesBegin);
+		pendingNames.resize(namesBegin);
+	}
+
+	DataValue DataModel::stringValue(string_view s) const {
+		auto offset = static_cast<size_t>(reinterpret_cast<const uint8_t *>(s.data()) - data.data());
+		return {DataType::string, static_cast<uint32_t>(offset), static_cast<uint32_t>(s.size()), 0};
+	}
+
+	DataValue DataModel::amf0Value(Reader &r, vector<uint32_t> &objects, int depth) {
+		if (depth > MAX_DEPTH) {
+			throw runtime_error("AMF0 value is nested too deeply.");
+		}
+		uint8_t marker = r.u8();
+
+		switch (marker) {
+			case amf0::NUMBER:
+				return {DataType::number, 0, 0, r.number()};
+			case amf0::BOOLEAN:
+				return {DataType::boolean, 0, 0, r.u8() != 0 ? 1.0 : 0.0};
+			case amf0::STRING:
+				return stringValue(r.str(r.be(2)));
+			case amf0::LONG_STRING:
+				return stringValue(r.str(r.be(4)));
+			case amf0::NULL_MARKER:
+				return {DataType::null, 0, 0, 0};
+			case amf0::UNDEFINED:
+				return {DataType::undefined, 0, 0, 0};
+			case amf0::REFERENCE: {
+				uint32_t index = r.be(2);
+				if (index >= objects.size()) {
+					throw runtime_error("AMF0 reference is out of range.");
+				}
+				return {DataType::record, objects[index], 0, 0};
+			}
+			case amf0::OBJECT:
+			case amf0::TYPED_OBJECT:
+			case amf0::ECMA_ARRAY: {
+				string_view className;
+				if (marker == amf0::TYPED_OBJECT) {
+					className = r.str(r.be(2));
+				} else if (marker == amf0::ECMA_ARRAY) {
+					r.bytes(4); // associative count, not reliable
+				}
+				uint32_t rec = beginRecord(objects);
+				size_t valuesBegin = pendingValues.size(), namesBegin = pendingNames.size();
+
+				for (size_t len = r.be(2); len != 0; len = r.be(2)) {
+					pendingNames.emplace_back(r.str(len));
+					DataValue v = amf0Value(r, objects, depth + 1);
+					pendingValues.emplace_back(v);
+				}
+				if (r.u8() != amf0::OBJECT_END) {
+					throw runtime_error("Empty AMF0 property name.");
+				}
+
+				bool array = (marker == amf0::ECMA_ARRAY);
+				size_t count = pendingNames.size() - namesBegin;
+				bool dense = array;
+				for (size_t i = 0; dense && i < count; ++i) {
+					dense = (pendingNames[namesBegin + i] == to_string(i));
+				}
+				if (dense) {
+					pendingNames.resize(namesBegin);
+				}
+				endRecord(rec, valuesBegin, namesBegin, className, 0, array);
+				return {DataType::record, rec, 0, 0};
+			}
+			case amf0::STRICT_ARRAY: {
+				uint32_t count = r.be(4);
+				uint32_t rec = beginRecord(objects);
+				size_t valuesBegin = pendingValues.size(), namesBegin = pendingNames.size();
+				for (uint32_t i = 0; i < count; ++i) {
+					DataValue v = amf0Value(r, objects, depth + 1);
+					pendingValues.emplace_back(v);
+				}
+				endRecord(rec, valuesBegin, namesBegin, {}, 0, true);
+				return {DataType::record, rec, 0, 0};
+			}
+			default:
+				throw runtime_error("AMF0 marker " + to_string(marker) + " is not kept by the data model.");
+		}
+	}
+
+	DataModel::Amf3Tables::~Amf3Tables() = default;
+
+	string_view DataModel::amf3String(Reader &r, Amf3Tables &tables) {
+		uint32_t u = r.u29();
+		if ((u & 1) == 0) {
+			if ((u >> 1) >= tables.strings.size()) {
+				throw runtime_error("AMF3 string reference is out of range.");
+			}
+			auto s = tables.strings[u >> 1];
+			return string_view(reinterpret_cast<const char *>(data.data()) + s.first, s.second);
+		}
+		string_view s = r.str(u >> 1);
+		if (!s.empty()) {
+			tables.strings.emplace_back(static_cast<uint32_t>(r.pos - s.size()), static_cast<uint32_t>(s.size()));
+		}
+		return s;
+	}
+
+	DataValue DataModel::amf3Value(Reader &r, Amf3Tables &tables, int depth) {
+		if (depth > MAX_DEPTH) {
+			throw runtime_error("AMF3 value is nested too deeply.");
+		}
+		uint8_t marker = r.u8();
+
+		switch (marker) {
+			case amf3::UNDEFINED:
+				return {DataType::undefined, 0, 0, 0};
+			case amf3::NULL_MARKER:
+				return {DataType::null, 0, 0, 0};
+			case amf3::FALSE_MARKER:
+			case amf3::TRUE_MARKER:
+				return {DataType::boolean, 0, 0, marker == amf3::TRUE_MARKER ? 1.0 : 0.0};
+			case amf3::INTEGER: {
+				uint32_t u = r.u29();
+				// 29 bit two's complement
+				long long n = (u & 0x10000000) ? static_cast<long long>(u) - 0x20000000 : static_cast<long long>(u);
+				return {DataType::number, 0, 0, static_cast<double>(n)};
+			}
+			case amf3::DOUBLE:
+				return {DataType::number, 0, 0, r.number()};
+			case amf3::STRING:
+				return stringValue(amf3String(r, tables));
+			case amf3::ARRAY:
+			case amf3::OBJECT: {
+				uint32_t u = r.u29();
+				if ((u & 1) == 0) {
+					if ((u >> 1) >= tables.objects.size()) {
+						throw runtime_error("AMF3 object reference is out of range.");
+					}
+					return {DataType::record, tables.objects[u >> 1], 0, 0};
+				}
+				uint32_t rec = beginRecord(tables.objects);
+				size_t valuesBegin = pendingValues.size(), namesBegin = pendingNames.size();
+				string_view className;
+				bool dynamic = true;
+				size_t denseCount = 0;
+
+				if (marker == amf3::ARRAY) {
+					denseCount = u >> 1;
+				} else {
+					size_t traitsIndex;
+					if ((u & 3) == 1) {
+						traitsIndex = u >> 2;
+						if (traitsIndex >= tables.traits.size()) {
+							throw runtime_error("AMF3 traits reference is out of range.");
+						}
+					} else {
+						if ((u & 7) == 7) {
+							throw runtime_error("Externalizable AMF3 objects are not kept by the data model.");
+						}
+						Amf3Tables::Traits t{amf3String(r, tables), {}, (u & 8) != 0};
+						for (size_t i = 0, n = u >> 4; i < n; ++i) {
+							t.sealed.emplace_back(amf3String(r, tables));
+						}
+						traitsIndex = tables.traits.size();
+						tables.traits.push_back(move(t));
+					}
+					className = tables.traits[traitsIndex].className;
+					dynamic = tables.traits[traitsIndex].dynamic;
+					for (size_t i = 0; i < tables.traits[traitsIndex].sealed.size(); ++i) {
+						pendingNames.emplace_back(tables.traits[traitsIndex].sealed[i]);
+						DataValue v = amf3Value(r, tables, depth + 1);
+						pendingValues.emplace_back(v);
+					}
+				}
+
+				if (dynamic) {
+					for (string_view key = amf3String(r, tables); !key.empty(); key = amf3String(r, tables)) {
+						pendingNames.emplace_back(key);
+						DataValue v = amf3Value(r, tables, depth + 1);
+						pendingValues.emplace_back(v);
+					}
+				}
+				// Dense values come after the associative ones, named by index
+				for (size_t i = 0; i < denseCount; ++i) {
+					DataValue v = amf3Value(r, tables, depth + 1);
+					pendingValues.emplace_back(v);
+				}
+				endRecord(rec, valuesBegin, namesBegin, className, denseCount, marker == amf3::ARRAY);
+				return {DataType::record, rec, 0, 0};
+			}
+			default:
+				throw runtime_error("AMF3 marker " + to_string(marker) + " is not kept by the data model.");
+		}
+	}
+
+} // hf_workshop
@@ -0,0 +1,154 @@
+/**
+ * HF Workshop - Data model
+ *
+ * Typed in-memory model of the elements of data files, decoded straight
+ * from their AMF0 or AMF3 bytes.
+ */
+
+#ifndef DATA_MODEL_HPP
+#define DATA_MODEL_HPP
+
+#include <memory>  // unique_ptr
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cstdint> // uint8_t, uint32_t
+#include <cstddef> // size_t
+
+#include "data_file_index.hpp"
+
+namespace hf_workshop {
+
+	namespace amf_bytes {
+		class Reader;
+	}
+
+	enum class DataType : uint8_t {undefined, null, boolean, number, string, record};
+
+	/// Shortest text that reads back as the same number
+	std::string dataNumberText(double d);
+
+	/**
+	 * A value of a data element. Strings point into the bytes of the
+	 * data file, objects and arrays are records.
+	 */
+	struct DataValue {
+		DataType type;
+		uint32_t ref;     // offset of a string, or index of a record
+		uint32_t length;  // of a string
+		double number;    // number, or 1/0 for a boolean
+	};
+
+	/**
+	 * Layout shared by records: the class name and the member names, in
+	 * order. Dense arrays have no member names.
+	 */
+	struct DataShape {
+		std::string className;  // empty for anonymous objects and arrays
+		std::vector<std::string> fields;
+		bool array;
+	};
+
+	/// An object or an array; its values are contiguous
+	struct DataRecord {
+		uint32_t shape;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	/**
+	 * The elements of an inflated data file, decoded into records.
+	 *
+	 * Objects of the same class and members share a shape, so a record is
+	 * just its values. Elements of HF v0.7 (AMF0 in byte arrays) and HFX (AMF3) give
+	 * the same model.
+	 */
+	class DataModel {
+	public:
+		/**
+		 * Decodes a data file. Throws std::runtime_error if the file is
+		 * malformed or holds values the model doesn't keep, such as dates,
+		 * XML and byte arrays, which are left to the generic path.
+		 */
+		explicit DataModel(std::vector<uint8_t> data);
+
+		const DataFileIndex &index() const { return fileIndex; }
+		const std::vector<uint8_t> &bytes() const { return data; }
+
+		/// True if the elements are AMF0 in byte arrays (HF v0.7)
+		bool isAmf0() const { return amf0; }
+
+		/**
+		 * Records of the elements of a section, empty for sections of
+		 * PNGs. Throws std::out_of_range if the file has no such section.
+		 */
+		const std::vector<uint32_t> &elements(std::string_view section) const;
+
+		const DataRecord &record(uint32_t r) const { return records[r]; }
+		const DataShape &shape(uint32_t r) const { return shapes[records[r].shape]; }
+		const DataValue &value(uint32_t r, size_t i) const { return values[records[r].first + i]; }
+		size_t recordCount() const { return records.size(); }
+
+		/// A member by name, nullptr if the record has none
+		const DataValue *field(uint32_t r, std::string_view name) const;
+
+		std::string_view text(const DataValue &v) const {
+			return std::string_view(reinterpret_cast<const char *>(data.data()) + v.ref, v.length);
+		}
+
+	private:
+		/// AMF3 reference tables of one element
+		struct Amf3Tables {
+			std::vector<std::pair<uint32_t, uint32_t>> strings;  // offset, length
+			struct Traits {
+				std::string_view className;
+				std::vector<std::string_view> sealed;
+				bool dynamic;
+			};
+			std::vector<Traits> traits;
+			std::vector<uint32_t> objects;  // records
+
+			~Amf3Tables();
+		};
+
+		std::vector<uint8_t> data;
+		DataFileIndex fileIndex;
+		bool amf0;
+		std::vector<std::vector<uint32_t>> sectionRecords;  // parallel to fileIndex.sections
+
+		std::vector<DataShape> shapes;
+		std::unordered_map<std::string, uint32_t> shapeIds;
+		std::vector<DataRecord> records;
+		std::vector<DataValue> values;
+
+		// Stacks of the records being decoded
+		std::vector<DataValue> pendingValues;
+		std::vector<std::string_view> pendingNames;
+		std::string shapeKey;
+
+		uint32_t internShape(std::string_view className, size_t namesBegin, size_t denseCount, bool array);
+
+		/// Adds a record before its values are known, so that they can refer to it
+		uint32_t beginRecord(std::vector<uint32_t> &objects);
+
+		/// Moves the values and names decoded since `valuesBegin` and `namesBegin` into record `r`
+		void endRecord(uint32_t r, size_t valuesBegin, size_t namesBegin, std::string_view className,
+		               size_t denseCount, bool array);
+
+		DataValue stringValue(std::string_view s) const;
+		DataValue amf0Value(amf_bytes::Reader &r, std::vector<uint32_t> &objects, int depth);
+		DataValue amf3Value(amf_bytes::Reader &r, Amf3Tables &tables, int depth);
+		std::string_view amf3String(amf_bytes::Reader &r, Amf3Tables &tables);
+	};
+
+	/// A decoded data file of the game
+	struct DecodedDataFile {
+		size_t id;         // of the tag
+		std::string name;  // symbol name of the tag
+		std::unique_ptr<DataModel> model;
+	};
+
+} // hf_workshop
+
+#endif // DATA_MODEL_HPP
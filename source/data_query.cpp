@@ -0,0 +1,483 @@
+/**
+ * HF Workshop - Data queries
+ */
+
+#include "data_query.hpp"
+
+#include <algorithm> // sort, unique, lower_bound, upper_bound
+#include <cmath>     // isnan
+#include <cstdlib>   // strtod
+#include <stdexcept> // invalid_argument
+#include <utility>   // move
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		/// Arrays can hold themselves by reference, so the items are only followed this deep
+		constexpr int MAX_ARRAY_DEPTH = 64;
+
+		/// Objects checked by a thread at a time
+		constexpr size_t SCAN_CHUNK = 256;
+
+		struct Token {
+			string text;
+			bool quoted;
+		};
+
+		bool isOperatorChar(char c) {
+			return c == '=' || c == '!' || c == '<' || c == '>' || c == '~';
+		}
+
+		vector<Token> tokenize(string_view text) {
+			vector<Token> tokens;
+			size_t i = 0;
+			while (i < text.size()) {
+				char c = text[i];
+				if (c == ' ' || c == '\t') {
+					++i;
+				} else if (c == '"' || c == '\'') {
+					size_t end = text.find(c, i + 1);
+					if (end == string_view::npos) {
+						throw invalid_argument("Missing closing quote.");
+					}
+					tokens.push_back({string(text.substr(i + 1, end - i - 1)), true});
+					i = end + 1;
+				} else if (isOperatorChar(c)) {
+					size_t begin = i;
+					while (i < text.size() && isOperatorChar(text[i])) {
+						++i;
+					}
+					tokens.push_back({string(text.substr(begin, i - begin)), false});
+				} else {
+					size_t begin = i;
+					while (i < text.size() && text[i] != ' ' && text[i] != '\t' && !isOperatorChar(text[i]) &&
+					       text[i] != '"' && text[i] != '\'') {
+						++i;
+					}
+					tokens.push_back({string(text.substr(begin, i - begin)), false});
+				}
+			}
+			return tokens;
+		}
+
+		DataQueryOp parseOperator(const Token &t) {
+			if (!t.quoted) {
+				if (t.text == "=" || t.text == "==") {
+					return DataQueryOp::equal;
+				} else if (t.text == "!=") {
+					return DataQueryOp::notEqual;
+				} else if (t.text == "<") {
+					return DataQueryOp::less;
+				} else if (t.text == "<=") {
+					return DataQueryOp::lessEqual;
+				} else if (t.text == ">") {
+					return DataQueryOp::greater;
+				} else if (t.text == ">=") {
+					return DataQueryOp::greaterEqual;
+				} else if (t.text == "~") {
+					return DataQueryOp::contains;
+				}
+			}
+			throw invalid_argument("Unknown operator '" + t.text + "'.");
+		}
+
+		bool sameNumber(double a, double b) {
+			return !(a < b) && !(b < a);
+		}
+
+		bool valueEquals(const DataModel &model, const DataValue &v, const DataQueryCondition &c) {
+			switch (v.type) {
+				case DataType::number:
+					return c.number && sameNumber(v.number, *c.number);
+				case DataType::boolean:
+					return c.boolean && (v.number > 0) == *c.boolean;
+				case DataType::string:
+					return model.text(v) == c.text;
+				case DataType::undefined:
+				case DataType::null:
+				case DataType::record:
+				default:
+					return false;
+			}
+		}
+
+		bool valueMatches(const DataModel &model, const DataValue &v, const DataQueryCondition &c) {
+			bool isNumber = v.type == DataType::number && c.number;
+			switch (c.op) {
+				case DataQueryOp::equal:
+					return valueEquals(model, v, c);
+				case DataQueryOp::less:
+					return isNumber && v.number < *c.number;
+				case DataQueryOp::lessEqual:
+					return isNumber && v.number <= *c.number;
+				case DataQueryOp::greater:
+					return isNumber && v.number > *c.number;
+				case DataQueryOp::greaterEqual:
+					return isNumber && v.number >= *c.number;
+				case DataQueryOp::contains:
+					return v.type == DataType::string && model.text(v).find(c.text) != string_view::npos;
+				case DataQueryOp::notEqual:
+				default:
+					return false;  // checked against all the values by the caller
+			}
+		}
+
+		string booleanKey(bool b) {
+			return b ? "btrue" : "bfalse";
+		}
+
+		void addPosting(vector<uint32_t> &list, uint32_t o) {
+			if (list.empty() || list.back() != o) {
+				list.emplace_back(o);
+			}
+		}
+
+	} // anonymous namespace
+
+	DataQuery parseDataQuery(string_view text) {
+		vector<Token> tokens = tokenize(text);
+		if (tokens.empty()) {
+			throw invalid_argument("Empty query.");
+		}
+
+		DataQuery query{tokens[0].text, {}};
+		size_t i = 1;
+		if (i < tokens.size() && !tokens[i].quoted && tokens[i].text == "where") {
+			++i;
+		}
+		while (i < tokens.size()) {
+			if (tokens.size() - i < 3) {
+				throw invalid_argument("Incomplete condition after '" + tokens[i - 1].text + "'.");
+			}
+			const Token &value = tokens[i + 2];
+			DataQueryCondition c{tokens[i].text, parseOperator(tokens[i + 1]), value.text, nullopt, nullopt};
+			if (!value.quoted) {
+				char *end = nullptr;
+				double d = strtod(value.text.c_str(), &end);
+				if (!value.text.empty() && *end == '\0') {
+					c.number = d;
+				} else if (value.text == "true" || value.text == "false") {
+					c.boolean = (value.text == "true");
+				}
+			}
+			query.conditions.emplace_back(move(c));
+			i += 3;
+
+			if (i < tokens.size()) {
+				if (tokens[i].quoted || tokens[i].text != "and") {
+					throw invalid_argument("Expected 'and' instead of '" + tokens[i].text + "'.");
+				}
+				++i;
+				if (i == tokens.size()) {
+					throw invalid_argument("Missing condition after 'and'.");
+				}
+			}
+		}
+		return query;
+	}
+
+	DataQueryIndex::ClassIndex::ClassIndex(const string &_name) : name(_name), objects(), fields() {}
+
+	DataQueryIndex::ClassIndex::ClassIndex(ClassIndex &&) noexcept = default;
+
+	DataQueryIndex::ClassIndex::~ClassIndex() = default;
+
+	DataQueryIndex::DataQueryIndex(vector<DecodedDataFile> files, unsigned _threads) : dataFiles(move(files)),
+	                                                                                objects(), classes(), classIds(),
+	                                                                                threads(_threads) {
+		for (size_t f = 0; f < dataFiles.size(); ++f) {
+			const DataModel &model = *dataFiles[f].model;
+			vector<bool> added(model.recordCount(), false);
+			const auto &sections = model.index().sections;
+			for (size_t s = 0; s < sections.size(); ++s) {
+				const auto &elements = model.elements(sections[s].name);
+				for (size_t e = 0; e < elements.size(); ++e) {
+					addRecord(static_cast<uint32_t>(f), elements[e], sections[s].name, static_cast<uint32_t>(s),
+					          static_cast<uint32_t>(e), added);
+				}
+			}
+		}
+
+		parallelFor(classes.size(), [&](size_t c) {
+			for (auto &field : classes[c].fields) {
+				sort(field.second.byNumber.begin(), field.second.byNumber.end());
+			}
+		}, threads);
+	}
+
+	uint32_t DataQueryIndex::classId(const string &name) {
+		auto it = classIds.emplace(name, static_cast<uint32_t>(classes.size())).first;
+		if (it->second == classes.size()) {
+			classes.emplace_back(name);
+		}
+		return it->second;
+	}
+
+	void DataQueryIndex::addRecord(uint32_t file, uint32_t record, const string &className, uint32_t section,
+	                               uint32_t element, vector<bool> &added) {
+		// Records referenced more than once are indexed once
+		if (added[record]) {
+			return;
+		}
+		added[record] = true;
+
+		const DataModel &model = *dataFiles[file].model;
+		const DataShape &shape = model.shape(record);
+		uint32_t count = model.record(record).count;
+
+		if (shape.array && shape.fields.empty()) {
+			for (uint32_t i = 0; i < count; ++i) {
+				const DataValue &v = model.value(record, i);
+				if (v.type == DataType::record) {
+					const string &itemClass = model.shape(v.ref).className;
+					addRecord(file, v.ref, itemClass.empty() ? className : itemClass, section, element, added);
+				}
+			}
+			return;
+		}
+
+		uint32_t cid = classId(className);
+		auto o = static_cast<uint32_t>(objects.size());
+		objects.push_back({file, record, cid, section, element});
+		classes[cid].objects.emplace_back(o);
+
+		for (uint32_t i = 0; i < count; ++i) {
+			const string &name = shape.fields[i];
+
+			// Items of arrays are values of the member, objects are indexed on their own
+			vector<const DataValue *> pending{&model.value(record, i)};
+			while (!pending.empty()) {
+				const DataValue &v = *pending.back();
+				pending.pop_back();
+
+				if (v.type == DataType::record) {
+					const DataShape &child = model.shape(v.ref);
+					if (child.array && child.fields.empty()) {
+						if (!added[v.ref]) {
+							added[v.ref] = true;
+							for (uint32_t j = model.record(v.ref).count; j > 0; --j) {
+								pending.emplace_back(&model.value(v.ref, j - 1));
+							}
+						}
+					} else {
+						addRecord(file, v.ref, child.className.empty() ? className + "." + name : child.className,
+						          section, element, added);
+					}
+					continue;
+				}
+
+				FieldPostings &postings = classes[cid].fields[name];
+				switch (v.type) {
+					case DataType::number:
+						if (!isnan(v.number)) {  // NaN can't be sorted
+							postings.byNumber.emplace_back(v.number, o);
+						}
+						break;
+					case DataType::boolean:
+						addPosting(postings.byKey[booleanKey(v.number > 0)], o);
+						break;
+					case DataType::string:
+						addPosting(postings.byKey["s" + std::string(model.text(v))], o);
+						break;
+					case DataType::undefined:
+					case DataType::null:
+					case DataType::record:
+					default:
+						break;
+				}
+			}
+		}
+	}
+
+	template<class Function>
+	void DataQueryIndex::forEachValue(const Object &obj, string_view field, Function fn) const {
+		const DataModel &model = *dataFiles[obj.file].model;
+		const DataShape &shape = model.shape(obj.record);
+
+		vector<pair<const DataValue *, int>> pending;
+		for (size_t i = 0; i < shape.fields.size(); ++i) {
+			if (field != "*" && shape.fields[i] != field) {
+				continue;
+			}
+			pending.emplace_back(&model.value(obj.record, i), 0);
+			while (!pending.empty()) {
+				auto [v, depth] = pending.back();
+				pending.pop_back();
+				if (v->type != DataType::record) {
+					fn(model, *v);
+					continue;
+				}
+				const DataShape &child = model.shape(v->ref);
+				if (child.array && child.fields.empty() && depth < MAX_ARRAY_DEPTH) {
+					for (uint32_t j = model.record(v->ref).count; j > 0; --j) {
+						pending.emplace_back(&model.value(v->ref, j - 1), depth + 1);
+					}
+				}
+			}
+		}
+	}
+
+	bool DataQueryIndex::matches(uint32_t o, const DataQueryCondition &c) const {
+		bool found = false, matched = false;
+		forEachValue(objects[o], c.field, [&](const DataModel &model, const DataValue &v) {
+			if (v.type == DataType::undefined || v.type == DataType::null) {
+				return;
+			}
+			found = true;
+			if (c.op == DataQueryOp::notEqual) {
+				matched |= valueEquals(model, v, c);
+			} else {
+				matched |= valueMatches(model, v, c);
+			}
+		});
+		// Not equal: the member has values and none of them is equal
+		return c.op == DataQueryOp::notEqual ? found && !matched : matched;
+	}
+
+	optional<vector<uint32_t>> DataQueryIndex::lookup(const ClassIndex &cls, const DataQueryCondition &c) const {
+		if (c.field == "*" || c.op == DataQueryOp::notEqual || c.op == DataQueryOp::contains) {
+			return nullopt;
+		}
+
+		vector<uint32_t> result;
+		auto field = cls.fields.find(c.field);
+		if (field == cls.fields.end()) {
+			return result;
+		}
+		const FieldPostings &postings = field->second;
+
+		if (c.op == DataQueryOp::equal) {
+			auto addKey = [&](const string &key) {
+				auto it = postings.byKey.find(key);
+				if (it != postings.byKey.end()) {
+					result.insert(result.end(), it->second.begin(), it->second.end());
+				}
+			};
+			addKey("s" + c.text);
+			if (c.boolean) {
+				addKey(booleanKey(*c.boolean));
+			}
+		}
+
+		if (c.number) {
+			using Entry = pair<double, uint32_t>;
+			auto below = [](const Entry &e, double d) { return e.first < d; };
+			auto above = [](double d, const Entry &e) { return d < e.first; };
+			auto begin = postings.byNumber.begin(), end = postings.byNumber.end();
+			switch (c.op) {
+				case DataQueryOp::equal:
+					begin = lower_bound(begin, end, *c.number, below);
+					end = upper_bound(begin, end, *c.number, above);
+					break;
+				case DataQueryOp::less:
+					end = lower_bound(begin, end, *c.number, below);
+					break;
+				case DataQueryOp::lessEqual:
+					end = upper_bound(begin, end, *c.number, above);
+					break;
+				case DataQueryOp::greater:
+					begin = upper_bound(begin, end, *c.number, above);
+					break;
+				case DataQueryOp::greaterEqual:
+					begin = lower_bound(begin, end, *c.number, below);
+					break;
+				case DataQueryOp::notEqual:
+				case DataQueryOp::contains:
+				default:
+					break;
+			}
+			for (auto it = begin; it != end; ++it) {
+				result.emplace_back(it->second);
+			}
+		}
+
+		sort(result.begin(), result.end());
+		result.erase(unique(result.begin(), result.end()), result.end());
+		return result;
+	}
+
+	vector<uint32_t> DataQueryIndex::run(const DataQuery &query) const {
+		if (query.className != "*" && classIds.find(query.className) == classIds.end()) {
+			throw invalid_argument("No objects of class '" + query.className + "'.");
+		}
+
+		vector<uint32_t> result;
+		for (const ClassIndex &cls : classes) {
+			if (query.className != "*" && cls.name != query.className) {
+				continue;
+			}
+
+			// The first condition that the postings answer gives the candidates
+			vector<uint32_t> candidates;
+			size_t lookedUp = query.conditions.size();
+			for (size_t i = 0; i < query.conditions.size(); ++i) {
+				auto found = lookup(cls, query.conditions[i]);
+				if (found) {
+					candidates = move(*found);
+					lookedUp = i;
+					break;
+				}
+			}
+			if (lookedUp == query.conditions.size()) {
+				candidates = cls.objects;
+			}
+
+			// The others are checked on all the threads
+			vector<uint8_t> keep(candidates.size(), 0);
+			size_t chunks = (candidates.size() + SCAN_CHUNK - 1) / SCAN_CHUNK;
+			parallelFor(chunks, [&](size_t chunk) {
+				size_t end = min(candidates.size(), (chunk + 1) * SCAN_CHUNK);
+				for (size_t i = chunk * SCAN_CHUNK; i < end; ++i) {
+					bool all = true;
+					for (size_t k = 0; k < query.conditions.size() && all; ++k) {
+						all = (k == lookedUp) || matches(candidates[i], query.conditions[k]);
+					}
+					keep[i] = all;
+				}
+			}, threads);
+
+			for (size_t i = 0; i < candidates.size(); ++i) {
+				if (keep[i]) {
+					result.emplace_back(candidates[i]);
+				}
+			}
+		}
+
+		// Objects are numbered in the order of the files
+		sort(result.begin(), result.end());
+		return result;
+	}
+
+	string DataQueryIndex::valuesText(uint32_t o, string_view field) const {
+		string text;
+		forEachValue(objects[o], field, [&](const DataModel &model, const DataValue &v) {
+			if (!text.empty()) {
+				text += ", ";
+			}
+			switch (v.type) {
+				case DataType::number:
+					text += dataNumberText(v.number);
+					break;
+				case DataType::boolean:
+					text += v.number > 0 ? "true" : "false";
+					break;
+				case DataType::string:
+					text += model.text(v);
+					break;
+				case DataType::null:
+					text += "null";
+					break;
+				case DataType::undefined:
+				case DataType::record:
+				default:
+					text += "undefined";
+					break;
+			}
+		});
+		return text;
+	}
+
+} // hf_workshop
@@ -0,0 +1,124 @@
+/**
+ * HF Workshop - Data queries
+ *
+ * Finds the objects of the data files of a game whose members match a
+ * list of conditions, such as "Attack where injury > 50 and fall < 20".
+ */
+
+#ifndef DATA_QUERY_HPP
+#define DATA_QUERY_HPP
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility> // pair
+#include <vector>
+#include <cstdint> // uint32_t
+#include <cstddef> // size_t
+
+#include "data_model.hpp"
+#include "parallel.hpp"
+
+namespace hf_workshop {
+
+	enum class DataQueryOp : uint8_t {equal, notEqual, less, lessEqual, greater, greaterEqual, contains};
+
+	/// A member compared with a value; the member "*" is any member
+	struct DataQueryCondition {
+		std::string field;
+		DataQueryOp op;
+		std::string text;             // the value as typed
+		std::optional<double> number; // if it's a number and wasn't quoted
+		std::optional<bool> boolean;  // if it's true or false and wasn't quoted
+	};
+
+	/// Objects of a class, or of any class for "*", matching all the conditions
+	struct DataQuery {
+		std::string className;
+		std::vector<DataQueryCondition> conditions;
+	};
+
+	/**
+	 * Parses a query: a class, then optionally "where" and conditions joined
+	 * by "and". A condition is a member, one of = != < <= > >= ~ (contains)
+	 * and a value, which can be quoted to be compared as text.
+	 * Throws std::invalid_argument if the query is malformed.
+	 */
+	DataQuery parseDataQuery(std::string_view text);
+
+	/**
+	 * Index of the objects of a set of data files, by class, member and
+	 * value. Elements of a section are of the class of the section, other
+	 * objects of their own class, or "Parent.member" if they have none.
+	 * The values of a member that holds an array are the items of the array.
+	 */
+	class DataQueryIndex {
+	public:
+		/// An object of a data file, and the element of a section that holds it
+		struct Object {
+			uint32_t file;     // index in files()
+			uint32_t record;
+			uint32_t classId;
+			uint32_t section;  // index in the sections of the file
+			uint32_t element;
+		};
+
+		explicit DataQueryIndex(std::vector<DecodedDataFile> files, unsigned threads = defaultThreadCount());
+
+		const std::vector<DecodedDataFile> &files() const { return dataFiles; }
+		const Object &object(uint32_t o) const { return objects[o]; }
+		const std::string &className(uint32_t classId) const { return classes[classId].name; }
+
+		/**
+		 * The objects matching a query, in the order of the files. Conditions
+		 * that the index can answer are looked up, the rest are checked by
+		 * scanning the candidates on all the threads.
+		 */
+		std::vector<uint32_t> run(const DataQuery &query) const;
+
+		/// The values of a member of an object as text, comma separated
+		std::string valuesText(uint32_t o, std::string_view field) const;
+
+	private:
+		/// Objects of a member by value; lists are in ascending order
+		struct FieldPostings {
+			FieldPostings() : byKey(), byNumber() {}
+
+			std::unordered_map<std::string, std::vector<uint32_t>> byKey;  // type prefix + value as text
+			std::vector<std::pair<double, uint32_t>> byNumber;             // sorted
+		};
+
+		struct ClassIndex {
+			std::string name;
+			std::vector<uint32_t> objects;
+			std::unordered_map<std::string, FieldPostings> fields;
+
+			explicit ClassIndex(const std::string &_name);
+			ClassIndex(ClassIndex &&) noexcept;
+			~ClassIndex();
+		};
+
+		std::vector<DecodedDataFile> dataFiles;
+		std::vector<Object> objects;
+		std::vector<ClassIndex> classes;
+		std::unordered_map<std::string, uint32_t> classIds;
+		unsigned threads;
+
+		uint32_t classId(const std::string &name);
+		void addRecord(uint32_t file, uint32_t record, const std::string &className, uint32_t section, uint32_t element,
+		               std::vector<bool> &added);
+
+		/// Calls `fn` with every scalar value of a member, or of every member for "*"
+		template<class Function>
+		void forEachValue(const Object &obj, std::string_view field, Function fn) const;
+
+		bool matches(uint32_t o, const DataQueryCondition &c) const;
+
+		/// Candidates of a class from the postings of a condition, or nullopt if it can't be looked up
+		std::optional<std::vector<uint32_t>> lookup(const ClassIndex &cls, const DataQueryCondition &c) const;
+	};
+
+} // hf_workshop
+
+#endif // DATA_QUERY_HPP
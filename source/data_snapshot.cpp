@@ -0,0 +1,468 @@
+/**
+ * HF Workshop - Data snapshot
+ *
+ * The file is a header, the columns, the table directory and the strings.
+ * Values are in the byte order of the machine that wrote the file, which is
+ * checked on reading, and every column starts on a 64 byte boundary so that
+ * it can be scanned in place.
+ *
+ * Header:    magic[8], byte order mark (u32), table count (u32),
+ *            directory offset (u64), string count (u64), strings offset (u64)
+ * Directory: per table, name (u32), column count (u32), row count (u64),
+ *            then per column, name (u32), type (u32), data offset (u64)
+ * Strings:   count + 1 offsets (u64) into the characters that follow them
+ */
+
+#include "data_snapshot.hpp"
+
+#include <cmath>     // NAN
+#include <cstring>   // memcpy
+#include <limits>    // numeric_limits
+#include <stdexcept> // runtime_error, out_of_range
+
+#include "data_model.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		constexpr char MAGIC[8] = {'H', 'F', 'W', 'S', 'N', 'A', 'P', '1'};
+		constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+		constexpr size_t HEADER_SIZE = 40;
+		constexpr size_t COLUMN_ALIGNMENT = 64;
+
+		template<typename T>
+		void append(vector<uint8_t> &out, const T &value) {
+			size_t at = out.size();
+			out.resize(at + sizeof(T));
+			memcpy(out.data() + at, &value, sizeof(T));
+		}
+
+		template<typename T>
+		void put(vector<uint8_t> &out, size_t at, const T &value) {
+			memcpy(out.data() + at, &value, sizeof(T));
+		}
+
+		void align(vector<uint8_t> &out) {
+			out.resize((out.size() + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT, 0);
+		}
+
+		template<typename T>
+		void appendColumn(vector<uint8_t> &out, const vector<T> &values) {
+			size_t at = out.size();
+			out.resize(at + values.size() * sizeof(T));
+			if (!values.empty()) {
+				memcpy(out.data() + at, values.data(), values.size() * sizeof(T));
+			}
+		}
+
+		/// Reads the directory and the strings of a snapshot, checking that they're in the file
+		class SnapshotReader {
+		public:
+			SnapshotReader(const uint8_t *_data, size_t _size) : data(_data), size(_size) {}
+
+			template<typename T>
+			T at(uint64_t pos) const {
+				check(pos, sizeof(T));
+				T value;
+				memcpy(&value, data + pos, sizeof(T));
+				return value;
+			}
+
+			/// Pointer to `count` values of `width` bytes at `pos`, which must be aligned to `width`
+			const void *array(uint64_t pos, uint64_t count, size_t width) const {
+				if (count > numeric_limits<uint64_t>::max() / width) {
+					throw runtime_error("Snapshot column is too long.");
+				}
+				check(pos, count * width);
+				if (pos % width != 0) {
+					throw runtime_error("Snapshot column is not aligned.");
+				}
+				return data + pos;
+			}
+
+		private:
+			const uint8_t *data;
+			size_t size;
+
+			void check(uint64_t pos, uint64_t length) const {
+				if (pos > size || length > size - pos) {
+					throw runtime_error("Snapshot file is truncated.");
+				}
+			}
+		};
+
+		size_t typeWidth(SnapshotType type) {
+			switch (type) {
+				case SnapshotType::number:
+				case SnapshotType::ref:
+					return 8;
+				case SnapshotType::string:
+				case SnapshotType::integer:
+					return 4;
+				case SnapshotType::boolean:
+					return 1;
+				default:
+					throw runtime_error("Unknown snapshot column type.");
+			}
+		}
+
+	} // anonymous namespace
+
+	const SnapshotTable::Column *SnapshotTable::column(string_view columnName) const {
+		for (const auto &c : columns) {
+			if (c.name == columnName) {
+				return &c;
+			}
+		}
+		return nullptr;
+	}
+
+	DataSnapshotWriter::Table::Table(uint32_t _name)
+		: name(_name), files(), parents(), fields(), indexes(), columns(), columnIds() {}
+
+	DataSnapshotWriter::Table::Table(Table &&) noexcept = default;
+
+	DataSnapshotWriter::Table::~Table() = default;
+
+	DataSnapshotWriter::FileContext::~FileContext() = default;
+
+	DataSnapshotWriter::DataSnapshotWriter() : tables(), tableIds(), strings(), stringIds() {}
+
+	DataSnapshotWriter::~DataSnapshotWriter() = default;
+
+	uint32_t DataSnapshotWriter::intern(string_view s) {
+		auto it = stringIds.emplace(string(s), static_cast<uint32_t>(strings.size())).first;
+		if (it->second == strings.size()) {
+			strings.emplace_back(&it->first);
+		}
+		return it->second;
+	}
+
+	uint32_t DataSnapshotWriter::tableId(string_view name) {
+		uint32_t nameId = intern(name);
+		auto it = tableIds.emplace(nameId, static_cast<uint32_t>(tables.size())).first;
+		if (it->second == tables.size()) {
+			tables.emplace_back(nameId);
+		}
+		return it->second;
+	}
+
+	uint64_t DataSnapshotWriter::addRow(uint32_t table, uint32_t fileId, uint64_t parent, uint32_t field, uint32_t index) {
+		Table &t = tables[table];
+		uint64_t row = t.files.size();
+		t.files.emplace_back(fileId);
+		t.parents.emplace_back(parent);
+		t.fields.emplace_back(field);
+		t.indexes.emplace_back(index);
+		return static_cast<uint64_t>(table) << 32 | row;
+	}
+
+	void DataSnapshotWriter::setCell(uint32_t table, uint32_t column, uint64_t row, const DataModel &model, const DataValue &v) {
+		auto &cells = tables[table].columns[column].cells;
+		auto r = static_cast<size_t>(row & 0xFFFFFFFF);
+		if (cells.size() <= r) {
+			cells.resize(r + 1, {static_cast<uint8_t>(DataType::undefined), 0, 0});
+		}
+		Cell &c = cells[r];
+		c.type = static_cast<uint8_t>(v.type);
+		c.number = v.number;
+		if (v.type == DataType::string) {
+			c.string = intern(model.text(v));
+		}
+	}
+
+	void DataSnapshotWriter::add(uint32_t fileId, const DataModel &model) {
+		FileContext ctx{model, fileId, vector<bool>(model.recordCount(), false), {}};
+
+		for (const DataSection &section : model.index().sections) {
+			const auto &elements = model.elements(section.name);
+			if (elements.empty()) {
+				continue;
+			}
+			uint32_t table = tableId(section.name);
+			for (size_t i = 0; i < elements.size(); ++i) {
+				addRecord(ctx, elements[i], table, SnapshotTable::NO_REF, SnapshotTable::NO_STRING, static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	void DataSnapshotWriter::addValue(FileContext &ctx, const DataValue &v, string_view table,
+	                                  uint64_t parent, uint32_t field, uint32_t index) {
+		if (v.type != DataType::record) {
+			uint32_t t = tableId(table);
+			uint64_t row = addRow(t, ctx.fileId, parent, field, index);
+			auto it = tables[t].columnIds.emplace(intern("value"), static_cast<uint32_t>(tables[t].columns.size())).first;
+			if (it->second == tables[t].columns.size()) {
+				tables[t].columns.push_back({it->first, {}});
+			}
+			setCell(t, it->second, row, ctx.model, v);
+			return;
+		}
+		if (ctx.added[v.ref]) {
+			return;
+		}
+		const string &className = ctx.model.shape(v.ref).className;
+		addRecord(ctx, v.ref, tableId(className.empty() ? table : className), parent, field, index);
+	}
+
+	void DataSnapshotWriter::addRecord(FileContext &ctx, uint32_t r, uint32_t table, uint64_t parent, uint32_t field, uint32_t index) {
+		// Records referenced more than once are kept under the first parent
+		if (ctx.added[r]) {
+			return;
+		}
+		ctx.added[r] = true;
+
+		const DataModel &model = ctx.model;
+		const DataShape &shape = model.shape(r);
+		const DataRecord &rec = model.record(r);
+		uint64_t row = addRow(table, ctx.fileId, parent, field, index);
+
+		const std::string &tableName = *strings[tables[table].name];
+
+		if (shape.array && shape.fields.empty()) {
+			std::string itemTable = tableName + ".item";
+			uint32_t itemField = intern("item");
+			for (uint32_t i = 0; i < rec.count; ++i) {
+				addValue(ctx, model.value(r, i), itemTable, row, itemField, i);
+			}
+			return;
+		}
+
+		// The columns of the members are looked up once per shape
+		auto key = static_cast<uint64_t>(table) << 32 | rec.shape;
+		auto found = ctx.shapeColumns.find(key);
+		if (found == ctx.shapeColumns.end()) {
+			vector<uint32_t> columns;
+			for (const auto &name : shape.fields) {
+				uint32_t nameId = intern(name);
+				auto it = tables[table].columnIds.emplace(nameId, static_cast<uint32_t>(tables[table].columns.size())).first;
+				if (it->second == tables[table].columns.size()) {
+					tables[table].columns.push_back({nameId, {}});
+				}
+				columns.emplace_back(it->second);
+			}
+			found = ctx.shapeColumns.emplace(key, move(columns)).first;
+		}
+		const vector<uint32_t> &columns = found->second;
+
+		for (uint32_t i = 0; i < rec.count; ++i) {
+			const DataValue &v = model.value(r, i);
+			if (v.type == DataType::record) {
+				uint32_t name = tables[table].columns[columns[i]].name;
+				addValue(ctx, v, tableName + "." + *strings[name], row, name, 0);
+			} else {
+				setCell(table, columns[i], row, model, v);
+			}
+		}
+	}
+
+	vector<uint8_t> DataSnapshotWriter::serialize() const {
+		vector<uint8_t> out(HEADER_SIZE, 0);
+
+		// Strings that are only needed in the file, such as numbers of columns of mixed types
+		vector<string> extraStrings;
+		unordered_map<string, uint32_t> extraIds;
+		auto stringId = [&](const string &s) {
+			auto it = stringIds.find(s);
+			if (it != stringIds.end()) {
+				return it->second;
+			}
+			auto extra = extraIds.emplace(s, static_cast<uint32_t>(strings.size() + extraStrings.size())).first;
+			if (extra->second == strings.size() + extraStrings.size()) {
+				extraStrings.emplace_back(s);
+			}
+			return extra->second;
+		};
+
+		struct ColumnEntry {
+			uint32_t name;
+			SnapshotType type;
+			uint64_t offset;
+		};
+		vector<vector<ColumnEntry>> directory(tables.size());
+
+		for (size_t t = 0; t < tables.size(); ++t) {
+			const Table &table = tables[t];
+			size_t rows = table.files.size();
+			auto &entries = directory[t];
+
+			align(out);
+			entries.push_back({stringId("$file"), SnapshotType::integer, out.size()});
+			appendColumn(out, table.files);
+			align(out);
+			entries.push_back({stringId("$parent"), SnapshotType::ref, out.size()});
+			appendColumn(out, table.parents);
+			align(out);
+			entries.push_back({stringId("$field"), SnapshotType::string, out.size()});
+			appendColumn(out, table.fields);
+			align(out);
+			entries.push_back({stringId("$index"), SnapshotType::integer, out.size()});
+			appendColumn(out, table.indexes);
+
+			for (const Column &column : table.columns) {
+				// Members that only hold records are in the tables of the records
+				if (column.cells.empty()) {
+					continue;
+				}
+
+				// A column of mixed types is kept as text
+				bool numbers = false, booleans = false, texts = false;
+				for (const Cell &c : column.cells) {
+					numbers |= (c.type == static_cast<uint8_t>(DataType::number));
+					booleans |= (c.type == static_cast<uint8_t>(DataType::boolean));
+					texts |= (c.type == static_cast<uint8_t>(DataType::string));
+				}
+				SnapshotType type = (texts || (numbers && booleans)) ? SnapshotType::string :
+				                    booleans ? SnapshotType::boolean : SnapshotType::number;
+
+				auto cellType = [&](size_t row) {
+					return row < column.cells.size() ? static_cast<DataType>(column.cells[row].type) : DataType::undefined;
+				};
+
+				align(out);
+				entries.push_back({column.name, type, out.size()});
+
+				if (type == SnapshotType::number) {
+					vector<double> values(rows, NAN);
+					for (size_t i = 0; i < rows; ++i) {
+						if (cellType(i) == DataType::number) {
+							values[i] = column.cells[i].number;
+						}
+					}
+					appendColumn(out, values);
+				} else if (type == SnapshotType::boolean) {
+					vector<uint8_t> values(rows, SnapshotTable::MISSING_BOOLEAN);
+					for (size_t i = 0; i < rows; ++i) {
+						if (cellType(i) == DataType::boolean) {
+							values[i] = column.cells[i].number > 0 ? 1 : 0;
+						}
+					}
+					appendColumn(out, values);
+				} else {
+					vector<uint32_t> values(rows, SnapshotTable::NO_STRING);
+					for (size_t i = 0; i < rows; ++i) {
+						switch (cellType(i)) {
+							case DataType::string:
+								values[i] = column.cells[i].string;
+								break;
+							case DataType::number:
+								values[i] = stringId(dataNumberText(column.cells[i].number));
+								break;
+							case DataType::boolean:
+								values[i] = stringId(column.cells[i].number > 0 ? "true" : "false");
+								break;
+							case DataType::undefined:
+							case DataType::null:
+							case DataType::record:
+							default:
+								break;
+						}
+					}
+					appendColumn(out, values);
+				}
+			}
+		}
+
+		align(out);
+		uint64_t directoryOffset = out.size();
+		for (size_t t = 0; t < tables.size(); ++t) {
+			append(out, tables[t].name);
+			append(out, static_cast<uint32_t>(directory[t].size()));
+			append(out, static_cast<uint64_t>(tables[t].files.size()));
+			for (const ColumnEntry &e : directory[t]) {
+				append(out, e.name);
+				append(out, static_cast<uint32_t>(e.type));
+				append(out, e.offset);
+			}
+		}
+
+		align(out);
+		uint64_t stringsOffset = out.size();
+		uint64_t stringCount = strings.size() + extraStrings.size();
+		uint64_t offset = 0;
+		append(out, offset);
+		for (const string *s : strings) {
+			offset += s->size();
+			append(out, offset);
+		}
+		for (const string &s : extraStrings) {
+			offset += s.size();
+			append(out, offset);
+		}
+		for (const string *s : strings) {
+			out.insert(out.end(), s->begin(), s->end());
+		}
+		for (const string &s : extraStrings) {
+			out.insert(out.end(), s.begin(), s.end());
+		}
+
+		memcpy(out.data(), MAGIC, sizeof(MAGIC));
+		put(out, 8, BYTE_ORDER_MARK);
+		put(out, 12, static_cast<uint32_t>(tables.size()));
+		put(out, 16, directoryOffset);
+		put(out, 24, stringCount);
+		put(out, 32, stringsOffset);
+		return out;
+	}
+
+	DataSnapshot::DataSnapshot(const string &filename) : file(filename), tableList(),
+	                                                     stringOffsets(nullptr), stringData(nullptr), stringCount(0) {
+		SnapshotReader r(file.data(), file.size());
+		if (file.size() < HEADER_SIZE || memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0) {
+			throw runtime_error("Not a data snapshot file.");
+		}
+		if (r.at<uint32_t>(8) != BYTE_ORDER_MARK) {
+			throw runtime_error("Data snapshot was written on a machine of another byte order.");
+		}
+		auto tableCount = r.at<uint32_t>(12);
+		auto directoryOffset = r.at<uint64_t>(16);
+		stringCount = static_cast<size_t>(r.at<uint64_t>(24));
+		auto stringsOffset = r.at<uint64_t>(32);
+
+		stringOffsets = static_cast<const uint64_t *>(r.array(stringsOffset, stringCount + 1, sizeof(uint64_t)));
+		uint64_t charsOffset = stringsOffset + (stringCount + 1) * sizeof(uint64_t);
+		stringData = static_cast<const char *>(r.array(charsOffset, stringOffsets[stringCount], 1));
+		for (size_t i = 0; i < stringCount; ++i) {
+			if (stringOffsets[i] > stringOffsets[i + 1]) {
+				throw runtime_error("Data snapshot strings are corrupted.");
+			}
+		}
+
+		uint64_t pos = directoryOffset;
+		tableList.reserve(tableCount);
+		for (uint32_t t = 0; t < tableCount; ++t) {
+			SnapshotTable table{text(r.at<uint32_t>(pos)), 0, {}};
+			auto columnCount = r.at<uint32_t>(pos + 4);
+			auto rows = r.at<uint64_t>(pos + 8);
+			table.rows = static_cast<size_t>(rows);
+			pos += 16;
+			for (uint32_t c = 0; c < columnCount; ++c) {
+				auto type = static_cast<SnapshotType>(r.at<uint32_t>(pos + 4));
+				table.columns.push_back({text(r.at<uint32_t>(pos)), type,
+				                         r.array(r.at<uint64_t>(pos + 8), rows, typeWidth(type))});
+				pos += 16;
+			}
+			tableList.emplace_back(move(table));
+		}
+	}
+
+	const SnapshotTable *DataSnapshot::table(string_view name) const {
+		for (const auto &t : tableList) {
+			if (t.name == name) {
+				return &t;
+			}
+		}
+		return nullptr;
+	}
+
+	string_view DataSnapshot::text(uint32_t id) const {
+		if (id >= stringCount) {
+			throw out_of_range("Data snapshot string is out of range.");
+		}
+		return string_view(stringData + stringOffsets[id], static_cast<size_t>(stringOffsets[id + 1] - stringOffsets[id]));
+	}
+
+} // hf_workshop
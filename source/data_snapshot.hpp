@@ -0,0 +1,173 @@
+/**
+ * HF Workshop - Data snapshot
+ *
+ * Columnar snapshot of the elements of all the data files of a game, so
+ * that a field can be scanned across every character at once.
+ */
+
+#ifndef DATA_SNAPSHOT_HPP
+#define DATA_SNAPSHOT_HPP
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cstdint> // uint8_t, uint32_t, uint64_t
+#include <cstddef> // size_t
+
+#include "mapped_file.hpp"
+
+namespace hf_workshop {
+
+	class DataModel;
+	struct DataValue;
+
+	/**
+	 * Type of the values of a column. Missing values are NaN, MISSING_BOOLEAN,
+	 * NO_STRING or NO_REF.
+	 */
+	enum class SnapshotType : uint32_t {
+		number,   // double
+		boolean,  // uint8_t: 0, 1 or MISSING_BOOLEAN
+		string,   // uint32_t index in the strings of the snapshot
+		integer,  // uint32_t
+		ref       // uint64_t: table index << 32 | row
+	};
+
+	/**
+	 * Rows of a class of records, one column per member.
+	 *
+	 * Every table has the columns "$file" (ID of the data file), "$parent"
+	 * (the record that holds this one, NO_REF for the elements of a section),
+	 * "$field" (the member of the parent) and "$index" (position in its
+	 * section or array). Elements of a section are in the table of the
+	 * section, other objects in the table of their class, or of their parent's
+	 * table and member ("Limb.frames") if they have none. Arrays are rows of
+	 * their own and their items are in a table with ".item" added to the
+	 * name; scalar items are in the column "value".
+	 */
+	struct SnapshotTable {
+		static constexpr uint32_t NO_STRING = static_cast<uint32_t>(-1);
+		static constexpr uint64_t NO_REF = static_cast<uint64_t>(-1);
+		static constexpr uint8_t MISSING_BOOLEAN = 0xFF;
+
+		struct Column {
+			std::string_view name;
+			SnapshotType type;
+			const void *data;
+
+			const double *numbers() const { return static_cast<const double *>(data); }
+			const uint8_t *booleans() const { return static_cast<const uint8_t *>(data); }
+			const uint32_t *strings() const { return static_cast<const uint32_t *>(data); }
+			const uint32_t *integers() const { return static_cast<const uint32_t *>(data); }
+			const uint64_t *refs() const { return static_cast<const uint64_t *>(data); }
+		};
+
+		std::string_view name;
+		size_t rows;
+		std::vector<Column> columns;
+
+		/// The column with the given name, nullptr if there's none
+		const Column *column(std::string_view columnName) const;
+	};
+
+	/// Builds a snapshot from the data files of a game
+	class DataSnapshotWriter {
+	public:
+		DataSnapshotWriter();
+		DataSnapshotWriter(const DataSnapshotWriter &) = delete;
+		DataSnapshotWriter &operator=(const DataSnapshotWriter &) = delete;
+		~DataSnapshotWriter();
+
+		/// Adds the elements of a data file, `fileId` being the ID of its tag
+		void add(uint32_t fileId, const DataModel &model);
+
+		/// The snapshot file
+		std::vector<uint8_t> serialize() const;
+
+	private:
+		/// A value before the type of its column is known
+		struct Cell {
+			uint8_t type;     // DataType
+			uint32_t string;
+			double number;
+		};
+
+		struct Column {
+			uint32_t name;
+			std::vector<Cell> cells;  // shorter than the table if the last rows have no value
+		};
+
+		struct Table {
+			uint32_t name;
+			std::vector<uint32_t> files;
+			std::vector<uint64_t> parents;
+			std::vector<uint32_t> fields;
+			std::vector<uint32_t> indexes;
+			std::vector<Column> columns;
+			std::unordered_map<uint32_t, uint32_t> columnIds;  // by name
+
+			explicit Table(uint32_t _name);
+			Table(Table &&) noexcept;
+			~Table();
+		};
+
+		/// State of the data file being added
+		struct FileContext {
+			const DataModel &model;
+			uint32_t fileId;
+			std::vector<bool> added;  // by record
+			std::unordered_map<uint64_t, std::vector<uint32_t>> shapeColumns;  // table << 32 | shape
+
+			~FileContext();
+		};
+
+		std::vector<Table> tables;
+		std::unordered_map<uint32_t, uint32_t> tableIds;  // by name
+		std::vector<const std::string *> strings;
+		std::unordered_map<std::string, uint32_t> stringIds;
+
+		uint32_t intern(std::string_view s);
+		uint32_t tableId(std::string_view name);
+		uint64_t addRow(uint32_t table, uint32_t fileId, uint64_t parent, uint32_t field, uint32_t index);
+		void setCell(uint32_t table, uint32_t column, uint64_t row, const DataModel &model, const DataValue &v);
+
+		/// Adds a value held by `parent`, in the table of its class or else in `table`
+		void addValue(FileContext &ctx, const DataValue &v, std::string_view table,
+		              uint64_t parent, uint32_t field, uint32_t index);
+		void addRecord(FileContext &ctx, uint32_t r, uint32_t table, uint64_t parent, uint32_t field, uint32_t index);
+	};
+
+	/**
+	 * A snapshot file, mapped into memory. The columns point into the
+	 * mapping, so they're only read from disk as they're scanned.
+	 */
+	class DataSnapshot {
+	public:
+		/**
+		 * Opens a snapshot. Throws std::runtime_error if it can't be mapped
+		 * or isn't a snapshot written by this version.
+		 */
+		explicit DataSnapshot(const std::string &filename);
+		DataSnapshot(const DataSnapshot &) = delete;
+		DataSnapshot &operator=(const DataSnapshot &) = delete;
+
+		const std::vector<SnapshotTable> &tables() const { return tableList; }
+
+		/// The table with the given name, nullptr if there's none
+		const SnapshotTable *table(std::string_view name) const;
+
+		/// A value of a string column. Throws std::out_of_range for NO_STRING.
+		std::string_view text(uint32_t id) const;
+
+	private:
+		MappedFile file;
+		std::vector<SnapshotTable> tableList;
+		const uint64_t *stringOffsets;  // stringCount + 1, in stringData
+		const char *stringData;
+		size_t stringCount;
+	};
+
+} // hf_workshop
+
+#endif // DATA_SNAPSHOT_HPP
@@ -0,0 +1,71 @@
+/**
+ * HF Workshop - Edit journal
+ */
+
+#include "edit_journal.hpp"
+
+#include <algorithm> // sort
+#include <cstddef> // ptrdiff_t
+#include <iterator> // next
+#include <utility> // move
+
+using namespace std;
+
+namespace hf_workshop {
+
+	TagState::TagState(SharedBytes _record, SharedBytes _mp3) : record(move(_record)), mp3(move(_mp3)) {}
+
+	TagState::TagState(const TagState &) = default;
+
+	TagState::TagState(TagState &&) noexcept = default;
+
+	TagState &TagState::operator=(const TagState &) = default;
+
+	TagState &TagState::operator=(TagState &&) noexcept = default;
+
+	TagState::~TagState() = default;
+
+	Edit::Edit(EditKind _kind, size_t _id, string _source, TagState _before, TagState _after)
+		: kind(_kind), id(_id), source(move(_source)), before(move(_before)), after(move(_after)) {}
+
+	Edit::Edit(const Edit &) = default;
+
+	Edit::Edit(Edit &&) noexcept = default;
+
+	Edit &Edit::operator=(const Edit &) = default;
+
+	Edit &Edit::operator=(Edit &&) noexcept = default;
+
+	Edit::~Edit() = default;
+
+	EditJournal::~EditJournal() = default;
+
+	void EditJournal::record(Edit edit) {
+		editList.erase(editList.begin() + static_cast<ptrdiff_t>(done), editList.end());
+		for (auto it = names.begin(); it != names.end();) {
+			it = (it->second > done ? names.erase(it) : next(it));
+		}
+		editList.emplace_back(move(edit));
+		++done;
+	}
+
+	vector<pair<size_t, size_t>> EditJournal::tagSpans(size_t from, size_t to, bool back) const {
+		map<pair<size_t, EditKind>, pair<size_t, size_t>> byTag;
+		for (size_t i = from; i < to; ++i) {
+			byTag.emplace(make_pair(editList[i].id, editList[i].kind), make_pair(i, i)).first->second.second = i;
+		}
+		vector<pair<size_t, size_t>> spans;
+		spans.reserve(byTag.size());
+		for (const auto &span : byTag) {
+			spans.emplace_back(span.second);
+		}
+		// Spans of the same tag overlap, so the one edited last must be undone first
+		if (back) {
+			sort(spans.begin(), spans.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+		} else {
+			sort(spans.begin(), spans.end(), [](const auto &a, const auto &b) { return a.second < b.second; });
+		}
+		return spans;
+	}
+
+} // hf_workshop
@@ -0,0 +1,168 @@
+/**
+ * HF Workshop - Edit journal
+ *
+ * The tags replaced during a session, with what they held before and after,
+ * so that edits can be undone and redone without reopening the game.
+ */
+
+#ifndef EDIT_JOURNAL_HPP
+#define EDIT_JOURNAL_HPP
+
+#include <algorithm> // min, max
+#include <map>
+#include <string>
+#include <utility>   // pair
+#include <vector>
+#include <cstdint> // uint8_t
+#include <cstddef> // size_t
+
+#include "swf_tags.hpp" // SharedBytes
+
+namespace hf_workshop {
+
+	enum class EditKind : uint8_t {stage, image, sound, data, tag};
+
+	/**
+	 * What a tag held, shared with the game so that only the edited tags take
+	 * memory. `record` is the record that replaced the tag (nullptr for the
+	 * tag of the game as read); stages and data files always have one, as the
+	 * DefineBinaryData record. `mp3` is what libswf had for a sound, which
+	 * only shows if no record replaced the tag.
+	 */
+	struct TagState {
+		SharedBytes record;
+		SharedBytes mp3;
+
+		TagState(SharedBytes _record, SharedBytes _mp3);
+		TagState(const TagState &);
+		TagState(TagState &&) noexcept;
+		TagState &operator=(const TagState &);
+		TagState &operator=(TagState &&) noexcept;
+		~TagState();
+	};
+
+	/// A replaced tag
+	struct Edit {
+		EditKind kind;
+		size_t id;
+		std::string source;  // file the tag was replaced with
+		TagState before;
+		TagState after;
+
+		Edit(EditKind _kind, size_t _id, std::string _source, TagState _before, TagState _after);
+		Edit(const Edit &);
+		Edit(Edit &&) noexcept;
+		Edit &operator=(const Edit &);
+		Edit &operator=(Edit &&) noexcept;
+		~Edit();
+	};
+
+	/**
+	 * Edits in the order they were made, and how many of them are done. Making
+	 * an edit after undoing drops the edits that were undone.
+	 */
+	class EditJournal {
+	public:
+		EditJournal() : editList(), done(0), names() {}
+		~EditJournal();
+
+		const std::vector<Edit> &edits() const { return editList; }
+
+		/// Number of edits that are done, the others were undone
+		size_t position() const { return done; }
+
+		/// Positions by name
+		const std::map<std::string, size_t> &checkpoints() const { return names; }
+
+		/// Adds an edit that was just made
+		void record(Edit edit);
+
+		/**
+		 * Reverts the last edit that's done by calling `apply(edit, edit.before)`.
+		 * Returns false if there's none. Nothing changes if `apply` throws.
+		 */
+		template<class Apply>
+		bool undo(Apply apply) {
+			if (done == 0) {
+				return false;
+			}
+			apply(editList[done - 1], editList[done - 1].before);
+			--done;
+			return true;
+		}
+
+		/// Makes again the first edit that was undone, with `apply(edit, edit.after)`
+		template<class Apply>
+		bool redo(Apply apply) {
+			if (done == editList.size()) {
+				return false;
+			}
+			apply(editList[done], editList[done].after);
+			++done;
+			return true;
+		}
+
+		/// Names the current position, replacing a checkpoint with the same name
+		void checkpoint(const std::string &name) { names[name] = done; }
+
+		/**
+		 * Moves to the position of a checkpoint, calling `apply` once for
+		 * every tag and kind of edit in between with the state it had there:
+		 * `before` of its first edit when going back, `after` of its last one
+		 * when going forward. A sound replaced both as a sound and by a patch
+		 * gets a call for each, in the order of the edits. Returns false if
+		 * there's no such checkpoint. If `apply` throws, the tags already
+		 * changed are put back.
+		 */
+		template<class Apply>
+		bool rollback(const std::string &name, Apply apply) {
+			auto it = names.find(name);
+			if (it == names.end()) {
+				return false;
+			}
+			size_t target = it->second;
+			bool back = target < done;
+			auto spans = tagSpans(std::min(done, target), std::max(done, target), back);
+			size_t applied = 0;
+			try {
+				for (; applied < spans.size(); ++applied) {
+					const Edit &first = editList[spans[applied].first];
+					const Edit &last = editList[spans[applied].second];
+					if (back) {
+						apply(first, first.before);
+					} else {
+						apply(last, last.after);
+					}
+				}
+			} catch (...) {
+				while (applied-- > 0) {
+					const Edit &first = editList[spans[applied].first];
+					const Edit &last = editList[spans[applied].second];
+					if (back) {
+						apply(last, last.after);
+					} else {
+						apply(first, first.before);
+					}
+				}
+				throw;
+			}
+			done = target;
+			return true;
+		}
+
+	private:
+		std::vector<Edit> editList;
+		size_t done;
+		std::map<std::string, size_t> names;
+
+		/**
+		 * Positions of the first and the last edit of every tag and kind of
+		 * edit in [from, to), in the order to apply them: latest first when
+		 * going back, earliest first when going forward
+		 */
+		std::vector<std::pair<size_t, size_t>> tagSpans(size_t from, size_t to, bool back) const;
+	};
+
+} // hf_workshop
+
+#endif // EDIT_JOURNAL_HPP
@@ -0,0 +1,109 @@
+/**
+ * HF Workshop - Export manifest
+ */
+
+#include "export_manifest.hpp"
+
+#include <exception>    // exception
+#include <filesystem>   // exists
+#include <sstream>      // istringstream
+#include <system_error> // error_code
+
+#include "io_wrapper.hpp" // readBinaryFile, writeBinaryFile
+#include "xxhash.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace hf_workshop {
+
+	namespace {
+		const string HEADER = "HF Workshop export manifest 1";
+	}
+
+	ExportManifest::ExportManifest(const string &_filename) : filename(_filename), entries(), changed(false) {
+
+		error_code ec;
+		if (!fs::exists(filename, ec)) {
+			return;
+		}
+		vector<uint8_t> contents;
+		try {
+			l18n::readBinaryFile(filename, contents);
+		} catch (const exception &) {
+			return;
+		}
+
+		istringstream in(string(contents.begin(), contents.end()));
+		string line;
+		if (!getline(in, line) || line != HEADER) {
+			return;
+		}
+
+		// kind \t id \t hash \t output
+		while (getline(in, line)) {
+			size_t t1 = line.find('\t');
+			size_t t2 = t1 == string::npos ? t1 : line.find('\t', t1 + 1);
+			size_t t3 = t2 == string::npos ? t2 : line.find('\t', t2 + 1);
+			if (t3 == string::npos || t3 + 1 == line.size()) {
+				continue;
+			}
+			try {
+				size_t id = stoul(line.substr(t1 + 1, t2 - t1 - 1));
+				uint64_t hash = stoull(line.substr(t2 + 1, t3 - t2 - 1), nullptr, 16);
+				entries.insert_or_assign({line.substr(0, t1), id}, Entry{hash, line.substr(t3 + 1)});
+			} catch (const exception &) {}
+		}
+	}
+
+	ExportManifest::~ExportManifest() = default;
+
+	bool ExportManifest::upToDate(const string &kind, size_t id, uint64_t sourceHash, const string &output) const {
+		auto it = entries.find({kind, id});
+		if (it == entries.end() || it->second.hash != sourceHash || it->second.output != output) {
+			return false;
+		}
+		error_code ec;
+		return fs::exists(output, ec);
+	}
+
+	void ExportManifest::set(const string &kind, size_t id, uint64_t sourceHash, const string &output) {
+		auto it = entries.find({kind, id});
+		if (it != entries.end() && it->second.hash == sourceHash && it->second.output == output) {
+			return;
+		}
+		entries.insert_or_assign({kind, id}, Entry{sourceHash, output});
+		changed = true;
+	}
+
+	void ExportManifest::save() const {
+		if (!changed) {
+			return;
+		}
+
+		string text = HEADER + '\n';
+		for (const auto &e : entries) {
+			text += e.first.first + '\t' + to_string(e.first.second) + '\t' + hashToHex(e.second.hash) +
+			        '\t' + e.second.output + '\n';
+		}
+
+		// The manifest is best effort, like the compression cache
+		try {
+			l18n::writeBinaryFile(filename, vector<uint8_t>(text.begin(), text.end()));
+		} catch (const exception &) {}
+	}
+
+	map<size_t, uint64_t> characterHashes(const vector<uint8_t> &fws, const vector<IndexedTag> &tags, uint64_t seed) {
+		map<size_t, uint64_t> hashes;
+		for (const IndexedTag &t : tags) {
+			if (t.record.end() > fws.size()) {
+				return {};
+			}
+			if (t.id != IndexedTag::NO_ID) {
+				hashes[t.id] = xxh64(fws.data() + t.record.offset, t.record.end() - t.record.offset, seed);
+			}
+		}
+		return hashes;
+	}
+
+} // hf_workshop
@@ -0,0 +1,71 @@
+/**
+ * HF Workshop - Export manifest
+ *
+ * Remembers which tag every exported file was made from, so that exporting
+ * again into the same directory only writes the files whose tag changed.
+ */
+
+#ifndef EXPORT_MANIFEST_HPP
+#define EXPORT_MANIFEST_HPP
+
+#include <map>
+#include <string>
+#include <utility> // pair
+#include <vector>
+#include <cstdint> // uint8_t, uint64_t
+#include <cstddef> // size_t
+
+#include "swf_index.hpp" // IndexedTag
+
+namespace hf_workshop {
+
+	/**
+	 * Text file with a line per exported file: the kind of export, the ID of
+	 * the tag, the hash of the tag and the name of the file. Lines that can't
+	 * be read are dropped, so a damaged manifest only makes files be exported
+	 * again.
+	 */
+	class ExportManifest {
+	public:
+		/// Name of the manifest in the directory of the exported files
+		static constexpr const char *FILENAME = "hfw_export_manifest.txt";
+
+		/// Reads the manifest if there's one
+		explicit ExportManifest(const std::string &filename = FILENAME);
+		~ExportManifest();
+
+		/**
+		 * Whether `output` was exported from a tag with this hash by the
+		 * last export of this kind, and is still there.
+		 */
+		bool upToDate(const std::string &kind, size_t id, uint64_t sourceHash, const std::string &output) const;
+
+		/// Records that `output` was exported from a tag with this hash
+		void set(const std::string &kind, size_t id, uint64_t sourceHash, const std::string &output);
+
+		/// Writes the manifest, replacing the previous one only once it's complete. Errors are ignored.
+		void save() const;
+
+	private:
+		struct Entry {
+			uint64_t hash;
+			std::string output;
+		};
+
+		std::string filename;
+		std::map<std::pair<std::string, size_t>, Entry> entries;  // by kind and ID
+		bool changed;
+	};
+
+	/**
+	 * XXH64 of the complete tag record of every character of an uncompressed
+	 * SWF, by character ID, `tags` being its tag records (see indexSwfTags).
+	 * `seed` tells apart the hashes of exports with different settings.
+	 * Empty if the records don't fit in the SWF.
+	 */
+	std::map<size_t, uint64_t> characterHashes(const std::vector<uint8_t> &fws, const std::vector<IndexedTag> &tags,
+	                                           uint64_t seed);
+
+} // hf_workshop
+
+#endif // EXPORT_MANIFEST_HPP
@@ -10,6 +10,10 @@
 #include <stdexcept> // std::exception
 #include <map>       // std::map
 #include <utility>    // std::pair
+#include <optional>   // std::optional
+#include <regex>      // std::regex_error
+#include <filesystem>   // std::filesystem::equivalent
+#include <system_error> // std::error_code
 
 #include <json.hpp>
 
@@ -25,6 +29,25 @@
 #include "swf.hpp"
 #include "utils.hpp"
 #include "swf_utils.hpp" // concatVectorWithContainer
+#include "xxhash.hpp"
+#include "png_optimizer.hpp"
+#include "parallel.hpp"
+#include "swf_tags.hpp"
+#include "lossless_bitmap.hpp"
+#include "amf_json.hpp"
+#include "amf_byte_array.hpp"
+#include "data_file_index.hpp"
+#include "json_amf.hpp"
+#include "amf_transcoder.hpp"
+#include "text_scan.hpp"
+#include "data_model.hpp"
+#include "data_snapshot.hpp"
+#include "export_manifest.hpp"
+#include "edit_journal.hpp"
+#include "mod_patch.hpp"
+#include "batch.hpp"
+#include "swf_stream.hpp"
+#include "mapped_file.hpp"
 
 // Because of libintl conflict with json, these headers must come after <json.hpp> and "amf0.hpp"
 #include "io_wrapper.hpp"
@@ -34,21 +57,21 @@ using namespace std;
 using namespace swf;
 using namespace l18n;
 using namespace hf_workshop;
+namespace fs = std::filesystem;
 
-hfw::hfw(const std::string & _globalZipComment) : unsaved(false),
+hfw::hfw(const Options &_options, const std::string & _globalZipComment) : cmdOptions(_options), unsaved(false),
              isHFX(false), globalZipComment(_globalZipComment),
              io(), swf(nullptr),
-             stages_ids(), data_ids(), apkOriginalFilename() {
+             swfBuffer(), libswfChanges(false), swfIndex(), symbols(), stages_ids(), data_ids(), gameFilename(), apkOriginalFilename(),
+             cwsCompressor(), compressionCache(), dataHashes(), tagOverrides(), tagHashes(), queryIndex(), journal() {
 
 	rlutil::setConsoleTitle(this->io.getText("HF Workshop"));
 	this->printHeader();
 
 	try {
 		this->readFile();
-		this->fillDataIDs();
-		if (this->swf->getVersion() >= 28) {
+		if (this->isHFX) {
 			printf_colored(rlutil::LIGHTGREEN, io.getText("\nHero Fighter X detected!\n\n"));
-			this->isHFX = true;
 		}
 		this->showMenuMain();
 	} catch (const exception &e) {
@@ -56,10 +79,12 @@ hfw::hfw(const std::string & _globalZipComment) : unsaved(false),
 	}
 }
 
+hfw::~hfw() = default;
+
 string hfw::getSwfFileNameFromAPK(minizip::Unzipper &unzipper) {
 	auto entries = unzipper.getEntries();
 	for (const auto &ze : entries) {
-		if (startsWith(ze.name, "assets/HeroFighterX") && endsWith(ze.name, ".swf")) {
+		if (isGameSwfEntry(ze.name)) {
 			return ze.name;
 		}
 	}
@@ -75,18 +100,16 @@ void hfw::readFile() {
 			readLine(filename, io.getText("File path: "));
 			removequotes(trim(filename));
 
+			vector<uint8_t> buffer;
 			try {
 				minizip::Unzipper unzipper(filename);
 				string swfName = getSwfFileNameFromAPK(unzipper);
-				vector<uint8_t> unzipped_entry;
-				unzipper.extractEntryToMemory(swfName, unzipped_entry);
+				unzipper.extractEntryToMemory(swfName, buffer);
 				apkOriginalFilename = filename;
-				swf = make_unique<SWF>(unzipped_entry);
 			} catch (const minizip::minizip_exception &) {
-				vector<uint8_t> buffer;
 				readBinaryFile(filename, buffer);
-				swf = make_unique<SWF>(buffer);
 			}
+			openGame(filename, move(buffer));
 
 		} catch (const exception &e) {
 			printf_error(io.getText("Error: %s\n"), e.what());
@@ -95,20 +118,152 @@ void hfw::readFile() {
 	} while (fileNameError);
 }
 
+void hfw::openGame(const string &filename, vector<uint8_t> buffer) {
+
+	gameFilename = filename;
+
+	string indexPath;
+	SwfIndexKey key{};
+	try {
+		key = swfIndexKey(filename, buffer);
+		indexPath = swfIndexPath(filename);
+		swfIndex = loadSwfIndex(indexPath, key);
+	} catch (const exception &) {
+		swfIndex.reset();
+	}
+
+	swf.reset();
+	tagHashes.clear();
+	if (buffer.size() < 8 || (buffer[0] != 'F' && buffer[0] != 'C') || buffer[1] != 'W' || buffer[2] != 'S') {
+		// LZMA compressed or inside an executable: only libswf can read it, it keeps the projector
+		swf = make_unique<SWF>(buffer);
+		buffer = swf->exportSwf(CompressionChoice::uncompressed);
+	}
+	swfBuffer = move(buffer);
+
+	if (swfIndex) {
+		// Opened before: the IDs are known and libswf parses the game when it's first needed
+		stages_ids = swfIndex->stageIds;
+		data_ids = swfIndex->dataIds;
+		sort(stages_ids.begin(), stages_ids.end());
+		sort(data_ids.begin(), data_ids.end());
+		symbols = symbolIndexOf(swfIndex->symbols);
+		isHFX = (swfIndex->version >= 28);
+		return;
+	}
+
+	game();
+	map<int, vector<IndexedSymbol>> tagSymbols;
+	for (const char *type : {"DefineBinaryData", "DefineBitsLossless", "DefineBitsLossless2", "DefineSound"}) {
+		auto &typeSymbols = tagSymbols[SWF::tagId(type)];
+		for (auto t : swf->getTagsOfType(SWF::tagId(type))) {
+			typeSymbols.push_back({t->id, t->symbolName});
+		}
+	}
+	symbols = symbolIndexOf(tagSymbols);
+	fillDataIDs();
+	isHFX = (swf->getVersion() >= 28);
+
+	// Kept even if it can't be saved, for its tag records
+	SwfIndex index;
+	index.key = key;
+	index.version = swf->getVersion();
+	index.stageIds = stages_ids;
+	index.dataIds = data_ids;
+	index.symbols = move(tagSymbols);
+	index.tags = indexSwfTags(originalSwf());
+	swfIndex = move(index);
+	if (!indexPath.empty()) {
+		saveSwfIndex(indexPath, *swfIndex);
+	}
+}
+
+SWF &hfw::game() {
+	if (swf == nullptr) {
+		swf = make_unique<SWF>(swfBuffer);
+	}
+	return *swf;
+}
+
 void hfw::fillDataIDs() {
-	vector<Tag *> tv = swf->getTagsOfType(SWF::tagId("DefineBinaryData"));
+	vector<size_t> binaryData = idsOfType(SWF::tagId("DefineBinaryData"));
 
-	for (auto &t : tv) {
-		if (startsWith(t->symbolName, "Data.Global_story0") ||
-		    t->symbolName.find("storylist") != std::string::npos) {
-			stages_ids.push_back(t->id);
-		} else if (endsWith(t->symbolName, "Spt") || endsWith(t->symbolName, "Lmi") ||
-		           endsWith(t->symbolName, "_globalDat") || endsWith(t->symbolName, "_bg0Bgi")) {
-			data_ids.push_back(t->id);
+	stages_ids = selectIds("Data.Global_story0*,*storylist*", binaryData);
+	data_ids.clear();
+	for (auto id : selectIds("*Spt,*Lmi,*_globalDat,*_bg0Bgi", binaryData)) {
+		if (!binary_search(stages_ids.begin(), stages_ids.end(), id)) {
+			data_ids.push_back(id);
 		}
 	}
 }
 
+vector<size_t> hfw::idsOfType(int type) const {
+	vector<size_t> ids;
+	for (auto e : symbols.ofType(type)) {
+		ids.push_back(e->id);
+	}
+	sort(ids.begin(), ids.end());
+	return ids;
+}
+
+vector<size_t> hfw::selectIds(const string &input, const vector<size_t> &scope) {
+	// IDs are taken as they are, so that missing ones are reported
+	string numbers = input;
+	vector<size_t> ids = getVectorOfNumbers<size_t>(numbers);
+	if (!ids.empty()) {
+		return ids;
+	}
+
+	vector<size_t> selected;
+	try {
+		if (startsWith(input, "re:")) {
+			selected = symbols.regex(input.substr(3));
+		} else {
+			stringstream ss(input);
+			string item;
+			while (getline(ss, item, ',')) {
+				trim(item);
+				if (item.empty()) {
+					continue;
+				}
+				vector<size_t> matches = symbols.glob(item);
+				if (matches.empty()) {
+					// Maybe an ID among patterns
+					vector<size_t> id = getVectorOfNumbers<size_t>(item);
+					matches.insert(matches.end(), id.begin(), id.end());
+				}
+				selected.insert(selected.end(), matches.begin(), matches.end());
+			}
+		}
+	} catch (const regex_error &e) {
+		printf_error(io.getText("Invalid regular expression: %s\n"), e.what());
+		return {};
+	}
+
+	ids.clear();
+	for (auto id : selected) {
+		if (binary_search(scope.begin(), scope.end(), id)) {
+			ids.push_back(id);
+		}
+	}
+	sort(ids.begin(), ids.end());
+	ids.erase(unique(ids.begin(), ids.end()), ids.end());
+	return ids;
+}
+
+optional<size_t> hfw::selectOneId(const string &input, const vector<size_t> &scope) {
+	vector<size_t> ids = selectIds(input, scope);
+	if (ids.size() != 1) {
+		if (ids.size() > 1) {
+			printf_error(io.getText("%zu files match, choose only one.\n"), ids.size());
+		} else {
+			printf_error(io.getText("Invalid input.\n"));
+		}
+		return nullopt;
+	}
+	return ids.front();
+}
+
 void hfw::showMenuMain() {
 
 	while (true) {
@@ -118,7 +273,8 @@ void hfw::showMenuMain() {
 		vector<string> options = {io.getText("Help"), io.getText("Edit stages"),
 			io.getText("Edit sounds"), io.getText("Edit images"),
 			io.getText("Edit data"), io.getText("Export SWF"),
-			io.getText((this->isHFX ? "Export APK" : "Export EXE")), io.getText("Exit")};
+			io.getText((this->isHFX ? "Export APK" : "Export EXE")), io.getText("Edit history"),
+			io.getText("Export patch"), io.getText("Apply patch"), io.getText("Exit")};
 
 		printOptions(options);
 
@@ -157,6 +313,15 @@ void hfw::showMenuMain() {
 			} else {
 				exportExe();
 			}
+		} else if (choice == "8") {
+			showMenuHistory();
+		} else if (choice == "9") {
+			exportPatch();
+		} else if (choice == "10") {
+			string patchFileName;
+			readLine(patchFileName, io.getText("Path to the patch: "));
+			removequotes(trim(patchFileName));
+			applyPatch(patchFileName);
 		} else {
 			printf_normal(io.getText("Invalid option.\n"));
 		}
@@ -182,13 +347,13 @@ void hfw::showMenuStages() {
 			printf_colored(rlutil::YELLOW, io.getText("Which stage(s) do you wish to export?\n"));
 			string ids;
 			/// TRANSLATORS: Please don't change the 'all' option
-			readLine(ids, io.getText("Type 'all' or comma separated IDs: "));
+			readLine(ids, io.getText("Type 'all', comma separated IDs or names (* and ? match any text and character, re: starts a regular expression): "));
 			trim(ids);
 			if (equalsIgnoreCase(ids, "all")) {
 				int count = exportStages(stages_ids);
 				printf_colored(rlutil::YELLOW, io.getText("Exported %d stage file(s).\n"), count);
 			} else {
-				vector<size_t> ids_v = getVectorOfNumbers<size_t>(ids);
+				vector<size_t> ids_v = selectIds(ids, stages_ids);
 
 				if (ids_v.empty()) {
 					printf_error(io.getText("Invalid input.\n"));
@@ -202,20 +367,13 @@ void hfw::showMenuStages() {
 			// Get id to replace
 			printf_colored(rlutil::YELLOW, io.getText("Which stage file do you wish to replace?\n"));
 			string id_s;
-			readLine(id_s, io.getText("Stage ID: "));
+			readLine(id_s, io.getText("Stage ID or name: "));
 			trim(id_s);
-			size_t id, end;
-
-			try {
-				id = stoul(id_s, &end);
-				if (end < id_s.length()) {
-					printf_error(io.getText("Invalid number.\n"));
-					continue;
-				}
-			} catch (const logic_error &) {
-				printf_error(io.getText("Invalid number.\n"));
+			optional<size_t> selected = selectOneId(id_s, stages_ids);
+			if (!selected) {
 				continue;
 			}
+			size_t id = *selected;
 
 			// Get stage filename
 			printf_colored(rlutil::YELLOW, io.getText("Which stage file do you wish to replace with? (.xml)\n"));
@@ -232,6 +390,11 @@ void hfw::showMenuStages() {
 
 void hfw::showMenuImages() {
 
+	vector<size_t> imageIds = idsOfType(SWF::tagId("DefineBitsLossless"));
+	vector<size_t> lossless2 = idsOfType(SWF::tagId("DefineBitsLossless2"));
+	imageIds.insert(imageIds.end(), lossless2.begin(), lossless2.end());
+	sort(imageIds.begin(), imageIds.end());
+
 	string choice2;
 	while (true) {
 
@@ -249,13 +412,13 @@ void hfw::showMenuImages() {
 		} else if (choice2 == "2") {
 			printf_colored(rlutil::YELLOW, io.getText("Which image(s) do you wish to export?\n"));
 			string ids;
-			readLine(ids, io.getText("Type 'all' or comma separated IDs: "));
+			readLine(ids, io.getText("Type 'all', comma separated IDs or names (* and ? match any text and character, re: starts a regular expression): "));
 			trim(ids);
 			if (equalsIgnoreCase(ids, "all")) {
 				vector<size_t> v{};
 				exportImages(v);
 			} else {
-				vector<size_t> ids_v = getVectorOfNumbers<size_t>(ids);
+				vector<size_t> ids_v = selectIds(ids, imageIds);
 
 				if (ids_v.empty()) {
 					printf_error(io.getText("Invalid input.\n"));
@@ -269,20 +432,13 @@ void hfw::showMenuImages() {
 			// Get id to replace
 			printf_colored(rlutil::YELLOW, io.getText("Which image do you wish to replace?\n"));
 			string id_s;
-			readLine(id_s, io.getText("Image ID: "));
+			readLine(id_s, io.getText("Image ID or name: "));
 			trim(id_s);
-			size_t id, end;
-
-			try {
-				id = stoul(id_s, &end);
-				if (end < id_s.length()) {
-					printf_error(io.getText("Invalid number.\n"));
-					continue;
-				}
-			} catch (const logic_error &) {
-				printf_error(io.getText("Invalid number.\n"));
+			optional<size_t> selected = selectOneId(id_s, imageIds);
+			if (!selected) {
 				continue;
 			}
+			size_t id = *selected;
 
 			// Get image filename
 			printf_colored(rlutil::YELLOW, io.getText("Which image file do you wish to replace with?\n"));
@@ -299,6 +455,8 @@ void hfw::showMenuImages() {
 
 void hfw::showMenuSounds() {
 
+	vector<size_t> soundIds = idsOfType(SWF::tagId("DefineSound"));
+
 	string choice2;
 	while (true) {
 
@@ -315,13 +473,13 @@ void hfw::showMenuSounds() {
 		} else if (choice2 == "2") {
 			printf_colored(rlutil::YELLOW, io.getText("Which sound(s) do you wish to export?\n"));
 			string ids;
-			readLine(ids, io.getText("Type 'all' or comma separated IDs: "));
+			readLine(ids, io.getText("Type 'all', comma separated IDs or names (* and ? match any text and character, re: starts a regular expression): "));
 			trim(ids);
 			if (equalsIgnoreCase(ids, "all")) {
 				vector<size_t> v{};
 				exportSounds(v);
 			} else {
-				vector<size_t> ids_v = getVectorOfNumbers<size_t>(ids);
+				vector<size_t> ids_v = selectIds(ids, soundIds);
 
 				if (ids_v.empty()) {
 					printf_error(io.getText("Invalid input.\n"));
@@ -335,20 +493,13 @@ void hfw::showMenuSounds() {
 			// Get id to replace
 			printf_colored(rlutil::YELLOW, io.getText("Which MP3 sound do you wish to replace?\n"));
 			string id_s;
-			readLine(id_s, io.getText("Sound ID: "));
+			readLine(id_s, io.getText("Sound ID or name: "));
 			trim(id_s);
-			size_t id, end;
-
-			try {
-				id = stoul(id_s, &end);
-				if (end < id_s.length()) {
-					printf_error(io.getText("Invalid number.\n"));
-					continue;
-				}
-			} catch (const logic_error &) {
-				printf_error(io.getText("Invalid number.\n"));
+			optional<size_t> selected = selectOneId(id_s, soundIds);
+			if (!selected) {
 				continue;
 			}
+			size_t id = *selected;
 
 			// Get mp3 filename
 			printf_colored(rlutil::YELLOW, io.getText("Which MP3 file do you wish to replace with?\n"));
@@ -369,7 +520,9 @@ void hfw::showMenuData() {
 	while (true) {
 
 		vector<string> options = {io.getText("List data files"), io.getText("Export data file(s)"),
-			io.getText("Replace data file"), io.getText("Back")};
+			io.getText("Replace data file"), io.getText("Export data file(s) for the other version (HF v0.7 <-> HFX)"),
+			io.getText("Export a snapshot of all data files for analysis"), io.getText("Query data files"),
+			io.getText("Back")};
 
 		printOptions(options);
 
@@ -378,43 +531,37 @@ void hfw::showMenuData() {
 			break;
 		} else if (choice2 == "1") {
 			listTagsWithIds(data_ids);
-		} else if (choice2 == "2") {
+		} else if (choice2 == "2" || choice2 == "4") {
+			bool otherVersion = (choice2 == "4");
 			printf_colored(rlutil::YELLOW, io.getText("Which data file(s) do you wish to export?\n"));
 			string ids;
-			readLine(ids, io.getText("Type 'all' or comma separated IDs: "));
+			readLine(ids, io.getText("Type 'all', comma separated IDs or names (* and ? match any text and character, re: starts a regular expression): "));
 			trim(ids);
 			if (equalsIgnoreCase(ids, "all")) {
 				vector<size_t> v{};
-				exportData(v);
+				exportData(v, otherVersion);
 			} else {
-				vector<size_t> ids_v = getVectorOfNumbers<size_t>(ids);
+				vector<size_t> ids_v = selectIds(ids, data_ids);
 
 				if (ids_v.empty()) {
 					printf_error(io.getText("Invalid input.\n"));
 					continue;
 				}
 
-				int count = exportData(ids_v);
+				int count = exportData(ids_v, otherVersion);
 				printf_colored(rlutil::YELLOW, io.getText("Exported %d data file(s).\n"), count);
 			}
 		} else if (choice2 == "3") {
 			// Get id to replace
 			printf_colored(rlutil::YELLOW, io.getText("Which data file do you wish to replace?\n"));
 			string id_s;
-			readLine(id_s, io.getText("Data ID: "));
+			readLine(id_s, io.getText("Data ID or name: "));
 			trim(id_s);
-			size_t id, end;
-
-			try {
-				id = stoul(id_s, &end);
-				if (end < id_s.length()) {
-					printf_error(io.getText("Invalid number.\n"));
-					continue;
-				}
-			} catch (const logic_error &) {
-				printf_error(io.getText("Invalid number.\n"));
+			optional<size_t> selected = selectOneId(id_s, data_ids);
+			if (!selected) {
 				continue;
 			}
+			size_t id = *selected;
 
 			// Get data filename
 			printf_colored(rlutil::YELLOW, io.getText("Which data file do you wish to replace with? (.zip)\n"));
@@ -423,6 +570,17 @@ void hfw::showMenuData() {
 			removequotes(trim(chr_s));
 
 			replaceData(id, chr_s);
+		} else if (choice2 == "5") {
+			/// TRANSLATORS: Don't change default snapshot name
+			string snapshotName = askFilePathWithDefaultOption(string{io.getText("Path to output file (default=data_snapshot.hfs): ")}, "data_snapshot.hfs");
+			try {
+				int count = exportDataSnapshot(snapshotName);
+				printf_colored(rlutil::YELLOW, io.getText("Exported %d data file(s) to '%s'.\n"), count, snapshotName.c_str());
+			} catch (const exception &e) {
+				printf_error(io.getText("Error: %s\n"), e.what());
+			}
+		} else if (choice2 == "6") {
+			queryData();
 		} else {
 			printf_error(io.getText("Invalid option.\n"));
 		}
@@ -431,50 +589,45 @@ void hfw::showMenuData() {
 
 void hfw::listTagsWithIds(vector<size_t> ids) {
 
-	vector<pair<size_t, string>> tags;
-	for (auto id : ids) {
-		auto tag = static_cast<Tag_DefineBinaryData *>(swf->getTagWithId(id));
-		if (tag == nullptr) {
-			printf_error(io.getText("File with ID=%zu not found inside the game.\n"), id);
-			continue;
+	sort(ids.begin(), ids.end());
+	vector<bool> found(ids.size(), false);
+	// The index is sorted by name
+	for (const auto &e : symbols.entries()) {
+		auto it = lower_bound(ids.begin(), ids.end(), e.id);
+		if (it != ids.end() && *it == e.id && e.type == SWF::tagId("DefineBinaryData")) {
+			found[static_cast<size_t>(it - ids.begin())] = true;
+			printf_colored(rlutil::LIGHTRED, "%zu", e.id);
+			printf_normal(": %s\n", e.name.c_str());
 		}
-		tags.emplace_back(tag->id, tag->symbolName);
 	}
-	// Sort by name
-	sort(tags.begin(), tags.end(), [](pair<size_t, string> const &p1,
-	                                  pair<size_t, string> const &p2) { return p1.second < p2.second; });
-	for (auto p : tags) {
-		printf_colored(rlutil::LIGHTRED, "%zu", p.first);
-		printf_normal(": %s\n", p.second.c_str());
+	for (size_t i = 0; i < ids.size(); ++i) {
+		if (!found[i]) {
+			printf_error(io.getText("File with ID=%zu not found inside the game.\n"), ids[i]);
+		}
 	}
 }
 
 void hfw::listTagsOfType(int id) {
 
-	vector<Tag *> tv = swf->getTagsOfType(id);
-
-	// Sort by name
-	sort(tv.begin(), tv.end(), [](Tag * const &t1, Tag * const &t2) { return t1->symbolName < t2->symbolName; });
-
-	for (auto t : tv) {
-		printf_colored(rlutil::LIGHTRED, "%zu", t->id);
-		printf_normal(": %s\n", t->symbolName.c_str());
+	// The index is sorted by name
+	for (auto e : symbols.ofType(id)) {
+		printf_colored(rlutil::LIGHTRED, "%zu", e->id);
+		printf_normal(": %s\n", e->name.c_str());
 	}
 }
 
 int hfw::exportImages(vector<size_t> &ids) {
 
 	int count = 0;
-	vector<Tag *> tv = swf->getTagsOfType(SWF::tagId("DefineBitsLossless"));
-	vector<Tag *> tv1 = swf->getTagsOfType(SWF::tagId("DefineBitsLossless2"));
-	tv.insert(tv.end(), tv1.begin(), tv1.end());
+	vector<const SymbolEntry *> images = symbols.ofType(SWF::tagId("DefineBitsLossless"));
+	vector<const SymbolEntry *> images2 = symbols.ofType(SWF::tagId("DefineBitsLossless2"));
+	images.insert(images.end(), images2.begin(), images2.end());
 
 	// Check if ids exist
 	for (auto i : ids) {
 		bool found = false;
-		for (auto &t : tv) {
-			auto dbl = static_cast<Tag_DefineBitsLossless *>(t);
-			if (dbl->id == i) {
+		for (auto e : images) {
+			if (e->id == i) {
 				found = true;
 				break;
 			}
@@ -484,39 +637,119 @@ int hfw::exportImages(vector<size_t> &ids) {
 		}
 	}
 
-	for (auto &t : tv) {
-		auto dbl = static_cast<Tag_DefineBitsLossless *>(t);
-		auto found = find(ids.begin(), ids.end(), dbl->id);
+	// The images are converted from the tags' pixels here rather than by libswf,
+	// so that all of them are converted at once on every core. The tags are read
+	// where they are in the game or, if they were replaced, from 'tagOverrides'.
+	// libswf only changes sounds, so the game's images are up to date.
+	struct BitmapTag {
+		const uint8_t *data;
+		TagRecord record;
+	};
+	map<size_t, BitmapTag> bitmapTags;
+	try {
+		const vector<uint8_t> &fws = originalSwf();
+		for (const IndexedTag &t : originalTags()) {
+			if ((t.record.code == TAG_DEFINE_BITS_LOSSLESS || t.record.code == TAG_DEFINE_BITS_LOSSLESS2) &&
+			    t.record.end() <= fws.size()) {
+				bitmapTags[t.id] = {fws.data(), t.record};
+			}
+		}
+	} catch (const exception &) {
+		bitmapTags.clear();
+	}
+	for (const auto &o : tagOverrides) {
+		try {
+			TagRecord record = readTagRecord(o.second->data(), o.second->size(), 0);
+			if (record.code == TAG_DEFINE_BITS_LOSSLESS || record.code == TAG_DEFINE_BITS_LOSSLESS2) {
+				bitmapTags[o.first] = {o.second->data(), record};
+			}
+		} catch (const exception &) {}
+	}
+
+	// Images whose tag didn't change since they were last exported are left as they are
+	ExportManifest manifest;
+	map<size_t, uint64_t> sourceHashes = characterTagHashes(0);
+
+	struct ImageExport {
+		size_t id;
+		string name;
+		vector<uint8_t> png;
+	};
+	vector<ImageExport> exports;
+
+	for (auto e : images) {
+		auto found = find(ids.begin(), ids.end(), e->id);
 		if (ids.empty() || found != ids.end()) {
-			string name = dbl->symbolName;
+			string name = e->name;
 			if (name == "") {
-				name = to_string(dbl->id);
+				name = to_string(e->id);
 			} else {
-				name = to_string(dbl->id) + " - " + name;
+				name = to_string(e->id) + " - " + name;
 			}
 			name += ".png";
 
-			printf_normal(io.getText("Exporting: %s\n"), name.c_str());
+			auto hash = sourceHashes.find(e->id);
+			if (hash != sourceHashes.end() && manifest.upToDate("image", e->id, hash->second, name)) {
+				printf_normal(io.getText("Unchanged: %s\n"), name.c_str());
+				++count;
+				continue;
+			}
+			exports.push_back({e->id, name, {}});
+		}
+	}
+
+	parallelFor(exports.size(), [&](size_t i) {
+		auto it = bitmapTags.find(exports[i].id);
+		if (it == bitmapTags.end()) {
+			return;
+		}
+		const TagRecord &record = it->second.record;
+		try {
+			exports[i].png = losslessToPng(it->second.data + record.bodyOffset(), record.length,
+			                               record.code == TAG_DEFINE_BITS_LOSSLESS2, AlphaRounding::exact);
+		} catch (const exception &) {
+			// Left to libswf, which reports the error
+			exports[i].png.clear();
+		}
+	});
+
+	for (auto &e : exports) {
+
+		printf_normal(io.getText("Exporting: %s\n"), e.name.c_str());
 
-			vector<uint8_t> imageData;
+		if (e.png.empty()) {
+			// libswf still has the image that a replaced one replaced
+			if (tagOverrides.count(e.id) != 0) {
+				printf_error(io.getText("Error for image with ID=%zu: %s\n"), e.id,
+				             io.getText("The replaced image can't be read."));
+				continue;
+			}
 			try {
-				imageData = swf->exportImage(dbl->id);
+				e.png = game().exportImage(e.id);
 			} catch (const swf_exception &se) {
-				printf_error(io.getText("Error for image with ID=%zu: %s\n"), dbl->id, se.what());
+				printf_error(io.getText("Error for image with ID=%zu: %s\n"), e.id, se.what());
 				continue;
 			}
+		}
 
-			writeBinaryFile(name, imageData);
+		writeBinaryFile(e.name, e.png);
 
-			++count;
+		auto hash = sourceHashes.find(e.id);
+		if (hash != sourceHashes.end()) {
+			manifest.set("image", e.id, hash->second, e.name);
 		}
+
+		++count;
 	}
+	manifest.save();
 	return count;
 }
 
 int hfw::exportStages(vector<size_t> &ids) {
 
 	int count = 0;
+	ExportManifest manifest;
+	map<size_t, uint64_t> sourceHashes = characterTagHashes(0);
 
 	Tag_DefineBinaryData * t;
 	string name;
@@ -527,7 +760,7 @@ int hfw::exportStages(vector<size_t> &ids) {
 			continue;
 		}
 
-		t = static_cast<Tag_DefineBinaryData *>(swf->getTagWithId(id));
+		t = static_cast<Tag_DefineBinaryData *>(game().getTagWithId(id));
 		if (t == nullptr) {
 			printf_error(io.getText("Stage file with ID=%zu not found inside the game.\n"), id);
 			continue;
@@ -535,26 +768,39 @@ int hfw::exportStages(vector<size_t> &ids) {
 		name = to_string(t->id) + " - " + t->symbolName;
 		name += ".xml";
 
+		auto hash = sourceHashes.find(id);
+		if (hash != sourceHashes.end() && manifest.upToDate("stage", id, hash->second, name)) {
+			printf_normal(io.getText("Unchanged: %s\n"), name.c_str());
+			++count;
+			continue;
+		}
+
 		printf_normal(io.getText("Exporting: %s\n"), name.c_str());
 
 		vector<uint8_t> xmlData;
 		try {
-			xmlData = swf->exportBinary(id);
+			xmlData = game().exportBinary(id);
 		} catch (const swf_exception &se) {
 			printf_error(io.getText("Error for stage file with ID=%zu: %s\n"), id, se.what());
 			continue;
 		}
 		writeBinaryFile(name, xmlData);
+		if (hash != sourceHashes.end()) {
+			manifest.set("stage", id, hash->second, name);
+		}
 
 		++count;
 	}
+	manifest.save();
 	return count;
 }
 
 int hfw::exportSounds(vector<size_t> &ids) {
 
 	int count = 0;
-	vector<Tag *> tv = swf->getTagsOfType(SWF::tagId("DefineSound"));
+	vector<Tag *> tv = game().getTagsOfType(SWF::tagId("DefineSound"));
+	ExportManifest manifest;
+	map<size_t, uint64_t> sourceHashes = characterTagHashes(0);
 
 	// Check if ids exist
 	for (auto i : ids) {
@@ -590,27 +836,169 @@ int hfw::exportSounds(vector<size_t> &ids) {
 			}
 			name += ".mp3";
 
+			auto hash = sourceHashes.find(ds->id);
+			if (hash != sourceHashes.end() && manifest.upToDate("sound", ds->id, hash->second, name)) {
+				printf_normal(io.getText("Unchanged: %s\n"), name.c_str());
+				++count;
+				continue;
+			}
+
 			printf_normal(io.getText("Exporting: %s\n"), name.c_str());
 
-			vector<uint8_t> mp3Data = swf->exportMp3(ds->id);
+			vector<uint8_t> mp3Data = game().exportMp3(ds->id);
 
 			writeBinaryFile(name, mp3Data);
+			if (hash != sourceHashes.end()) {
+				manifest.set("sound", ds->id, hash->second, name);
+			}
 
 			++count;
 		}
 	}
+	manifest.save();
+	return count;
+}
+
+
+vector<DecodedDataFile> hfw::decodeDataFiles() {
+
+	struct DataFile {
+		size_t id;
+		string name;
+		vector<uint8_t> compressed;
+		unique_ptr<DataModel> model;
+		string error;
+	};
+	vector<DataFile> files;
+	AmfByteArrayReader byteArrays;
+	const uint8_t *bytes = nullptr;
+	size_t length = 0;
+
+	for (auto id : data_ids) {
+		auto t = static_cast<Tag_DefineBinaryData *>(game().getTagWithId(id));
+		if (t == nullptr) {
+			printf_error(io.getText("Data file with ID=%zu not found inside the game.\n"), id);
+			continue;
+		}
+		try {
+			vector<uint8_t> tagData = game().exportBinary(t->id);
+			size_t pos = 0;
+			if (!byteArrays.next(tagData, pos, bytes, length)) {
+				printf_error(io.getText("Error for data file with ID=%zu: Not an AMF3 ByteArray.\n"), t->id);
+				continue;
+			}
+			files.push_back({t->id, t->symbolName, vector<uint8_t>(bytes, bytes + length), nullptr, ""});
+		} catch (const exception &e) {
+			printf_error(io.getText("Error for data file with ID=%zu: %s\n"), t->id, e.what());
+		}
+	}
+
+	// The files are inflated and decoded on every core
+	parallelFor(files.size(), [&](size_t i) {
+		try {
+			files[i].model = make_unique<DataModel>(zlib::zlib_decompress(files[i].compressed));
+		} catch (const exception &e) {
+			files[i].error = e.what();
+		}
+		files[i].compressed = vector<uint8_t>();
+	});
+
+	vector<DecodedDataFile> decoded;
+	for (auto &f : files) {
+		if (f.model == nullptr) {
+			printf_error(io.getText("Error for data file with ID=%zu: %s\n"), f.id, f.error.c_str());
+			continue;
+		}
+		decoded.push_back({f.id, move(f.name), move(f.model)});
+	}
+	return decoded;
+}
+
+int hfw::exportDataSnapshot(const string &fileName) {
+
+	int count = 0;
+	DataSnapshotWriter snapshot;
+	for (auto &f : decodeDataFiles()) {
+		printf_normal(io.getText("Exporting: %s\n"), (to_string(f.id) + " - " + f.name).c_str());
+		snapshot.add(static_cast<uint32_t>(f.id), *f.model);
+		f.model.reset();
+		++count;
+	}
+
+	writeBinaryFile(fileName, snapshot.serialize());
 	return count;
 }
 
+void hfw::queryData() {
 
-int hfw::exportData(vector<size_t> &ids) {
+	if (queryIndex == nullptr) {
+		printf_normal(io.getText("Indexing the data files...\n"));
+		queryIndex = make_unique<DataQueryIndex>(decodeDataFiles());
+	}
+
+	printf_colored(rlutil::YELLOW, io.getText("Type a class and the conditions its objects must match, or nothing to go back.\n"));
+	printf_normal(io.getText("Example: Attack where injury > 50 and fall < 20\n"));
+	printf_normal(io.getText("Operators: = != < <= > >= ~ (contains). Use * for any class or member.\n"));
+
+	while (true) {
+		string text;
+		readLine(text, io.getText("Query: "));
+		trim(text);
+		if (text.empty()) {
+			break;
+		}
+
+		try {
+			DataQuery query = parseDataQuery(text);
+			vector<uint32_t> found = queryIndex->run(query);
+
+			for (auto o : found) {
+				const auto &obj = queryIndex->object(o);
+				const auto &file = queryIndex->files()[obj.file];
+				const string &className = queryIndex->className(obj.classId);
+				const string &section = file.model->index().sections[obj.section].name;
+
+				printf_colored(rlutil::LIGHTRED, "%zu", file.id);
+				if (className == section) {
+					printf_normal(" - %s: %s %u", file.name.c_str(), className.c_str(), obj.element);
+				} else {
+					printf_normal(" - %s: %s in %s %u", file.name.c_str(), className.c_str(),
+					              section.c_str(), obj.element);
+				}
+				// The members of the conditions, to show why it matched
+				string separator = " (";
+				for (const auto &c : query.conditions) {
+					if (c.field != "*") {
+						printf_normal("%s%s=%s", separator.c_str(), c.field.c_str(), queryIndex->valuesText(o, c.field).c_str());
+						separator = ", ";
+					}
+				}
+				printf_normal(separator == ", " ? ")\n" : "\n");
+			}
+			printf_colored(rlutil::YELLOW, io.getText("Found %zu object(s).\n"), found.size());
+		} catch (const invalid_argument &e) {
+			printf_error(io.getText("Invalid query: %s\n"), e.what());
+		}
+	}
+}
+
+int hfw::exportData(vector<size_t> &ids, bool otherVersion) {
 
 	int count = 0;
+	AmfJsonExporter amfJson;
+	AmfByteArrayReader byteArrays;
+	const uint8_t *bytes = nullptr;
+	size_t length = 0;
 
 	if (ids.empty()) {
 		concatVectorWithContainer(ids, data_ids);
 	}
 
+	// The zips also depend on the conversion and on the comment
+	ExportManifest manifest;
+	const string kind = otherVersion ? "data-other" : "data";
+	map<size_t, uint64_t> sourceHashes = characterTagHashes(xxh64(globalZipComment.data(), globalZipComment.size()));
+
 	string name;
 	for (auto id : ids) {
 
@@ -619,18 +1007,28 @@ int hfw::exportData(vector<size_t> &ids) {
 			continue;
 		}
 
-		auto t = static_cast<Tag_DefineBinaryData *>(swf->getTagWithId(id));
+		auto t = static_cast<Tag_DefineBinaryData *>(game().getTagWithId(id));
 		if (t == nullptr) {
 			printf_error(io.getText("Data file with ID=%zu not found inside the game.\n"), id);
 			continue;
 		}
 		name = to_string(t->id) + " - " + t->symbolName;
 
+		auto hash = sourceHashes.find(t->id);
+		if (hash != sourceHashes.end() && manifest.upToDate(kind, t->id, hash->second, name + ".zip")) {
+			printf_normal(io.getText("Unchanged: %s\n"), name.c_str());
+			++count;
+			continue;
+		}
+
 		printf_normal(io.getText("Exporting: %s\n"), name.c_str());
 
+		// Values of the previous data file are no longer needed
+		amfJson.releaseMemory();
+
 		vector<uint8_t> data;
 		try {
-			data = swf->exportBinary(t->id);
+			data = game().exportBinary(t->id);
 			/**
 			 * An AMF3 byte array that holds compressed data
 			 */
@@ -644,26 +1042,27 @@ int hfw::exportData(vector<size_t> &ids) {
 
 			auto ba = static_cast<AMF3_BYTEARRAY *>(amf.object.get());
 			data = zlib::zlib_decompress(ba->binaryData);
+			dataHashes[t->id] = xxh64(data);
 
 			//XXX Only for test
 			//writeBinaryFile(name + ".out", data);
 
-			pos = 0;
+			if (otherVersion) {
+				// AMF0 in byte arrays <-> plain AMF3, so the zip can be imported into the other game
+				data = convertDataFile(data);
+			}
 
 			/**
 			 * The decompressed byte array starts with an UTF string.
 			 * An UTF string is prefixed by 2 bytes in big-endian specifying its length.
 			 *
 			 * https://help.adobe.com/en_US/FlashPlatform/reference/actionscript/3/flash/utils/ByteArray.html#readUTF()
+			 *
+			 * The elements that follow are located first, reading only their
+			 * markers and lengths, so that each one is decoded from its own offset.
 			 */
-			uint16_t strLen = bytestodec_be<uint16_t>(data.data()+pos);;
-			pos += 2;
-			string fileType;
-
-			for(size_t i = pos; i < strLen+pos; ++i) {
-				fileType += data[i];
-			}
-			pos += strLen;
+			DataFileIndex index = indexDataFile(data);
+			const string &fileType = index.fileType;
 
 			if (fileType == "limbInfo") { // HF v0.7 and less
 
@@ -675,51 +1074,42 @@ int hfw::exportData(vector<size_t> &ids) {
 				 * A LimbPic object is serialized in AMF0 format and stored
 				 * in an AMF3 byte array.
 				 */
-				int32_t numLP = static_cast<int32_t>(bytestodec_be<uint32_t>(data.data() + pos));
-				pos += 4;
-
-				for (int32_t i = 0; i < numLP; ++i) {
+				const auto &limbPics = index.section("LimbPic").elements;
+				for (size_t i = 0; i < limbPics.size(); ++i) {
+					pos = limbPics[i].begin;
 
-					AMF3 a{ data.data(), pos };
-					if (a.object->type != AMF3::BYTE_ARRAY_MARKER) {
+					if (!byteArrays.next(data, pos, bytes, length)) {
 						printf_error(io.getText("Error for data file with ID=%zu: 'LimbPic' is not inside an AMF3 ByteArray.\n"), t->id);
 						goto CONTINUE_FOR_EACH_ID;
 					}
-					auto ba2 = static_cast<AMF3_BYTEARRAY *>(a.object.get());
 
-					// Parse AMF0
-					AMF0 limbPic{ ba2->binaryData.data()};
-					string json = limbPic.to_json_str();
+					// AMF0 to JSON
+					const string &json = amfJson.amf0(bytes, length);
 
 					// Add JSON to zip
 					zipper.add("LimbPic_" + to_string(i) + ".json", "", Z_BEST_COMPRESSION, json);
 				}
 
-				for (int32_t i = 0; i < numLP; ++i) {
-					AMF3 a{ data.data(), pos };
-
-					if (a.object->type == AMF3::BYTE_ARRAY_MARKER) {
-						auto ba2 = static_cast<AMF3_BYTEARRAY *>(a.object.get());
-						zipper.add(to_string(i) + ".png", "", Z_BEST_COMPRESSION, ba2->binaryData);
+				const auto &pngs = index.section("PNG").elements;
+				for (size_t i = 0; i < pngs.size(); ++i) {
+					pos = pngs[i].begin;
+					if (byteArrays.next(data, pos, bytes, length)) {
+						zipper.add(to_string(i) + ".png", "", Z_BEST_COMPRESSION, bytes, length);
 					}
 					// else 0x01 for null because not all limbPics have 'embeded' == true and 'disabled' == false
 
 				}
 
-				int32_t numLimb = static_cast<int32_t>(bytestodec_be<uint32_t>(data.data()+pos));
-				pos += 4;
-
-				for (int32_t i = 0; i < numLimb; ++i) {
-					AMF3 a{ data.data(), pos };
-					if (a.object->type != AMF3::BYTE_ARRAY_MARKER) {
+				const auto &limbs = index.section("Limb").elements;
+				for (size_t i = 0; i < limbs.size(); ++i) {
+					pos = limbs[i].begin;
+					if (!byteArrays.next(data, pos, bytes, length)) {
 						printf_error(io.getText("Error for data file with ID=%zu: 'Limb' is not inside an AMF3 ByteArray.\n"), t->id);
 						goto CONTINUE_FOR_EACH_ID;
 					}
-					auto ba2 = static_cast<AMF3_BYTEARRAY *>(a.object.get());
 
-					// Parse AMF0
-					AMF0 limb{ ba2->binaryData.data() };
-					string json = limb.to_json_str();
+					// AMF0 to JSON
+					const string &json = amfJson.amf0(bytes, length);
 
 					// Add JSON to zip
 					zipper.add("Limb_" + to_string(i) + ".json", "", Z_BEST_COMPRESSION, json);
@@ -729,17 +1119,14 @@ int hfw::exportData(vector<size_t> &ids) {
 				minizip::Zipper zipper(name + ".zip", globalZipComment);
 
 				// Spt
-				AMF3 a{ data.data(), pos };
-
-				if (a.object->type != AMF3::BYTE_ARRAY_MARKER) {
+				pos = index.section("Spt").elements[0].begin;
+				if (!byteArrays.next(data, pos, bytes, length)) {
 					printf_error(io.getText("Error for data file with ID=%zu: 'Spt' is not inside an AMF3 ByteArray.\n"), t->id);
 					goto CONTINUE_FOR_EACH_ID;
 				}
-				auto ba2 = static_cast<AMF3_BYTEARRAY *>(a.object.get());
 
-				// Parse AMF0
-				AMF0 spt{ ba2->binaryData.data() };
-				string json = spt.to_json_str();
+				// AMF0 to JSON
+				const string &json = amfJson.amf0(bytes, length);
 
 				// Add JSON to zip
 				zipper.add("Spt.json", "", Z_BEST_COMPRESSION, json);
@@ -749,17 +1136,14 @@ int hfw::exportData(vector<size_t> &ids) {
 				minizip::Zipper zipper(name + ".zip", globalZipComment);
 
 				// BgInfoFile
-				AMF3 a{ data.data(), pos };
-
-				if (a.object->type != AMF3::BYTE_ARRAY_MARKER) {
+				pos = index.section("BgInfoFile").elements[0].begin;
+				if (!byteArrays.next(data, pos, bytes, length)) {
 					printf_error(io.getText("Error for data file with ID=%zu: 'Bg' is not inside an AMF3 ByteArray.\n"), t->id);
 					goto CONTINUE_FOR_EACH_ID;
 				}
-				auto ba2 = static_cast<AMF3_BYTEARRAY *>(a.object.get());
 
-				// Parse AMF0
-				AMF0 bg{ ba2->binaryData.data() };
-				string json = bg.to_json_str();
+				// AMF0 to JSON
+				const string &json = amfJson.amf0(bytes, length);
 
 				// Add JSON to zip
 				zipper.add("BgInfoFile.json", "", Z_BEST_COMPRESSION, json);
@@ -768,39 +1152,31 @@ int hfw::exportData(vector<size_t> &ids) {
 
 				minizip::Zipper zipper(name + ".zip", globalZipComment);
 
-				int32_t numA = static_cast<int32_t>(bytestodec_be<uint32_t>(data.data()+pos));
-				pos += 4;
-
-				for (int32_t i = 0; i < numA; ++i) {
-					AMF3 a{ data.data(), pos };
-					if (a.object->type != AMF3::BYTE_ARRAY_MARKER) {
+				const auto &attacks = index.section("Attack").elements;
+				for (size_t i = 0; i < attacks.size(); ++i) {
+					pos = attacks[i].begin;
+					if (!byteArrays.next(data, pos, bytes, length)) {
 						printf_error(io.getText("Error for data file with ID=%zu: 'Attack' is not inside an AMF3 ByteArray.\n"), t->id);
 						goto CONTINUE_FOR_EACH_ID;
 					}
-					auto ba2 = static_cast<AMF3_BYTEARRAY *>(a.object.get());
 
-					// Parse AMF0
-					AMF0 attack{ ba2->binaryData.data() };
-					string json = attack.to_json_str();
+					// AMF0 to JSON
+					const string &json = amfJson.amf0(bytes, length);
 
 					// Add JSON to zip
 					zipper.add("Attack_" + to_string(i) + ".json", "", Z_BEST_COMPRESSION, json);
 				}
 
-				int32_t numPt = static_cast<int32_t>(bytestodec_be<uint32_t>(data.data()+pos));
-				pos += 4;
-
-				for (int32_t i = 0; i < numPt; ++i) {
-					AMF3 a{ data.data(), pos };
-					if (a.object->type != AMF3::BYTE_ARRAY_MARKER) {
+				const auto &ptWithNames = index.section("PtWithName").elements;
+				for (size_t i = 0; i < ptWithNames.size(); ++i) {
+					pos = ptWithNames[i].begin;
+					if (!byteArrays.next(data, pos, bytes, length)) {
 						printf_error(io.getText("Error for data file with ID=%zu: 'PtWithName' is not inside an AMF3 ByteArray.\n"), t->id);
 						goto CONTINUE_FOR_EACH_ID;
 					}
-					auto ba2 = static_cast<AMF3_BYTEARRAY *>(a.object.get());
 
-					// Parse AMF0
-					AMF0 ptWithName{ ba2->binaryData.data() };
-					string json = ptWithName.to_json_str();
+					// AMF0 to JSON
+					const string &json = amfJson.amf0(bytes, length);
 
 					// Add JSON to zip
 					zipper.add("PtWithName_" + to_string(i) + ".json", "", Z_BEST_COMPRESSION, json);
@@ -815,32 +1191,29 @@ int hfw::exportData(vector<size_t> &ids) {
 				 * After the file type comes the number of LimbPic objects.
 				 * A LimbPic object in HFX is serialized in AMF3 format.
 				 */
-				int32_t numLP = static_cast<int32_t>(bytestodec_be<uint32_t>(data.data()+pos));
-				pos += 4;
-
 				// LimbPic objects (JSON)
-				for (int32_t i = 0; i < numLP; ++i) {
-					string json = (AMF3{ data.data(), pos }).to_json_str();
+				const auto &limbPics = index.section("LimbPic").elements;
+				for (size_t i = 0; i < limbPics.size(); ++i) {
+					pos = limbPics[i].begin;
+					const string &json = amfJson.amf3(data.data(), data.size(), pos);
 					zipper.add("LimbPic_" + to_string(i) + ".json", "", Z_BEST_COMPRESSION, json);
 				}
 
 				// LimbPic pictures (PNG)
-				for (int32_t i = 0; i < numLP; ++i) {
-					AMF3 a{ data.data(), pos };
-
-					if (a.object->type == AMF3::BYTE_ARRAY_MARKER) {
-						auto png = static_cast<AMF3_BYTEARRAY *>(a.object.get());
-						zipper.add(to_string(i) + ".png", "", Z_BEST_COMPRESSION, png->binaryData);
+				const auto &pngs = index.section("PNG").elements;
+				for (size_t i = 0; i < pngs.size(); ++i) {
+					pos = pngs[i].begin;
+					if (byteArrays.next(data, pos, bytes, length)) {
+						zipper.add(to_string(i) + ".png", "", Z_BEST_COMPRESSION, bytes, length);
 					}
 					// else 0x01 for null because not all limbPics have 'embeded' == true and 'disabled' == false
 				}
 
-				int32_t numLimb = static_cast<int32_t>(bytestodec_be<uint32_t>(data.data()+pos));
-				pos += 4;
-
 				// Limb objects (JSON)
-				for (int32_t i = 0; i < numLimb; ++i) {
-					string json = (AMF3{ data.data(), pos }).to_json_str();
+				const auto &limbs = index.section("Limb").elements;
+				for (size_t i = 0; i < limbs.size(); ++i) {
+					pos = limbs[i].begin;
+					const string &json = amfJson.amf3(data.data(), data.size(), pos);
 					zipper.add("Limb_" + to_string(i) + ".json", "", Z_BEST_COMPRESSION, json);
 				}
 			} else if (fileType == "SptO") { // HFX
@@ -848,13 +1221,15 @@ int hfw::exportData(vector<size_t> &ids) {
 				minizip::Zipper zipper(name + ".zip", globalZipComment);
 
 				// Spt
-				string json = (AMF3{ data.data(), pos }).to_json_str();
+				pos = index.section("Spt").elements[0].begin;
+				const string &json = amfJson.amf3(data.data(), data.size(), pos);
 				zipper.add("Spt.json", "", Z_BEST_COMPRESSION, json);
 
 			} else if (fileType == "BgO") { // HFX
 
 				minizip::Zipper zipper(name + ".zip", globalZipComment);
-				string json = (AMF3{ data.data(), pos }).to_json_str();
+				pos = index.section("BgInfoFile").elements[0].begin;
+				const string &json = amfJson.amf3(data.data(), data.size(), pos);
 				zipper.add("BgInfoFile.json", "", Z_BEST_COMPRESSION, json);
 
 			} else {
@@ -867,10 +1242,14 @@ int hfw::exportData(vector<size_t> &ids) {
 			continue;
 		}
 
+		if (hash != sourceHashes.end()) {
+			manifest.set(kind, t->id, hash->second, name + ".zip");
+		}
 		++count;
 
 		CONTINUE_FOR_EACH_ID:;
 	} // for each id
+	manifest.save();
 	return count;
 }
 
@@ -888,7 +1267,7 @@ void hfw::replaceStage(const size_t id, const string &stageFileName) {
 		return;
 	}
 
-	t = static_cast<Tag_DefineBinaryData *>(swf->getTagWithId(id));
+	t = static_cast<Tag_DefineBinaryData *>(game().getTagWithId(id));
 	if (t == nullptr) {
 		printf_error(io.getText("Stage file with ID=%zu not found inside the game.\n"), id);
 		return;
@@ -906,10 +1285,18 @@ void hfw::replaceStage(const size_t id, const string &stageFileName) {
 		return;
 	}
 
+	// Stage files are UTF-8 XML, text saved in another encoding shows up garbled in the game
+	if (!isValidUtf8(stageBuf.data(), stageBuf.size())) {
+		printf_colored(rlutil::YELLOW, io.getText("WARNING: Stage file '%s' is not valid UTF-8 text.\n"), stageFileName.c_str());
+	}
+
 	printf_colored(rlutil::YELLOW, io.getText("Replacing '%s' with file '%s'...\n"), name.c_str(), stageFileName.c_str());
 
 	try {
-		swf->replaceBinary(stageBuf, id);
+		TagState before = currentTag(EditKind::stage, id);
+		game().replaceBinary(stageBuf, id);
+		tagOverrides[id] = make_shared<const vector<uint8_t>>(makeBinaryDataRecord(static_cast<uint16_t>(id), stageBuf));
+		journal.record({EditKind::stage, id, stageFileName, before, {tagOverrides[id], nullptr}});
 		unsaved = true;
 	} catch (const swf_exception &se) {
 		printf_error(se.what());
@@ -925,14 +1312,17 @@ void hfw::replaceImage(const size_t id, const string &imgFileName) {
 
 	// Get name of file we're replacing
 	string name;
-	vector<Tag *> tv = swf->getTagsOfType(SWF::tagId("DefineBitsLossless"));
-	vector<Tag *> tv1 = swf->getTagsOfType(SWF::tagId("DefineBitsLossless2"));
+	bool alpha = false;
+	vector<Tag *> tv = game().getTagsOfType(SWF::tagId("DefineBitsLossless"));
+	vector<Tag *> tv1 = game().getTagsOfType(SWF::tagId("DefineBitsLossless2"));
+	size_t losslessCount = tv.size();
 	tv.insert(tv.end(), tv1.begin(), tv1.end());
 
-	for (auto &t : tv) {
-		auto dbl = static_cast<Tag_DefineBitsLossless *>(t);
+	for (size_t i = 0; i < tv.size(); ++i) {
+		auto dbl = static_cast<Tag_DefineBitsLossless *>(tv[i]);
 		if (id == dbl->id) {
 
+			alpha = (i >= losslessCount);
 			name = dbl->symbolName;
 			if (name == "") {
 				name = to_string(dbl->id);
@@ -960,11 +1350,17 @@ void hfw::replaceImage(const size_t id, const string &imgFileName) {
 
 	printf_colored(rlutil::YELLOW, io.getText("Replacing '%s' with file '%s'...\n"), name.c_str(), imgFileName.c_str());
 
+	// The tag is built here so that the premultiplication rounds the same way as
+	// exportImages, and exporting an image and replacing it back doesn't change it
 	try {
-		swf->replaceImg(imgBuf, id);
+		vector<uint8_t> body = pngToLossless(static_cast<uint16_t>(id), imgBuf, alpha, AlphaRounding::exact);
+		TagState before = currentTag(EditKind::image, id);
+		tagOverrides[id] = make_shared<const vector<uint8_t>>(
+			makeTagRecord((alpha ? TAG_DEFINE_BITS_LOSSLESS2 : TAG_DEFINE_BITS_LOSSLESS), body));
+		journal.record({EditKind::image, id, imgFileName, before, {tagOverrides[id], nullptr}});
 		unsaved = true;
-	} catch (const swf_exception &se) {
-		printf_error(se.what());
+	} catch (const exception &e) {
+		printf_error("%s\n", e.what());
 		return;
 	}
 }
@@ -976,7 +1372,7 @@ void hfw::replaceSound(const size_t id, const string &mp3FileName) {
 
 	// Get name of file we're replacing
 	string name;
-	vector<Tag *> tv = swf->getTagsOfType(SWF::tagId("DefineSound"));
+	vector<Tag *> tv = game().getTagsOfType(SWF::tagId("DefineSound"));
 
 	for (auto &t : tv) {
 		auto ds = static_cast<Tag_DefineSound *>(t);
@@ -1015,7 +1411,11 @@ void hfw::replaceSound(const size_t id, const string &mp3FileName) {
 	printf_colored(rlutil::YELLOW, io.getText("Replacing '%s' with file '%s'...\n"), name.c_str(), mp3FileName.c_str());
 
 	try {
-		swf->replaceMp3(mp3Buf, id);
+		TagState before = currentTag(EditKind::sound, id);
+		game().replaceMp3(mp3Buf, id);
+		tagOverrides.erase(id);
+		libswfChanges = true;  // only libswf can build the tag
+		journal.record({EditKind::sound, id, mp3FileName, before, {nullptr, make_shared<const vector<uint8_t>>(move(mp3Buf))}});
 		unsaved = true;
 	} catch (const swf_exception &se) {
 		printf_error(se.what());
@@ -1034,7 +1434,7 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 		return;
 	}
 
-	Tag_DefineBinaryData * t = static_cast<Tag_DefineBinaryData *>(swf->getTagWithId(id));
+	Tag_DefineBinaryData * t = static_cast<Tag_DefineBinaryData *>(game().getTagWithId(id));
 	if (t == nullptr) {
 		printf_error(io.getText("Data file with ID=%zu not found inside the game.\n"), id);
 		return;
@@ -1069,6 +1469,7 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 		               tagName.c_str(), dataFileName.c_str());
 
 		vector<uint8_t> data;
+		JsonAmfImporter jsonAmf;
 
 		if (endsWith(tagName, "Lmi")) {
 
@@ -1123,38 +1524,38 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 			vector<bool> embeddedLPs;
 			for (auto &ze : limbPics) {
 
-				swf::json jsonObj = swf::json::parse(ze.second, nullptr, true, true);
-				bool disabled;
-				bool embedded;
 				if (this->isHFX) {
-					disabled = jsonObj["disabled"].get<bool>();
-					embedded = jsonObj["embeded"].get<bool>();
-				} else {// FIXME
-					disabled = jsonObj["disabled"].get<bool>();
-					embedded = jsonObj["embeded"].get<bool>();
+					jsonAmf.amf3(ze.second, data);
+				} else {
+					jsonAmf.amf0ByteArray(ze.second, data);
+				}
+
+				optional<bool> disabled = jsonAmf.boolean("disabled");
+				optional<bool> embedded = jsonAmf.boolean("embeded");
+				if (!disabled || !embedded) {
+					/// TRANSLATORS: 'embeded' is an intentional typo
+					printf_error(io.getText("LimbPic with ID=%d must have \"disabled\" and \"embeded\" "
+						"set to true or false.\n"), count);
+					return;
 				}
-				if (disabled == embedded) {
+				if (*disabled == *embedded) {
 					/// TRANSLATORS: 'embeded' is an intentional typo
 					printf_colored(rlutil::YELLOW, io.getText("WARNING: LimbPic with ID=%d has \"disabled\" and "
 						"\"embeded\" with the same value. This should not happen.\n"), count);
 				}
-				embeddedLPs.emplace_back(embedded);
-
-				if (this->isHFX) {
-					AMF3 limbPic{jsonObj};
-					concatVectorWithContainer(data, limbPic.serialize());
-				} else {
-					AMF0 limbPic{jsonObj};
-					auto amf0 = limbPic.serialize();
-					data.emplace_back(AMF3::BYTE_ARRAY_MARKER);
-					concatVectorWithContainer(data, AMF3::U29BAToVector(amf0.size()));
-					concatVectorWithContainer(data, amf0);
-				}
+				embeddedLPs.emplace_back(*embedded);
 
 				++count;
 			}
 
 			// PNGs
+			if (this->cmdOptions.optimizePngs) {
+				vector<vector<uint8_t> *> toOptimize;
+				for (auto &png : pngs) {
+					toOptimize.emplace_back(&png.second);
+				}
+				optimizePngs(toOptimize);
+			}
 			count = 0;
 			for(auto b : embeddedLPs) {
 				bool pngExists = (pngs.find(count) != pngs.end());
@@ -1180,16 +1581,10 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 
 			// Limbs
 			for (auto &ze : limbs) {
-				swf::json jsonObj = swf::json::parse(ze.second, nullptr, true, true);
 				if (this->isHFX) {
-					AMF3 limb{jsonObj};
-					concatVectorWithContainer(data, limb.serialize());
+					jsonAmf.amf3(ze.second, data);
 				} else {
-					AMF0 limb{jsonObj};
-					auto amf0 = limb.serialize();
-					data.emplace_back(AMF3::BYTE_ARRAY_MARKER);
-					concatVectorWithContainer(data, AMF3::U29BAToVector(amf0.size()));
-					concatVectorWithContainer(data, amf0);
+					jsonAmf.amf0ByteArray(ze.second, data);
 				}
 			}
 
@@ -1214,17 +1609,10 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 
 			string s = {unzipped_entry.begin(), unzipped_entry.end()};
 
-			swf::json jsonObj = swf::json::parse(s, nullptr, true, true);
-
 			if (this->isHFX) {
-				AMF3 spt{jsonObj};
-				concatVectorWithContainer(data, spt.serialize());
+				jsonAmf.amf3(s, data);
 			} else {
-				AMF0 spt{jsonObj};
-				auto amf0 = spt.serialize();
-				data.emplace_back(AMF3::BYTE_ARRAY_MARKER);
-				concatVectorWithContainer(data, AMF3::U29BAToVector(amf0.size()));
-				concatVectorWithContainer(data, amf0);
+				jsonAmf.amf0ByteArray(s, data);
 			}
 
 		} else if (endsWith(tagName, "Bgi")) {
@@ -1248,17 +1636,10 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 
 			string s = {unzipped_entry.begin(), unzipped_entry.end()};
 
-			swf::json jsonObj = swf::json::parse(s, nullptr, true, true);
-
 			if (this->isHFX) {
-				AMF3 bg{jsonObj};
-				concatVectorWithContainer(data, bg.serialize());
+				jsonAmf.amf3(s, data);
 			} else {
-				AMF0 bg{jsonObj};
-				auto amf0 = bg.serialize();
-				data.emplace_back(AMF3::BYTE_ARRAY_MARKER);
-				concatVectorWithContainer(data, AMF3::U29BAToVector(amf0.size()));
-				concatVectorWithContainer(data, amf0);
+				jsonAmf.amf0ByteArray(s, data);
 			}
 
 		} else if (endsWith(tagName, "Dat")) {
@@ -1303,11 +1684,7 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 
 			// Attacks
 			for (auto &ze : attacks) {
-				AMF0 attack{swf::json::parse(ze.second, nullptr, true, true)};
-				auto amf0 = attack.serialize();
-				data.emplace_back(AMF3::BYTE_ARRAY_MARKER);
-				concatVectorWithContainer(data, AMF3::U29BAToVector(amf0.size()));
-				concatVectorWithContainer(data, amf0);
+				jsonAmf.amf0ByteArray(ze.second, data);
 			}
 
 			// Num of PtWithNames
@@ -1316,11 +1693,7 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 
 			// PtWithNames
 			for (auto &ze : ptwnames) {
-				AMF0 pt{swf::json::parse(ze.second, nullptr, true, true)};
-				auto amf0 = pt.serialize();
-				data.emplace_back(AMF3::BYTE_ARRAY_MARKER);
-				concatVectorWithContainer(data, AMF3::U29BAToVector(amf0.size()));
-				concatVectorWithContainer(data, amf0);
+				jsonAmf.amf0ByteArray(ze.second, data);
 			}
 
 		} else {
@@ -1331,7 +1704,25 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 		//XXX Only for test
 		//writeBinaryFile(tagName + ".out", data);
 
-		vector<uint8_t> compressed = zlib::zlib_compress(data, Z_BEST_COMPRESSION);
+		uint64_t hash = xxh64(data);
+
+		// Nothing to do if the data file already has these contents
+		auto known = dataHashes.find(id);
+		if (known == dataHashes.end()) {
+			vector<uint8_t> current = game().exportBinary(id);
+			size_t pos = 0;
+			AMF3 amf{current.data(), pos};
+			if (amf.object->type == AMF3::BYTE_ARRAY_MARKER) {
+				auto ba = static_cast<AMF3_BYTEARRAY *>(amf.object.get());
+				known = dataHashes.emplace(id, xxh64(zlib::zlib_decompress(ba->binaryData))).first;
+			}
+		}
+		if (known != dataHashes.end() && known->second == hash) {
+			printf_normal(io.getText("'%s' is unchanged, nothing to replace.\n"), tagName.c_str());
+			return;
+		}
+
+		vector<uint8_t> compressed = compressionCache.compress(data, hash, Z_BEST_COMPRESSION);
 
 		vector<uint8_t> LMI;
 		LMI.emplace_back(AMF3::BYTE_ARRAY_MARKER);
@@ -1339,7 +1730,12 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 		concatVectorWithContainer(LMI, compressed);
 
 		try {
-			swf->replaceBinary(LMI, id);
+			TagState before = currentTag(EditKind::data, id);
+			game().replaceBinary(LMI, id);
+			tagOverrides[id] = make_shared<const vector<uint8_t>>(makeBinaryDataRecord(static_cast<uint16_t>(id), LMI));
+			journal.record({EditKind::data, id, dataFileName, before, {tagOverrides[id], nullptr}});
+			dataHashes[id] = hash;
+			queryIndex.reset();  // rebuilt by the next query
 			unsaved = true;
 		} catch (const swf_exception &se) {
 			printf_error(se.what());
@@ -1354,6 +1750,222 @@ void hfw::replaceData(const size_t id, const string &dataFileName) {
 	}
 }
 
+/**
+ * What a tag holds now, as kept in the journal: the record that replaces it,
+ * or if there's none, the tag of the game as read for a stage or data file.
+ * Sounds also keep the MP3 that libswf has, as a patch may have replaced
+ * their tag after it.
+ */
+TagState hfw::currentTag(EditKind kind, size_t id) {
+	auto it = tagOverrides.find(id);
+	SharedBytes record = (it != tagOverrides.end() ? it->second : nullptr);
+	switch (kind) {
+		case EditKind::stage:
+		case EditKind::data:
+			if (record == nullptr) {
+				record = make_shared<const vector<uint8_t>>(makeBinaryDataRecord(static_cast<uint16_t>(id), game().exportBinary(id)));
+			}
+			return {record, nullptr};
+		case EditKind::sound:
+			return {record, make_shared<const vector<uint8_t>>(game().exportMp3(id))};
+		case EditKind::image:
+		case EditKind::tag:
+		default:
+			return {record, nullptr};
+	}
+}
+
+/**
+ * Puts a state of a tag, from the journal, back into the game.
+ * Changes 'unsaved' to true.
+ */
+void hfw::applyTagState(const Edit &edit, const TagState &state) {
+	switch (edit.kind) {
+		case EditKind::stage:
+		case EditKind::data:
+			game().replaceBinary(binaryDataOfRecord(*state.record), edit.id);
+			tagOverrides[edit.id] = state.record;
+			if (edit.kind == EditKind::data) {
+				dataHashes.erase(edit.id);
+				queryIndex.reset();
+			}
+			break;
+		case EditKind::sound:
+		case EditKind::image:
+		case EditKind::tag:
+		default:
+			if (state.mp3 != nullptr) {
+				game().replaceMp3(*state.mp3, edit.id);
+				libswfChanges = true;
+			}
+			if (state.record == nullptr) {
+				tagOverrides.erase(edit.id);
+			} else {
+				tagOverrides[edit.id] = state.record;
+			}
+			break;
+	}
+	unsaved = true;
+}
+
+string hfw::describeEdit(const Edit &edit) {
+	const char *kind = "";
+	switch (edit.kind) {
+		case EditKind::stage: kind = io.getText("stage file"); break;
+		case EditKind::image: kind = io.getText("image"); break;
+		case EditKind::sound: kind = io.getText("sound"); break;
+		case EditKind::data: kind = io.getText("data file"); break;
+		case EditKind::tag: kind = io.getText("tag"); break;
+		default: break;
+	}
+	return string(kind) + " " + to_string(edit.id) + " <- " + edit.source;
+}
+
+void hfw::listEdits() {
+	const auto &edits = journal.edits();
+	if (edits.empty()) {
+		printf_normal(io.getText("No edits yet.\n"));
+		return;
+	}
+	for (size_t i = 0; i <= edits.size(); ++i) {
+		for (const auto &c : journal.checkpoints()) {
+			if (c.second == i) {
+				printf_colored(rlutil::YELLOW, io.getText("-- checkpoint '%s'\n"), c.first.c_str());
+			}
+		}
+		if (i == edits.size()) {
+			break;
+		}
+		printf_colored(rlutil::LIGHTRED, "%zu", i + 1);
+		printf_normal(": %s%s\n", describeEdit(edits[i]).c_str(), (i < journal.position() ? "" : io.getText(" (undone)")));
+	}
+}
+
+void hfw::showMenuHistory() {
+
+	auto apply = [this](const Edit &edit, const TagState &state) { applyTagState(edit, state); };
+
+	string choice2;
+	while (true) {
+
+		vector<string> options = {io.getText("List edits"), io.getText("Undo"), io.getText("Redo"),
+			io.getText("Add checkpoint"), io.getText("Roll back to checkpoint"), io.getText("Back")};
+
+		printOptions(options);
+
+		readLine(choice2);
+		try {
+			if (choice2 == "0") {
+				break;
+			} else if (choice2 == "1") {
+				listEdits();
+			} else if (choice2 == "2") {
+				size_t position = journal.position();
+				if (journal.undo(apply)) {
+					printf_colored(rlutil::YELLOW, io.getText("Undone: %s\n"), describeEdit(journal.edits()[position - 1]).c_str());
+				} else {
+					printf_error(io.getText("Nothing to undo.\n"));
+				}
+			} else if (choice2 == "3") {
+				size_t position = journal.position();
+				if (journal.redo(apply)) {
+					printf_colored(rlutil::YELLOW, io.getText("Redone: %s\n"), describeEdit(journal.edits()[position]).c_str());
+				} else {
+					printf_error(io.getText("Nothing to redo.\n"));
+				}
+			} else if (choice2 == "4") {
+				string name;
+				readLine(name, io.getText("Checkpoint name: "));
+				trim(name);
+				if (name.empty()) {
+					printf_error(io.getText("Invalid input.\n"));
+					continue;
+				}
+				journal.checkpoint(name);
+			} else if (choice2 == "5") {
+				string name;
+				readLine(name, io.getText("Checkpoint name: "));
+				trim(name);
+				if (journal.rollback(name, apply)) {
+					printf_colored(rlutil::YELLOW, io.getText("Rolled back to '%s'.\n"), name.c_str());
+				} else {
+					printf_error(io.getText("No checkpoint named '%s'.\n"), name.c_str());
+				}
+			} else {
+				printf_normal(io.getText("Invalid option.\n"));
+			}
+		} catch (const exception &e) {
+			printf_error("%s\n", e.what());
+		}
+	}
+}
+
+/**
+ * The patch has the tags that differ from the game as it was read, so it's
+ * made against the same uncompressed SWF whatever the container of the game.
+ */
+void hfw::exportPatch() {
+
+	/// TRANSLATORS: Don't change default patch name
+	string outName = askFilePathWithDefaultOption(string{io.getText("Path to output file (default=HF_mod.hfp): ")}, "HF_mod.hfp");
+
+	try {
+		vector<uint8_t> result = exportUncompressedSwf();
+		ModPatch patch = diffSwf(originalSwf(), result);
+		if (patch.tags.empty()) {
+			printf_error(io.getText("Nothing was replaced, there's nothing to export.\n"));
+			return;
+		}
+		writeBinaryFile(outName, serializePatch(patch));
+		printf_colored(rlutil::YELLOW, io.getText("Exported a patch of %zu tag(s).\n"), patch.tags.size());
+	} catch (const exception &e) {
+		printf_error("%s\n", e.what());
+	}
+}
+
+/**
+ * Replaces the tags of the patch, as edits that can be undone.
+ * Changes 'unsaved' to true in case of success.
+ */
+void hfw::applyPatch(const string &patchFileName) {
+
+	try {
+		ModPatch patch = readPatch(patchFileName);
+		const vector<uint8_t> &base = originalSwf();
+		if (base.size() != patch.baseSize || xxh64(base) != patch.baseHash) {
+			printf_error(io.getText("The patch is for another version of the game.\n"));
+			return;
+		}
+
+		bool unedited = tagOverrides.empty() && !libswfChanges;
+		for (const auto &tag : patch.tags) {
+			size_t id = tag.first;
+			uint16_t code = static_cast<uint16_t>(((*tag.second)[0] | ((*tag.second)[1] << 8)) >> 6);
+
+			EditKind kind = EditKind::tag;
+			if (code == TAG_DEFINE_BINARY_DATA && find(stages_ids.begin(), stages_ids.end(), id) != stages_ids.end()) {
+				kind = EditKind::stage;
+			} else if (code == TAG_DEFINE_BINARY_DATA && find(data_ids.begin(), data_ids.end(), id) != data_ids.end()) {
+				kind = EditKind::data;
+			} else if (code == TAG_DEFINE_BITS_LOSSLESS || code == TAG_DEFINE_BITS_LOSSLESS2) {
+				kind = EditKind::image;
+			}
+
+			Edit edit{kind, id, patchFileName, currentTag(kind, id), {tag.second, nullptr}};
+			applyTagState(edit, edit.after);
+			journal.record(edit);
+		}
+		printf_colored(rlutil::YELLOW, io.getText("Applied a patch of %zu tag(s).\n"), patch.tags.size());
+
+		// Edits made before are kept, so the result can only be checked without them
+		if (unedited && xxh64(exportUncompressedSwf()) != patch.resultHash) {
+			printf_colored(rlutil::YELLOW, io.getText("WARNING: The patched game isn't the one the patch was made from.\n"));
+		}
+	} catch (const exception &e) {
+		printf_error("%s\n", e.what());
+	}
+}
+
 swf::CompressionChoice hfw::getSWFCompressionOption() {
 	printf_colored(rlutil::YELLOW, io.getText("Compression: \n"));
 
@@ -1376,6 +1988,127 @@ swf::CompressionChoice hfw::getSWFCompressionOption() {
 	}
 }
 
+/**
+ * The game as it was read with the tags in 'tagOverrides' spliced in, so the
+ * tags that weren't replaced are copied as they are instead of being
+ * serialized again by libswf. libswf's SWF is used instead if it holds
+ * changes that aren't in 'tagOverrides'.
+ */
+vector<uint8_t> hfw::exportUncompressedSwf() {
+	if (!libswfChanges) {
+		return replaceCharacterTags(originalSwf(), tagOverrides);
+	}
+	return replaceCharacterTags(game().exportSwf(CompressionChoice::uncompressed), tagOverrides);
+}
+
+/**
+ * The game as it was read, as an uncompressed SWF. A zlib compressed game
+ * is inflated the first time, libswf can parse it as well.
+ */
+const vector<uint8_t> &hfw::originalSwf() {
+	if (swfBuffer[0] == 'C') {
+		try {
+			swfBuffer = uncompressedSwf(swfBuffer);
+		} catch (const exception &) {
+			swfBuffer = SWF(swfBuffer).exportSwf(CompressionChoice::uncompressed);
+		}
+	}
+	return swfBuffer;
+}
+
+/**
+ * Tag records of originalSwf(), from the index of the game. They are scanned
+ * again if the index has none.
+ */
+const vector<IndexedTag> &hfw::originalTags() {
+	if (swfIndex->tags.empty()) {
+		swfIndex->tags = indexSwfTags(originalSwf());
+	}
+	return swfIndex->tags;
+}
+
+/**
+ * Like exportUncompressedSwf, deflated if 'compress', but the tags are
+ * spliced in as the file is written, so the output is never all in memory.
+ */
+void hfw::writeSwfFile(const string &fileName, bool compress) {
+	FileSink file(fileName);
+	if (!libswfChanges) {
+		streamSwf(originalSwf(), tagOverrides, compress, file);
+	} else {
+		streamSwf(game().exportSwf(CompressionChoice::uncompressed), tagOverrides, compress, file);
+	}
+	file.commit(cmdOptions.syncWrites);
+}
+
+/**
+ * The tags of the game are hashed where they were read and the ones HFW
+ * replaced from 'tagOverrides', so the game isn't exported for it. The
+ * hashes are kept until the next edit.
+ */
+map<size_t, uint64_t> hfw::characterTagHashes(uint64_t seed) {
+	try {
+		if (libswfChanges) {
+			// The tags libswf changed are only in its export
+			vector<uint8_t> fws = exportUncompressedSwf();
+			return characterHashes(fws, indexSwfTags(fws), seed);
+		}
+
+		auto cached = tagHashes.find(seed);
+		if (cached != tagHashes.end() && cached->second.first == tagOverrides) {
+			return cached->second.second;
+		}
+		map<size_t, uint64_t> hashes = characterHashes(originalSwf(), originalTags(), seed);
+		if (!hashes.empty()) {
+			for (const auto &o : tagOverrides) {
+				hashes[o.first] = xxh64(o.second->data(), o.second->size(), seed);
+			}
+		}
+		tagHashes[seed] = {tagOverrides, hashes};
+		return hashes;
+	} catch (const exception &) {
+		return {};
+	}
+}
+
+/**
+ * zlib compression is done by the incremental compressor, which reuses
+ * the compressed bytes of the previous export up to the first change.
+ */
+vector<uint8_t> hfw::exportSwfBytes(CompressionChoice compression) {
+	if (compression == CompressionChoice::zlib) {
+		return cwsCompressor.compress(exportUncompressedSwf());
+	}
+	if (compression != CompressionChoice::lzma) {
+		return exportUncompressedSwf();
+	}
+	if (tagOverrides.empty()) {
+		return game().exportSwf(compression);
+	}
+	return SWF(exportUncompressedSwf()).exportSwf(compression);
+}
+
+/**
+ * 'projector' may be empty to use the one loaded with the SWF.
+ */
+vector<uint8_t> hfw::exportExeBytes(const vector<uint8_t> &projector, CompressionChoice compression) {
+	if (tagOverrides.empty()) {
+		return game().exportExe(projector, compression);
+	}
+
+	vector<uint8_t> proj = projector;
+	if (proj.empty()) {
+		// The game was read from an executable, which starts with the projector
+		optional<size_t> size = projectorSize(gameFilename);
+		if (!size) {
+			throw hfw_exception("Could not find the Flash Player projector.");
+		}
+		MappedFile exe(gameFilename);
+		proj.assign(exe.data(), exe.data() + *size);
+	}
+	return SWF(exportUncompressedSwf()).exportExe(proj, compression);
+}
+
 string hfw::askFilePathWithDefaultOption(const string & prompt, const string & defaultPath) {
 	string outName;
 	readLine(outName, prompt);
@@ -1398,8 +2131,13 @@ void hfw::exportSwf() {
 	printf_normal(io.getText("Generating SWF... Please wait.\n"));
 
 	try {
-		vector<uint8_t> bytes = swf->exportSwf(compression);
-		writeBinaryFile(outName, bytes);
+		if (compression == CompressionChoice::uncompressed ||
+		    (compression == CompressionChoice::zlib && cmdOptions.lowMemory)) {
+			writeSwfFile(outName, compression == CompressionChoice::zlib);
+		} else {
+			vector<uint8_t> bytes = exportSwfBytes(compression);
+			writeBinaryFile(outName, bytes, cmdOptions.syncWrites);
+		}
 		unsaved = false;
 	} catch (exception &e) {
 		printf_error("%s\n", e.what());
@@ -1418,7 +2156,7 @@ void hfw::exportExe() {
 	string outName = askFilePathWithDefaultOption(string{io.getText("Path to output file (default=HF_out.exe): ")}, "HF_out.exe");
 
 	string choice;
-	if (swf->hasProjector()) {
+	if (game().hasProjector()) {
 		/// TRANSLATORS: Don't change y/n options
 		readLine(choice, io.getText("You have already loaded a Flash Player SA into memory.\nWould you like to use it? [y/n] (default=y): "));
 		while (!(choice == "y" || choice == "Y" || choice == "n" || choice == "N" || choice == "")) {
@@ -1428,29 +2166,62 @@ void hfw::exportExe() {
 	}
 
 	bool windows = false;
-	vector<uint8_t> proj;
-	if (!swf->hasProjector() || choice == "n" || choice == "N") {
+	bool loadedProjector = game().hasProjector() && choice != "n" && choice != "N";
+	// File that starts with the projector, copied from it without reading it into memory
+	string projectorName;
+	size_t projectorLength = 0;
+	if (!loadedProjector) {
 		/// TRANSLATORS: Don't change default projector name
-		string projectorName = askFilePathWithDefaultOption(string{io.getText("Path to Adobe Flash Player Projector (default=SA.exe): ")}, "SA.exe");
+		projectorName = askFilePathWithDefaultOption(string{io.getText("Path to Adobe Flash Player Projector (default=SA.exe): ")}, "SA.exe");
 		// Check if Projector file exists
 		try {
-			readBinaryFile(projectorName, proj);
+			MappedFile projector(projectorName);
+			projectorLength = projector.size();
+			// The headers are at the start
+			windows = isPEfile(vector<uint8_t>(projector.data(), projector.data() + min<size_t>(projector.size(), 4096)));
 		} catch (exception &e) {
 			printf_error("%s\n", e.what());
 			return;
 		}
-
-		windows = isPEfile(proj);
 	} else {
-		windows = swf->isProjectorWindows();
+		windows = game().isProjectorWindows();
+		// The game was read from an executable, which starts with the projector
+		try {
+			optional<size_t> size = projectorSize(gameFilename);
+			if (size) {
+				projectorName = gameFilename;
+				projectorLength = *size;
+			}
+		} catch (const exception &) {}
 	}
 
+	// Writing over the file the projector is copied from would lose it
+	error_code ec;
+	bool stream = !projectorName.empty() && compression != CompressionChoice::lzma &&
+	              !fs::equivalent(fs::path(projectorName), fs::path(outName), ec);
+
 	/// TRANSLATORS: Generating EXE / ELF, leave %s as it is.
 	printf_normal(io.getText("Generating %s... Please wait.\n"), (windows ? "EXE" : "ELF"));
 
 	try {
-		vector<uint8_t> bytes = swf->exportExe(proj, compression);
-		writeBinaryFile(outName, bytes);
+		if (stream) {
+			FileSink file(outName);
+			bool compress = (compression == CompressionChoice::zlib);
+			if (!libswfChanges) {
+				streamExe(projectorName, projectorLength, originalSwf(), tagOverrides, compress, file);
+			} else {
+				streamExe(projectorName, projectorLength, game().exportSwf(CompressionChoice::uncompressed),
+				          tagOverrides, compress, file);
+			}
+			file.commit(cmdOptions.syncWrites);
+		} else {
+			vector<uint8_t> proj;
+			if (!loadedProjector) {
+				readBinaryFile(projectorName, proj);
+			}
+			vector<uint8_t> bytes = exportExeBytes(proj, compression);
+			writeBinaryFile(outName, bytes, cmdOptions.syncWrites);
+		}
 		unsaved = false;
 	} catch (exception &e) {
 		printf_error("%s\n", e.what());
@@ -1510,7 +2281,7 @@ void hfw::exportAPK() {
 			}
 		}
 
-		auto newSwf = swf->exportSwf(compression);
+		auto newSwf = exportSwfBytes(compression);
 		zipper.add(swfName, "", Z_BEST_COMPRESSION, newSwf);
 		zipper.close();
 		unzipper.close();
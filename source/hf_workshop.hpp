@@ -9,10 +9,18 @@
 #include <vector>
 #include <array>
 #include <memory>  // std::unique_ptr
+#include <map>     // std::map
+#include <optional> // std::optional
 
 #include "swf.hpp"
 #include "io_wrapper.hpp"
 #include "minizip_wrapper.hpp"
+#include "cws_compressor.hpp"
+#include "compression_cache.hpp"
+#include "data_query.hpp"
+#include "swf_index.hpp"
+#include "symbol_index.hpp"
+#include "edit_journal.hpp"
 
 namespace hf_workshop {
 
@@ -28,9 +36,26 @@ namespace hf_workshop {
 			std::string error_message;
 	};
 
+	/**
+	 * Options given on the command line.
+	 */
+	struct Options {
+		/// Re-encode PNGs that are replaced, keeping the smallest lossless result
+		bool optimizePngs = true;
+		/**
+		 * Stream zlib exports to the file instead of keeping the previous
+		 * export to recompress only what changed. On in 32-bit builds.
+		 */
+		bool lowMemory = sizeof(void *) < 8;
+		/// Wait for exported games to be on disk before reporting them written
+		bool syncWrites = false;
+	};
+
 	class hfw {
 	public:
-		hfw(const std::string & globalZipComment = "Created with HF Workshop.");
+		explicit hfw(const Options &options = Options(),
+		             const std::string & globalZipComment = "Created with HF Workshop.");
+		~hfw();
 
 		void printHeader();
 		void printHelp();
@@ -43,6 +68,7 @@ namespace hf_workshop {
 		void showMenuImages();
 		void showMenuSounds();
 		void showMenuData();
+		void showMenuHistory();
 
 		void listTagsWithIds(std::vector<size_t> ids);
 		void listTagsOfType(int id);
@@ -50,7 +76,12 @@ namespace hf_workshop {
 		int exportStages(std::vector<size_t> &ids);
 		int exportImages(std::vector<size_t> &ids);
 		int exportSounds(std::vector<size_t> &ids);
-		int exportData(std::vector<size_t> &ids);
+		// otherVersion: convert them first to the format of the other game (HF v0.7 <-> HFX)
+		int exportData(std::vector<size_t> &ids, bool otherVersion = false);
+		// Writes the elements of all the data files, column by column, for bulk analysis
+		int exportDataSnapshot(const std::string &fileName);
+		// Asks for queries over the objects of all the data files until an empty one
+		void queryData();
 
 		void replaceStage(const size_t id, const std::string &stageFileName);
 		void replaceImage(const size_t id, const std::string &imgFileName);
@@ -60,23 +91,85 @@ namespace hf_workshop {
 		void exportSwf();
 		void exportExe();
 		void exportAPK();
+		/// Writes the replaced tags as a patch for the game as it was read
+		void exportPatch();
+		void applyPatch(const std::string &patchFileName);
 
 
 	private:
+		Options cmdOptions;
 		bool unsaved;
 		bool isHFX;
 		std::string globalZipComment;
 		l18n::localization io;
-		std::unique_ptr<swf::SWF> swf;
+		std::unique_ptr<swf::SWF> swf;  // parsed by game() when opened from the index
+		/// The game as read from the file, a plain or zlib compressed SWF (see originalSwf)
+		std::vector<uint8_t> swfBuffer;
+		/// Whether libswf's SWF has changes that only libswf can serialize, so it must be exported by libswf
+		bool libswfChanges;
+		/// What was learnt from the game when it was last opened
+		std::optional<SwfIndex> swfIndex;
+		/// Symbol names of the tags, to list them by name and select them by pattern
+		SymbolIndex symbols;
 
 		std::vector<size_t> stages_ids;
 		std::vector<size_t> data_ids;
 
+		/// File the game was opened from
+		std::string gameFilename;
 		std::string apkOriginalFilename;
 
+		/// Keeps the previous zlib export so that re-exports only compress what changed
+		CwsCompressor cwsCompressor;
+
+		/// Compressed data files, keyed by the hash of their uncompressed contents
+		CompressionCache compressionCache;
+		/// ID of data file -> XXH64 of its uncompressed contents, when known
+		std::map<size_t, uint64_t> dataHashes;
+
+		/// Character ID -> tag record built by HFW that replaces the one in the game
+		std::map<size_t, SharedBytes> tagOverrides;
+		/// characterTagHashes by seed, with the 'tagOverrides' they were hashed with
+		std::map<uint64_t, std::pair<std::map<size_t, SharedBytes>, std::map<size_t, uint64_t>>> tagHashes;
+
+		/// Index of the objects of the data files, built on the first query
+		std::unique_ptr<DataQueryIndex> queryIndex;
+
+		/// Replaced tags, to undo and redo them
+		EditJournal journal;
+
+		/// IDs of the tags of a libswf type, sorted
+		std::vector<size_t> idsOfType(int type) const;
+		/**
+		 * IDs typed by the user: numbers, or comma separated names where * and
+		 * ? match any text and character, or "re:" and a regular expression
+		 * for the whole names. Names select only the IDs in `scope` (sorted).
+		 * Returns the IDs sorted, empty if the input selects nothing.
+		 */
+		std::vector<size_t> selectIds(const std::string &input, const std::vector<size_t> &scope);
+		/// Like selectIds but the input must select one ID; errors are printed
+		std::optional<size_t> selectOneId(const std::string &input, const std::vector<size_t> &scope);
 		swf::CompressionChoice getSWFCompressionOption();
+		std::vector<uint8_t> exportUncompressedSwf();
+		const std::vector<uint8_t> &originalSwf();
+		const std::vector<IndexedTag> &originalTags();
+		void writeSwfFile(const std::string &fileName, bool compress);
+		/// XXH64 of the tag of every character, as the game would be saved, by ID (see characterHashes)
+		std::map<size_t, uint64_t> characterTagHashes(uint64_t seed);
+		std::vector<uint8_t> exportSwfBytes(swf::CompressionChoice compression);
+		std::vector<uint8_t> exportExeBytes(const std::vector<uint8_t> &projector, swf::CompressionChoice compression);
 		std::string askFilePathWithDefaultOption(const std::string & prompt, const std::string & defaultPath);
 		std::string getSwfFileNameFromAPK(minizip::Unzipper &unzipper);
+		/// Parses the game, or only takes the IDs from its index if it was opened before
+		void openGame(const std::string &filename, std::vector<uint8_t> buffer);
+		/// libswf's SWF of the game, parsed on first use
+		swf::SWF &game();
+		TagState currentTag(EditKind kind, size_t id);
+		void applyTagState(const Edit &edit, const TagState &state);
+		std::string describeEdit(const Edit &edit);
+		void listEdits();
+		/// Inflates and decodes all the data files, reporting the ones that can't be
+		std::vector<DecodedDataFile> decodeDataFiles();
 	};
 
 } // hf_workshop
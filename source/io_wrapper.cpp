@@ -11,6 +11,9 @@
 #include <cerrno>       // errno
 #include <system_error> // generic_category
 #include <memory>       // unique_ptr
+#include <filesystem>   // path, exists, rename, remove, permissions, read_symlink
+#include <random>       // random_device, mt19937_64
+#include <chrono>       // steady_clock
 #include "utils.hpp"    // s2ws, ws2s
 #include "swf_utils.hpp"    // trim
 
@@ -18,6 +21,12 @@
 
 #ifdef _WIN32
 	#include <Windows.h> // GetCurrentConsoleFontEx, SetCurrentConsoleFontEx
+	#include <io.h>      // _commit, _wopen, _close
+	#include <fcntl.h>   // _O_CREAT, _O_EXCL
+	#include <sys/stat.h> // _S_IREAD, _S_IWRITE
+#else
+	#include <fcntl.h>   // posix_fallocate, open
+	#include <unistd.h>  // fdatasync, fsync, close
 #endif
 
 #ifndef NO_READLINE
@@ -296,14 +305,196 @@ namespace l18n {
 		return count;
 	}
 
-	size_t writeBinaryFile(const string &filename, const vector<uint8_t> &inBuffer) {
-		unique_file fileHandle = make_fopen(filename.c_str(), "wb");
+	size_t writeBinaryFile(const string &filename, const vector<uint8_t> &inBuffer, bool sync) {
+		AtomicFile file(filename, inBuffer.size());
 		size_t count = 0;
-		count = fwrite (inBuffer.data() , 1, inBuffer.size(), fileHandle.get());
-		if (ferror (fileHandle.get())) {
+		count = fwrite (inBuffer.data() , 1, inBuffer.size(), file.get());
+		if (count != inBuffer.size() || ferror (file.get())) {
 			throw std::runtime_error("Error writing file: fwrite");
 		}
+		file.commit(sync);
 		return count;
 	}
 
+	namespace {
+
+		filesystem::path toPath(const string &filename) {
+		#ifdef _WIN32
+			// Because of unicode file names
+			return filesystem::path(s2ws(filename));
+		#else
+			return filesystem::path(filename);
+		#endif
+		}
+
+		string fromPath(const filesystem::path &path) {
+		#ifdef _WIN32
+			return ws2s(path.wstring());
+		#else
+			return path.string();
+		#endif
+		}
+
+		/// The file a chain of symbolic links ends at, so that it's replaced instead of the links
+		filesystem::path followLinks(filesystem::path path) {
+			constexpr int MAX_LINKS = 40;
+			error_code ec;
+			for (int i = 0; i < MAX_LINKS && filesystem::is_symlink(filesystem::symlink_status(path, ec)); ++i) {
+				filesystem::path link = filesystem::read_symlink(path, ec);
+				if (ec) {
+					break;
+				}
+				path = link.is_absolute() ? link : path.parent_path() / link;
+			}
+			return path;
+		}
+
+		/**
+		 * Creates a file named `base` and a random suffix that didn't exist
+		 * yet, like mkstemp but with the permissions of a new file, and sets
+		 * `name` to its name.
+		 */
+		FILE *createTemporary(const string &base, string &name) {
+			constexpr int MAX_ATTEMPTS = 100;
+			static thread_local mt19937_64 random(random_device{}() ^
+			                                      static_cast<uint64_t>(chrono::steady_clock::now().time_since_epoch().count()));
+			for (int attempt = 1; ; ++attempt) {
+				char suffix[24];
+				snprintf(suffix, sizeof(suffix), ".%016llx.tmp", static_cast<unsigned long long>(random()));
+				name = base + suffix;
+			#ifdef _WIN32
+				int fd = _wopen(s2ws(name).c_str(), _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY, _S_IREAD | _S_IWRITE);
+			#else
+				int fd = open(name.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0666);
+			#endif
+				if (fd < 0) {
+					if (errno == EEXIST && attempt < MAX_ATTEMPTS) {
+						continue;
+					}
+					throw runtime_error(base + ": " + strerror(errno));
+				}
+			#ifdef _WIN32
+				FILE *file = _fdopen(fd, "wb");
+			#else
+				FILE *file = fdopen(fd, "wb");
+			#endif
+				if (file == nullptr) {
+					int error = errno;
+				#ifdef _WIN32
+					_close(fd);
+				#else
+					close(fd);
+				#endif
+					error_code ec;
+					filesystem::remove(toPath(name), ec);
+					throw runtime_error(base + ": " + strerror(error));
+				}
+				return file;
+			}
+		}
+
+		/**
+		 * Opening the target for writing, without truncating it, fails the
+		 * same way replacing it would, e.g. on Windows when it's an
+		 * executable that's running.
+		 */
+		void checkWritable(const string &filename) {
+			error_code ec;
+			if (!filesystem::is_regular_file(toPath(filename), ec)) {
+				return;
+			}
+			try {
+				make_fopen(filename.c_str(), "r+b");
+			} catch (const exception &e) {
+				throw runtime_error(filename + ": " + e.what() + ". Is the file open in another program?");
+			}
+		}
+
+	} // anonymous namespace
+
+	AtomicFile::AtomicFile(const string &filename, uint64_t size) : target(fromPath(followLinks(toPath(filename)))),
+	                                                             temporary(), file(nullptr) {
+		checkWritable(target);
+		file = createTemporary(target, temporary);
+		// Large writes
+		setvbuf(file, nullptr, _IOFBF, 1 << 20);
+	#ifdef __linux__
+		// In as few extents as the file system can, and no surprise when the disk is full
+		if (size > 0 && posix_fallocate(fileno(file), 0, static_cast<off_t>(size)) == ENOSPC) {
+			discard();
+			throw runtime_error(filename + ": " + strerror(ENOSPC));
+		}
+	#else
+		(void) size;
+	#endif
+	}
+
+	AtomicFile::~AtomicFile() {
+		if (file != nullptr) {
+			discard();
+		}
+	}
+
+	void AtomicFile::discard() {
+		fclose(file);
+		file = nullptr;
+		error_code ec;
+		filesystem::remove(toPath(temporary), ec);
+	}
+
+	void AtomicFile::commit(bool sync) {
+		if (fflush(file) != 0 || ferror(file)) {
+			throw runtime_error("Error writing file: fflush");
+		}
+		if (sync) {
+		#if defined(_WIN32)
+			int synced = _commit(_fileno(file));
+		#elif defined(__linux__)
+			int synced = fdatasync(fileno(file));
+		#else
+			int synced = fsync(fileno(file));
+		#endif
+			if (synced != 0) {
+				throw runtime_error(string("Error writing file: ") + strerror(errno));
+			}
+		}
+		int closed = fclose(file);
+		file = nullptr;
+		error_code ec;
+		if (closed != 0) {
+			filesystem::remove(toPath(temporary), ec);
+			throw runtime_error("Error writing file: fclose");
+		}
+
+		// The replacement keeps the permissions of the target, e.g. of an executable
+		auto status = filesystem::status(toPath(target), ec);
+		if (!ec && filesystem::exists(status)) {
+			filesystem::permissions(toPath(temporary), status.permissions(), ec);
+		}
+		filesystem::rename(toPath(temporary), toPath(target), ec);
+		if (ec) {
+			string message = target + ": " + ec.message() + ". Is the file open in another program?";
+			filesystem::remove(toPath(temporary), ec);
+			throw runtime_error(message);
+		}
+
+	#if !defined(_WIN32)
+		// The new name is only durable once the directory is
+		if (sync) {
+			string directory = toPath(target).parent_path().string();
+			int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+			if (fd < 0) {
+				throw runtime_error(string("Error writing file: ") + strerror(errno));
+			}
+			// Some file systems can't sync directories, and say so with EINVAL
+			int synced = fsync(fd);
+			int syncError = errno;
+			close(fd);
+			if (synced != 0 && syncError != EINVAL) {
+				throw runtime_error(string("Error writing file: ") + strerror(syncError));
+			}
+		}
+	#endif
+	}
+
 } // l18n
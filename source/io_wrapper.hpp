@@ -113,7 +113,51 @@ namespace l18n {
 	using unique_file = std::unique_ptr<std::FILE,file_deleter>;
 	unique_file make_fopen(const char* filename, const char* mode);
 	size_t readBinaryFile(const std::string &filename, std::vector<uint8_t> &outBuffer);
-	size_t writeBinaryFile(const std::string &filename, const std::vector<uint8_t> &inBuffer);
+
+	/**
+	 * Replaces a file with the contents of a buffer, atomically (see
+	 * AtomicFile). With `sync`, the data is on disk when it returns.
+	 */
+	size_t writeBinaryFile(const std::string &filename, const std::vector<uint8_t> &inBuffer, bool sync = false);
+
+	/**
+	 * A file written under a temporary name next to its target, and renamed
+	 * over the target on commit(), so that a crash or a full disk never
+	 * leaves the target half written. The temporary name has a random suffix
+	 * and is only used if no file has it, so other files and other writers
+	 * of the same target are left alone. If the target is a symbolic link,
+	 * the file it points to is replaced. The temporary file is removed if
+	 * it's not committed.
+	 */
+	class AtomicFile {
+	public:
+		/**
+		 * `size`, if known, is reserved on disk up front. Throws
+		 * std::runtime_error if the target exists and can't be written, such
+		 * as an executable that's running, or if there's no space for it.
+		 */
+		explicit AtomicFile(const std::string &filename, uint64_t size = 0);
+		~AtomicFile();
+
+		AtomicFile(const AtomicFile &) = delete;
+		AtomicFile &operator=(const AtomicFile &) = delete;
+
+		std::FILE *get() const { return file; }
+
+		/**
+		 * Flushes, with `sync` to the disk, and renames the file over the
+		 * target. With `sync`, the rename is also on disk on POSIX systems,
+		 * where the directory holding the file is synced after it.
+		 */
+		void commit(bool sync = false);
+
+	private:
+		std::string target;
+		std::string temporary;
+		std::FILE *file;
+
+		void discard();
+	};
 
 
 } // l18n
@@ -0,0 +1,461 @@
+/**
+ * HF Workshop - JSON to AMF
+ */
+
+#include "json_amf.hpp"
+
+#include <algorithm> // find, find_if
+#include <cstring>   // memcpy
+#include <utility>   // pair
+
+#include <json.hpp>
+
+#include "amf0.hpp"
+#include "amf3.hpp"
+#include "xxhash.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		/// Thrown by JsonAmfWriter for anything it doesn't support
+		struct Unsupported {};
+
+		constexpr long long AMF3_INT_MIN = -(1 << 28);
+		constexpr long long AMF3_INT_MAX = (1 << 28) - 1;
+		constexpr size_t AMF3_MAX_LENGTH = (1 << 28) - 1;  // of strings and arrays
+
+		namespace amf0 {
+			constexpr uint8_t NUMBER = 0x00;
+			constexpr uint8_t BOOLEAN = 0x01;
+			constexpr uint8_t STRING = 0x02;
+			constexpr uint8_t OBJECT = 0x03;
+			constexpr uint8_t NULL_MARKER = 0x05;
+			constexpr uint8_t OBJECT_END = 0x09;
+			constexpr uint8_t STRICT_ARRAY = 0x0A;
+			constexpr uint8_t LONG_STRING = 0x0C;
+		}
+
+		namespace amf3 {
+			constexpr uint8_t NULL_MARKER = 0x01;
+			constexpr uint8_t FALSE_MARKER = 0x02;
+			constexpr uint8_t TRUE_MARKER = 0x03;
+			constexpr uint8_t INTEGER = 0x04;
+			constexpr uint8_t DOUBLE = 0x05;
+			constexpr uint8_t STRING = 0x06;
+			constexpr uint8_t ARRAY = 0x09;
+			constexpr uint8_t OBJECT = 0x0A;
+
+			constexpr uint8_t EMPTY_STRING = 0x01;
+			constexpr uint8_t DYNAMIC_TRAITS = 0x0B;  // inline, dynamic, no sealed members
+			constexpr uint8_t TRAITS_REFERENCE = 0x01;  // to the first traits
+		}
+
+		/// Writes `n` as a U29 to `buf`, returning the number of bytes
+		size_t encodeU29(uint32_t n, uint8_t *buf) {
+			if (n < 0x80) {
+				buf[0] = static_cast<uint8_t>(n);
+				return 1;
+			} else if (n < 0x4000) {
+				buf[0] = static_cast<uint8_t>((n >> 7) | 0x80);
+				buf[1] = static_cast<uint8_t>(n & 0x7F);
+				return 2;
+			} else if (n < 0x200000) {
+				buf[0] = static_cast<uint8_t>((n >> 14) | 0x80);
+				buf[1] = static_cast<uint8_t>(((n >> 7) & 0x7F) | 0x80);
+				buf[2] = static_cast<uint8_t>(n & 0x7F);
+				return 3;
+			} else {
+				buf[0] = static_cast<uint8_t>((n >> 22) | 0x80);
+				buf[1] = static_cast<uint8_t>(((n >> 15) & 0x7F) | 0x80);
+				buf[2] = static_cast<uint8_t>(((n >> 8) & 0x7F) | 0x80);
+				buf[3] = static_cast<uint8_t>(n);
+				return 4;
+			}
+		}
+
+		void writeU16(vector<uint8_t> &out, size_t n) {
+			out.emplace_back(static_cast<uint8_t>(n >> 8));
+			out.emplace_back(static_cast<uint8_t>(n));
+		}
+
+		void writeU32(uint8_t *p, size_t n) {
+			p[0] = static_cast<uint8_t>(n >> 24);
+			p[1] = static_cast<uint8_t>(n >> 16);
+			p[2] = static_cast<uint8_t>(n >> 8);
+			p[3] = static_cast<uint8_t>(n);
+		}
+
+		void writeBytes(vector<uint8_t> &out, string_view s) {
+			const auto *p = reinterpret_cast<const uint8_t *>(s.data());
+			out.insert(out.end(), p, p + s.size());
+		}
+
+		/**
+		 * Parses JSON the way replaceData always did, keeping the top-level
+		 * boolean members.
+		 */
+		swf::json parseJson(const string &text, vector<pair<string, bool>> &booleans) {
+			swf::json j = swf::json::parse(text, nullptr, true, true);
+			booleans.clear();
+			if (j.is_object()) {
+				for (auto &item : j.items()) {
+					if (item.value().is_boolean()) {
+						booleans.emplace_back(item.key(), item.value().get<bool>());
+					}
+				}
+			}
+			return j;
+		}
+
+	} // anonymous namespace
+
+	/**
+	 * Receives the tokens of the JSON parser and passes them to the writer.
+	 */
+	class JsonAmfWriter::Sax {
+	public:
+		explicit Sax(JsonAmfWriter &_writer) : writer(_writer) {}
+
+		bool null() {
+			writer.nullValue();
+			return true;
+		}
+
+		bool boolean(bool b) {
+			writer.booleanValue(b);
+			return true;
+		}
+
+		bool number_integer(swf::json::number_integer_t n) {
+			writer.integerValue(n);
+			return true;
+		}
+
+		bool number_unsigned(swf::json::number_unsigned_t n) {
+			if (n <= static_cast<swf::json::number_unsigned_t>(AMF3_INT_MAX)) {
+				writer.integerValue(static_cast<long long>(n));
+			} else {
+				// Too large for the integer marker anyway
+				writer.numberValue(static_cast<double>(n));
+			}
+			return true;
+		}
+
+		bool number_float(swf::json::number_float_t d, const swf::json::string_t &) {
+			writer.numberValue(d);
+			return true;
+		}
+
+		bool string(swf::json::string_t &s) {
+			writer.stringValue(s);
+			return true;
+		}
+
+		bool binary(swf::json::binary_t &) {
+			throw Unsupported();
+		}
+
+		bool start_object(size_t) {
+			writer.startObject();
+			return true;
+		}
+
+		bool key(swf::json::string_t &k) {
+			writer.key(k);
+			return true;
+		}
+
+		bool end_object() {
+			writer.endObject();
+			return true;
+		}
+
+		bool start_array(size_t) {
+			writer.startArray();
+			return true;
+		}
+
+		bool end_array() {
+			writer.endArray();
+			return true;
+		}
+
+		bool parse_error(size_t, const std::string &, const swf::json::exception &) {
+			return false;
+		}
+
+	private:
+		JsonAmfWriter &writer;
+	};
+
+	JsonAmfWriter::JsonAmfWriter() : isAmf3(false), out(nullptr), containers(), keys(),
+	                                 topLevelKey(), booleans(), strings(), traitsWritten(false) {}
+
+	JsonAmfWriter::~JsonAmfWriter() = default;
+
+	bool JsonAmfWriter::writeAmf0(const std::string &json, vector<uint8_t> &_out) {
+		isAmf3 = false;
+		return write(json, _out);
+	}
+
+	bool JsonAmfWriter::writeAmf3(const std::string &json, vector<uint8_t> &_out) {
+		isAmf3 = true;
+		return write(json, _out);
+	}
+
+	bool JsonAmfWriter::write(const std::string &json, vector<uint8_t> &_out) {
+		out = &_out;
+		size_t start = out->size();
+
+		// The tables keep their memory from one value to the next
+		containers.clear();
+		keys.clear();
+		booleans.clear();
+		strings.clear();
+		traitsWritten = false;
+
+		bool ok;
+		try {
+			Sax sax(*this);
+			ok = swf::json::sax_parse(json, &sax, swf::json::input_format_t::json, true, true);
+		} catch (const Unsupported &) {
+			ok = false;
+		}
+		if (!ok || !containers.empty()) {
+			out->resize(start);
+			return false;
+		}
+		return true;
+	}
+
+	/// Counts a value in the array holding it
+	void JsonAmfWriter::element() {
+		if (!containers.empty() && !containers.back().object) {
+			++containers.back().count;
+		}
+	}
+
+	void JsonAmfWriter::nullValue() {
+		element();
+		out->emplace_back(isAmf3 ? amf3::NULL_MARKER : amf0::NULL_MARKER);
+	}
+
+	void JsonAmfWriter::booleanValue(bool b) {
+		element();
+		if (containers.size() == 1 && containers.back().object) {
+			booleans.emplace_back(topLevelKey, b);
+		}
+		if (isAmf3) {
+			out->emplace_back(b ? amf3::TRUE_MARKER : amf3::FALSE_MARKER);
+		} else {
+			out->emplace_back(amf0::BOOLEAN);
+			out->emplace_back(b ? 1 : 0);
+		}
+	}
+
+	void JsonAmfWriter::integerValue(long long n) {
+		if (isAmf3 && n >= AMF3_INT_MIN && n <= AMF3_INT_MAX) {
+			element();
+			out->emplace_back(amf3::INTEGER);
+			writeU29(static_cast<uint32_t>(n) & 0x1FFFFFFF);
+			return;
+		}
+		numberValue(static_cast<double>(n));
+	}
+
+	void JsonAmfWriter::numberValue(double d) {
+		element();
+		out->emplace_back(isAmf3 ? amf3::DOUBLE : amf0::NUMBER);
+		writeDouble(d);
+	}
+
+	void JsonAmfWriter::stringValue(string_view s) {
+		element();
+		if (isAmf3) {
+			out->emplace_back(amf3::STRING);
+			writeAmf3String(s);
+		} else if (s.size() <= 0xFFFF) {
+			out->emplace_back(amf0::STRING);
+			writeU16(*out, s.size());
+			writeBytes(*out, s);
+		} else {
+			if (s.size() > 0xFFFFFFFF) {
+				throw Unsupported();
+			}
+			out->emplace_back(amf0::LONG_STRING);
+			out->resize(out->size() + 4);
+			writeU32(out->data() + out->size() - 4, s.size());
+			writeBytes(*out, s);
+		}
+	}
+
+	/*
+	 * The number of elements comes first, so the array header is written
+	 * when the array ends.
+	 */
+	void JsonAmfWriter::startArray() {
+		element();
+		if (isAmf3) {
+			out->emplace_back(amf3::ARRAY);
+			containers.push_back({out->size(), 0, 0, false});
+			out->emplace_back(0);  // count, usually a single byte
+			out->emplace_back(amf3::EMPTY_STRING);  // no associative part
+		} else {
+			out->emplace_back(amf0::STRICT_ARRAY);
+			containers.push_back({out->size(), 0, 0, false});
+			out->resize(out->size() + 4);
+		}
+	}
+
+	void JsonAmfWriter::endArray() {
+		Container c = containers.back();
+		containers.pop_back();
+		if (isAmf3) {
+			if (c.count > AMF3_MAX_LENGTH) {
+				throw Unsupported();
+			}
+			uint8_t buf[4];
+			size_t len = encodeU29(static_cast<uint32_t>((c.count << 1) | 1), buf);
+			(*out)[c.header] = buf[0];
+			out->insert(out->begin() + static_cast<ptrdiff_t>(c.header) + 1, buf + 1, buf + len);
+		} else {
+			if (c.count > 0xFFFFFFFF) {
+				throw Unsupported();
+			}
+			writeU32(out->data() + c.header, c.count);
+		}
+	}
+
+	void JsonAmfWriter::startObject() {
+		element();
+		if (isAmf3) {
+			out->emplace_back(amf3::OBJECT);
+			if (traitsWritten) {
+				out->emplace_back(amf3::TRAITS_REFERENCE);
+			} else {
+				out->emplace_back(amf3::DYNAMIC_TRAITS);
+				out->emplace_back(amf3::EMPTY_STRING);  // anonymous
+				traitsWritten = true;
+			}
+		} else {
+			out->emplace_back(amf0::OBJECT);
+		}
+		containers.push_back({0, 0, keys.size(), true});
+	}
+
+	void JsonAmfWriter::key(string_view k) {
+		// An empty key would end the object
+		if (k.empty() || (!isAmf3 && k.size() > 0xFFFF)) {
+			throw Unsupported();
+		}
+
+		// libswf keeps the last value of a repeated key in the place of the first,
+		// which can't be done while streaming. Keys that merely share a hash are
+		// left to libswf as well.
+		uint64_t hash = xxh64(k.data(), k.size());
+		auto first = keys.begin() + static_cast<ptrdiff_t>(containers.back().firstKey);
+		if (find(first, keys.end(), hash) != keys.end()) {
+			throw Unsupported();
+		}
+		keys.emplace_back(hash);
+
+		if (containers.size() == 1) {
+			topLevelKey.assign(k);
+		}
+		if (isAmf3) {
+			writeAmf3String(k);
+		} else {
+			writeU16(*out, k.size());
+			writeBytes(*out, k);
+		}
+	}
+
+	void JsonAmfWriter::endObject() {
+		keys.resize(containers.back().firstKey);
+		containers.pop_back();
+		if (isAmf3) {
+			out->emplace_back(amf3::EMPTY_STRING);
+		} else {
+			out->emplace_back(0);
+			out->emplace_back(0);
+			out->emplace_back(amf0::OBJECT_END);
+		}
+	}
+
+	void JsonAmfWriter::writeDouble(double d) {
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof(bits));
+		for (int shift = 56; shift >= 0; shift -= 8) {
+			out->emplace_back(static_cast<uint8_t>(bits >> shift));
+		}
+	}
+
+	void JsonAmfWriter::writeU29(uint32_t n) {
+		uint8_t buf[4];
+		size_t len = encodeU29(n, buf);
+		out->insert(out->end(), buf, buf + len);
+	}
+
+	void JsonAmfWriter::writeAmf3String(string_view s) {
+		// The empty string is never sent by reference
+		if (s.empty()) {
+			out->emplace_back(amf3::EMPTY_STRING);
+			return;
+		}
+		if (s.size() > AMF3_MAX_LENGTH) {
+			throw Unsupported();
+		}
+		if (strings.size() >= AMF3_MAX_LENGTH) {
+			throw Unsupported();
+		}
+		uint32_t index = strings.findOrAdd(s);
+		if (index != AmfStringTable::NOT_FOUND) {
+			writeU29(index << 1);
+			return;
+		}
+		writeU29(static_cast<uint32_t>((s.size() << 1) | 1));
+		writeBytes(*out, s);
+	}
+
+	JsonAmfImporter::~JsonAmfImporter() = default;
+
+	void JsonAmfImporter::amf0ByteArray(const std::string &json, vector<uint8_t> &out) {
+		amf0Out.clear();
+		if (writer.writeAmf0(json, amf0Out)) {
+			booleans = writer.topLevelBooleans();
+		} else {
+			swf::json jsonObj = parseJson(json, booleans);
+			amf0Out = swf::AMF0{jsonObj}.serialize();
+		}
+
+		out.emplace_back(swf::AMF3::BYTE_ARRAY_MARKER);
+		vector<uint8_t> length = swf::AMF3::U29BAToVector(amf0Out.size());
+		out.insert(out.end(), length.begin(), length.end());
+		out.insert(out.end(), amf0Out.begin(), amf0Out.end());
+	}
+
+	void JsonAmfImporter::amf3(const std::string &json, vector<uint8_t> &out) {
+		if (writer.writeAmf3(json, out)) {
+			booleans = writer.topLevelBooleans();
+			return;
+		}
+
+		swf::json jsonObj = parseJson(json, booleans);
+		vector<uint8_t> serialized = swf::AMF3{jsonObj}.serialize();
+		out.insert(out.end(), serialized.begin(), serialized.end());
+	}
+
+	optional<bool> JsonAmfImporter::boolean(string_view key) const {
+		auto it = find_if(booleans.begin(), booleans.end(), [&](const pair<std::string, bool> &b) {
+			return b.first == key;
+		});
+		if (it == booleans.end()) {
+			return nullopt;
+		}
+		return it->second;
+	}
+
+} // hf_workshop
@@ -0,0 +1,131 @@
+/**
+ * HF Workshop - JSON to AMF
+ *
+ * Writes serialized AMF0 and AMF3 values straight from JSON text, without
+ * building a JSON document or an AMF object tree first.
+ */
+
+#ifndef JSON_AMF_HPP
+#define JSON_AMF_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>  // pair
+#include <optional>
+#include <cstdint>  // uint8_t, uint32_t, uint64_t
+#include <cstddef>  // size_t
+
+#include "amf_references.hpp"
+
+namespace hf_workshop {
+
+	/**
+	 * Streaming writer, fed by the SAX interface of the JSON parser. Objects are
+	 * written as anonymous objects (dynamic ones in AMF3) and arrays as dense
+	 * arrays. Objects with an empty or repeated key make it give up, so that
+	 * the caller can use libswf instead.
+	 *
+	 * AMF3 is written the way the game's ByteArray.writeObject() writes its
+	 * data files, which is what exportData gives back as JSON: numbers
+	 * written without a fraction or exponent that fit in 29 bits use the
+	 * integer marker and the rest are doubles, repeated strings are sent by
+	 * reference, and the objects after the first one refer to its traits.
+	 * Objects and arrays are never sent by reference, as JSON can't tell an
+	 * object that's there twice from two equal ones. AMF0 numbers are always
+	 * doubles.
+	 */
+	class JsonAmfWriter {
+	public:
+		JsonAmfWriter();
+		JsonAmfWriter(const JsonAmfWriter &) = delete;
+		JsonAmfWriter &operator=(const JsonAmfWriter &) = delete;
+		~JsonAmfWriter();
+
+		/**
+		 * Appends the AMF0 serialization of `json` to `out`. Returns false,
+		 * leaving `out` unchanged, if the text is invalid or has anything
+		 * unsupported.
+		 */
+		bool writeAmf0(const std::string &json, std::vector<uint8_t> &out);
+
+		/**
+		 * Appends the AMF3 serialization of `json` to `out`. Returns false,
+		 * leaving `out` unchanged, if the text is invalid or has anything
+		 * unsupported.
+		 */
+		bool writeAmf3(const std::string &json, std::vector<uint8_t> &out);
+
+		/// Boolean members of the last top-level object written
+		const std::vector<std::pair<std::string, bool>> &topLevelBooleans() const { return booleans; }
+
+	private:
+		class Sax;
+
+		/// An array or object being written
+		struct Container {
+			size_t header;    // position of the AMF3 array count or the AMF0 array count
+			size_t count;     // elements so far
+			size_t firstKey;  // index in 'keys' of the first key of an object
+			bool object;
+		};
+
+		bool isAmf3;
+		std::vector<uint8_t> *out;
+
+		std::vector<Container> containers;
+		std::vector<uint64_t> keys;  // hashes of the keys of the open objects
+		std::string topLevelKey;
+		std::vector<std::pair<std::string, bool>> booleans;
+
+		// AMF3 reference tables
+		AmfStringTable strings;
+		bool traitsWritten;
+
+		bool write(const std::string &json, std::vector<uint8_t> &out);
+
+		void element();
+		void nullValue();
+		void booleanValue(bool b);
+		void integerValue(long long n);
+		void numberValue(double d);
+		void stringValue(std::string_view s);
+		void startArray();
+		void endArray();
+		void startObject();
+		void key(std::string_view k);
+		void endObject();
+
+		void writeDouble(double d);
+		void writeU29(uint32_t n);
+		void writeAmf3String(std::string_view s);
+	};
+
+	/**
+	 * JSON to AMF for replaceData: the JsonAmfWriter, and libswf's
+	 * serialize() for the text the writer doesn't support, which also
+	 * reports the errors in invalid JSON.
+	 */
+	class JsonAmfImporter {
+	public:
+		JsonAmfImporter() : writer(), amf0Out(), booleans() {}
+		~JsonAmfImporter();
+
+		/// Appends an AMF3 byte array holding the AMF0 serialization of `json` to `out`
+		void amf0ByteArray(const std::string &json, std::vector<uint8_t> &out);
+
+		/// Appends the AMF3 serialization of `json` to `out`
+		void amf3(const std::string &json, std::vector<uint8_t> &out);
+
+		/// Top-level boolean member `key` of the last JSON converted, if there is one
+		std::optional<bool> boolean(std::string_view key) const;
+
+	private:
+		JsonAmfWriter writer;
+		std::vector<uint8_t> amf0Out;
+		std::vector<std::pair<std::string, bool>> booleans;
+	};
+
+} // hf_workshop
+
+#endif // JSON_AMF_HPP
@@ -0,0 +1,308 @@
+/**
+ * HF Workshop - Lossless bitmap tags
+ */
+
+#include "lossless_bitmap.hpp"
+#include "png_optimizer.hpp" // PngZlibSettings, pngZlibCompress
+
+#include <cstring>   // memcpy
+#include <limits>    // numeric_limits
+#include <memory>    // unique_ptr
+#include <stdexcept> // runtime_error
+#include <string>
+
+#include <zlib.h>
+#include <lodepng/lodepng.h>
+
+#include "zlib_wrapper.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		constexpr uint8_t FORMAT_COLORMAPPED = 3;
+		constexpr uint8_t FORMAT_15_BIT = 4;
+		constexpr uint8_t FORMAT_32_BIT = 5;
+
+		inline uint16_t readU16(const uint8_t *p) {
+			return static_cast<uint16_t>(p[0] | (p[1] << 8));
+		}
+
+		inline void writeU16(vector<uint8_t> &v, uint32_t n) {
+			v.emplace_back(static_cast<uint8_t>(n));
+			v.emplace_back(static_cast<uint8_t>(n >> 8));
+		}
+
+		/**
+		 * Inflates the first `expected` bytes of the bitmap data, which is
+		 * all of it for a well formed tag. The size is known from the header,
+		 * so the output buffer is allocated once.
+		 */
+		vector<uint8_t> inflateBitmap(const uint8_t *data, size_t size, size_t expected) {
+			if (size > numeric_limits<uInt>::max() || expected > numeric_limits<uInt>::max()) {
+				throw runtime_error("Bitmap is too large.");
+			}
+
+			vector<uint8_t> out(expected);
+			z_stream strm{};
+			if (inflateInit(&strm) != Z_OK) {
+				throw runtime_error("Could not initialize zlib.");
+			}
+			strm.next_in = const_cast<Bytef *>(data);
+			strm.avail_in = static_cast<uInt>(size);
+			strm.next_out = out.data();
+			strm.avail_out = static_cast<uInt>(expected);
+			int ret = inflate(&strm, Z_FINISH);
+			bool full = (strm.avail_out == 0);
+			inflateEnd(&strm);
+
+			if (!full || (ret != Z_STREAM_END && ret != Z_OK && ret != Z_BUF_ERROR)) {
+				throw runtime_error("Bitmap data is truncated or corrupted.");
+			}
+			return out;
+		}
+
+		inline uint8_t expand5To8(uint32_t v) {
+			return static_cast<uint8_t>((v << 3) | (v >> 2));
+		}
+
+		/**
+		 * Finds the distinct colors of an image, giving up after 256.
+		 * Open addressing with 4 slots per possible color keeps the scan to
+		 * one multiplication and usually one probe per pixel.
+		 */
+		class PaletteBuilder {
+		public:
+			PaletteBuilder() : colors(), keys(), slots() {}
+
+			/**
+			 * Fills `indices` with the index of every pixel in the palette.
+			 * Returns false if there are more than 256 colors.
+			 */
+			bool build(const uint8_t *pixels, size_t count, vector<uint8_t> &indices) {
+				indices.resize(count);
+				uint32_t last = 0;
+				uint8_t lastIndex = 0;
+				for (size_t i = 0; i < count; ++i) {
+					uint32_t c;
+					memcpy(&c, pixels + 4 * i, 4);
+					// Neighbouring pixels often share the same color
+					if (i > 0 && c == last) {
+						indices[i] = lastIndex;
+						continue;
+					}
+					int index = find(c);
+					if (index < 0) {
+						return false;
+					}
+					last = c;
+					lastIndex = static_cast<uint8_t>(index);
+					indices[i] = lastIndex;
+				}
+				return true;
+			}
+
+			/// Colors in the order they first appear, as 4 bytes in memory order
+			vector<uint32_t> colors;
+
+		private:
+			static constexpr size_t SLOTS = 1024;
+
+			uint32_t keys[SLOTS];
+			uint16_t slots[SLOTS]; // index in 'colors' + 1, 0 if empty
+
+			int find(uint32_t c) {
+				size_t slot = (c * 0x9E3779B1u) >> 22;
+				while (slots[slot] != 0) {
+					if (keys[slot] == c) {
+						return slots[slot] - 1;
+					}
+					slot = (slot + 1) & (SLOTS - 1);
+				}
+				if (colors.size() == 256) {
+					return -1;
+				}
+				colors.emplace_back(c);
+				keys[slot] = c;
+				slots[slot] = static_cast<uint16_t>(colors.size());
+				return static_cast<int>(colors.size() - 1);
+			}
+		};
+
+		/**
+		 * Colormapped bitmap data: the color table (RGB, or premultiplied RGBA
+		 * with alpha) followed by the indices, each row padded to 4 bytes.
+		 */
+		vector<uint8_t> colormappedData(const vector<uint32_t> &colors, const vector<uint8_t> &indices,
+		                                size_t w, size_t h, bool alpha) {
+			size_t entryBytes = alpha ? 4 : 3;
+			size_t rowBytes = (w + 3) & ~static_cast<size_t>(3);
+
+			vector<uint8_t> data(colors.size() * entryBytes + rowBytes * h, 0);
+			uint8_t *out = data.data();
+			for (uint32_t c : colors) {
+				uint8_t argb[4];
+				memcpy(argb, &c, 4);
+				memcpy(out, argb + 1, 3);
+				if (alpha) {
+					out[3] = argb[0];
+				}
+				out += entryBytes;
+			}
+			for (size_t y = 0; y < h; ++y, out += rowBytes) {
+				memcpy(out, indices.data() + y * w, w);
+			}
+			return data;
+		}
+
+	} // anonymous namespace
+
+	vector<uint8_t> losslessToPng(const uint8_t *body, size_t size, bool alpha, AlphaRounding rounding) {
+
+		if (size < 7) {
+			throw runtime_error("Bitmap tag is too short.");
+		}
+		uint8_t format = body[2];
+		size_t w = readU16(body + 3);
+		size_t h = readU16(body + 5);
+		if (w == 0 || h == 0) {
+			throw runtime_error("Bitmap has no pixels.");
+		}
+
+		vector<uint8_t> rgba(w * h * 4);
+
+		switch (format) {
+			case FORMAT_COLORMAPPED: {
+				if (size < 8) {
+					throw runtime_error("Bitmap tag is too short.");
+				}
+				size_t colors = static_cast<size_t>(body[7]) + 1;
+				size_t entryBytes = alpha ? 4 : 3;
+				size_t rowBytes = (w + 3) & ~static_cast<size_t>(3);
+				vector<uint8_t> data = inflateBitmap(body + 8, size - 8, colors * entryBytes + rowBytes * h);
+
+				// Indices past the end of the table are transparent
+				uint8_t table[256 * 4] = {};
+				for (size_t i = 0; i < colors; ++i) {
+					memcpy(table + 4 * i, data.data() + entryBytes * i, entryBytes);
+					if (!alpha) {
+						table[4 * i + 3] = 255;
+					}
+				}
+				if (alpha) {
+					// The table is premultiplied RGBA
+					rgbaToArgb(table, table, colors);
+					unpremultiplyArgbToRgba(table, table, colors, rounding);
+				}
+
+				const uint8_t *indices = data.data() + colors * entryBytes;
+				uint8_t *out = rgba.data();
+				for (size_t y = 0; y < h; ++y) {
+					const uint8_t *row = indices + y * rowBytes;
+					for (size_t x = 0; x < w; ++x, out += 4) {
+						memcpy(out, table + 4 * row[x], 4);
+					}
+				}
+				break;
+			}
+			case FORMAT_15_BIT: {
+				if (alpha) {
+					throw runtime_error("Unsupported bitmap format " + to_string(format) + ".");
+				}
+				size_t rowBytes = (w * 2 + 3) & ~static_cast<size_t>(3);
+				vector<uint8_t> data = inflateBitmap(body + 7, size - 7, rowBytes * h);
+
+				uint8_t *out = rgba.data();
+				for (size_t y = 0; y < h; ++y) {
+					const uint8_t *row = data.data() + y * rowBytes;
+					for (size_t x = 0; x < w; ++x, out += 4) {
+						uint32_t v = static_cast<uint32_t>((row[2 * x] << 8) | row[2 * x + 1]);
+						out[0] = expand5To8((v >> 10) & 0x1F);
+						out[1] = expand5To8((v >> 5) & 0x1F);
+						out[2] = expand5To8(v & 0x1F);
+						out[3] = 255;
+					}
+				}
+				break;
+			}
+			case FORMAT_32_BIT: {
+				vector<uint8_t> data = inflateBitmap(body + 7, size - 7, w * h * 4);
+				if (alpha) {
+					unpremultiplyArgbToRgba(data.data(), rgba.data(), w * h, rounding);
+				} else {
+					// The first byte is reserved
+					argbToRgba(data.data(), rgba.data(), w * h);
+					for (size_t i = 3; i < rgba.size(); i += 4) {
+						rgba[i] = 255;
+					}
+				}
+				break;
+			}
+			default:
+				throw runtime_error("Unsupported bitmap format " + to_string(format) + ".");
+		}
+
+		lodepng::State state;
+		PngZlibSettings zlibSettings{Z_DEFAULT_COMPRESSION, Z_DEFAULT_STRATEGY};
+		state.encoder.zlibsettings.custom_zlib = pngZlibCompress;
+		state.encoder.zlibsettings.custom_context = &zlibSettings;
+
+		vector<uint8_t> png;
+		unsigned error = lodepng::encode(png, rgba, static_cast<unsigned>(w), static_cast<unsigned>(h), state);
+		if (error != 0) {
+			throw runtime_error(lodepng_error_text(error));
+		}
+		return png;
+	}
+
+	vector<uint8_t> pngToLossless(uint16_t id, const vector<uint8_t> &png, bool alpha, AlphaRounding rounding) {
+
+		vector<uint8_t> pixels;
+		unsigned w = 0, h = 0;
+		unsigned error = lodepng::decode(pixels, w, h, png);
+		if (error != 0) {
+			throw runtime_error(string("Could not decode PNG file: ") + lodepng_error_text(error));
+		}
+		if (w == 0 || h == 0 || w > 0xFFFF || h > 0xFFFF) {
+			throw runtime_error("Image width and height must be between 1 and 65535.");
+		}
+
+		size_t count = static_cast<size_t>(w) * h;
+		if (alpha) {
+			premultiplyRgbaToArgb(pixels.data(), pixels.data(), count, rounding);
+		} else {
+			rgbaToArgb(pixels.data(), pixels.data(), count);
+			for (size_t i = 0; i < pixels.size(); i += 4) {
+				pixels[i] = 0; // reserved
+			}
+		}
+
+		// Images with few colors are stored with a color table and 8 bit indices,
+		// a quarter of the data to compress and for the player to inflate
+		auto palette = make_unique<PaletteBuilder>();
+		vector<uint8_t> indices;
+		bool colormapped = palette->build(pixels.data(), count, indices);
+
+		vector<uint8_t> compressed;
+		if (colormapped) {
+			compressed = zlib::zlib_compress(colormappedData(palette->colors, indices, w, h, alpha), Z_BEST_COMPRESSION);
+		} else {
+			compressed = zlib::zlib_compress(pixels, Z_BEST_COMPRESSION);
+		}
+
+		vector<uint8_t> body;
+		body.reserve(8 + compressed.size());
+		writeU16(body, id);
+		body.emplace_back(colormapped ? FORMAT_COLORMAPPED : FORMAT_32_BIT);
+		writeU16(body, w);
+		writeU16(body, h);
+		if (colormapped) {
+			body.emplace_back(static_cast<uint8_t>(palette->colors.size() - 1));
+		}
+		body.insert(body.end(), compressed.begin(), compressed.end());
+		return body;
+	}
+
+} // hf_workshop
@@ -0,0 +1,40 @@
+/**
+ * HF Workshop - Lossless bitmap tags
+ *
+ * Conversion between PNG files and the bodies of DefineBitsLossless and
+ * DefineBitsLossless2 tags.
+ */
+
+#ifndef LOSSLESS_BITMAP_HPP
+#define LOSSLESS_BITMAP_HPP
+
+#include <vector>
+#include <cstdint> // uint8_t, uint16_t
+#include <cstddef> // size_t
+
+#include "pixels.hpp"
+
+namespace hf_workshop {
+
+	constexpr uint16_t TAG_DEFINE_BITS_LOSSLESS = 20;
+	constexpr uint16_t TAG_DEFINE_BITS_LOSSLESS2 = 36;
+
+	/**
+	 * Decodes the body of a DefineBitsLossless (`alpha` false) or
+	 * DefineBitsLossless2 (`alpha` true) tag to a PNG file. The colormapped,
+	 * 15 bit and 32 bit formats are supported.
+	 * Throws std::runtime_error if the tag is malformed.
+	 */
+	std::vector<uint8_t> losslessToPng(const uint8_t *body, size_t size, bool alpha, AlphaRounding rounding);
+
+	/**
+	 * Builds the body of a DefineBitsLossless or DefineBitsLossless2 tag
+	 * defining character `id` with the image of a PNG file. Images with up to
+	 * 256 colors are stored in the colormapped format, others in the 32 bit format.
+	 * Throws std::runtime_error if the PNG file can't be decoded.
+	 */
+	std::vector<uint8_t> pngToLossless(uint16_t id, const std::vector<uint8_t> &png, bool alpha, AlphaRounding rounding);
+
+} // hf_workshop
+
+#endif // LOSSLESS_BITMAP_HPP
@@ -6,12 +6,93 @@
  * Hero Fighter by Marti Wong
  */
 
+#include <cstdio>  // fprintf
+#include <cstdlib> // strtoul
+#include <cstring> // strcmp
+
 #include "hf_workshop.hpp"
+#include "batch.hpp"
+#include "compression_cache.hpp"
+
+namespace {
+
+	int usage(const char *program) {
+		std::fprintf(stderr, "Usage: %s [--no-png-optimization] [--low-memory] [--sync]\n"
+		                     "       %s --clear-cache\n"
+		                     "       %s --batch verify|export|recompress [--compression none|zlib|lzma]\n"
+		                     "          [--jobs N] [--output DIR] FILE|DIR|PATTERN...\n", program, program, program);
+		return 1;
+	}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+
+	hf_workshop::Options options;
+	hf_workshop::BatchOptions batch;
+	bool batchMode = false;
+	const char *batchOption = nullptr;  // first option given that only batch mode takes
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--no-png-optimization") == 0) {
+			options.optimizePngs = false;
+		} else if (std::strcmp(argv[i], "--low-memory") == 0) {
+			options.lowMemory = true;
+		} else if (std::strcmp(argv[i], "--sync") == 0) {
+			options.syncWrites = true;
+		} else if (std::strcmp(argv[i], "--clear-cache") == 0) {
+			hf_workshop::CompressionCache().clear();
+			return 0;
+		} else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+			batchMode = true;
+			++i;
+			if (std::strcmp(argv[i], "verify") == 0) {
+				batch.operation = hf_workshop::BatchOperation::verify;
+			} else if (std::strcmp(argv[i], "export") == 0) {
+				batch.operation = hf_workshop::BatchOperation::exportSwf;
+			} else if (std::strcmp(argv[i], "recompress") == 0) {
+				batch.operation = hf_workshop::BatchOperation::recompress;
+			} else {
+				std::fprintf(stderr, "Unknown batch operation: %s\n", argv[i]);
+				return usage(argv[0]);
+			}
+		} else if (std::strcmp(argv[i], "--compression") == 0 && i + 1 < argc) {
+			batchOption = batchOption ? batchOption : argv[i];
+			++i;
+			if (std::strcmp(argv[i], "none") == 0) {
+				batch.compression = swf::CompressionChoice::uncompressed;
+			} else if (std::strcmp(argv[i], "zlib") == 0) {
+				batch.compression = swf::CompressionChoice::zlib;
+			} else if (std::strcmp(argv[i], "lzma") == 0) {
+				batch.compression = swf::CompressionChoice::lzma;
+			} else {
+				std::fprintf(stderr, "Unknown compression: %s\n", argv[i]);
+				return usage(argv[0]);
+			}
+		} else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			batchOption = batchOption ? batchOption : argv[i];
+			batch.jobs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		} else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			batchOption = batchOption ? batchOption : argv[i];
+			batch.outputDirectory = argv[++i];
+		} else if (batchMode && argv[i][0] != '-') {
+			batch.inputs.emplace_back(argv[i]);
+		} else {
+			std::fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			return usage(argv[0]);
+		}
+	}
+
+	if (!batchMode && batchOption) {
+		std::fprintf(stderr, "%s can only be used with --batch\n", batchOption);
+		return usage(argv[0]);
+	}
 
-int main() {
+	if (batchMode) {
+		return hf_workshop::runBatch(batch) == 0 ? 0 : 1;
+	}
 
 	// Start everything
-	hf_workshop::hfw h;
+	hf_workshop::hfw h(options);
 
 	return 0;
 }
@@ -0,0 +1,106 @@
+/**
+ * HF Workshop - Memory mapped files
+ */
+
+#include "mapped_file.hpp"
+
+#include <stdexcept> // runtime_error
+
+#ifdef _WIN32
+	#include <Windows.h> // CreateFileW, CreateFileMappingW, MapViewOfFile
+	#include "utils.hpp" // s2ws
+#else
+	#include <cerrno>      // errno
+	#include <cstring>     // strerror
+	#include <fcntl.h>     // open
+	#include <sys/mman.h>  // mmap, munmap
+	#include <sys/stat.h>  // fstat
+	#include <unistd.h>    // close
+#endif
+
+using namespace std;
+
+namespace hf_workshop {
+
+#ifdef _WIN32
+
+	MappedFile::MappedFile(const string &filename) : bytes(nullptr), length(0) {
+		// Because of unicode file names
+		HANDLE file = CreateFileW(s2ws(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw runtime_error("Error opening file: CreateFile");
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			throw runtime_error("Error reading file size: GetFileSizeEx");
+		}
+		if (fileSize.QuadPart == 0) {
+			CloseHandle(file);
+			return;
+		}
+
+		// The view keeps the file and the mapping open
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr) {
+			throw runtime_error("Error mapping file: CreateFileMapping");
+		}
+		void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (view == nullptr) {
+			throw runtime_error("Error mapping file: MapViewOfFile");
+		}
+
+		bytes = static_cast<const uint8_t *>(view);
+		length = static_cast<size_t>(fileSize.QuadPart);
+	}
+
+	MappedFile::~MappedFile() {
+		if (bytes != nullptr) {
+			UnmapViewOfFile(bytes);
+		}
+	}
+
+#else
+
+	MappedFile::MappedFile(const string &filename) : bytes(nullptr), length(0) {
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw runtime_error(strerror(errno));
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			int error = errno;
+			close(fd);
+			throw runtime_error(strerror(error));
+		}
+		if (st.st_size == 0) {
+			close(fd);
+			return;
+		}
+
+		// The mapping keeps the file open
+		void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		int error = errno;
+		close(fd);
+		if (view == MAP_FAILED) {
+			throw runtime_error(strerror(error));
+		}
+
+		bytes = static_cast<const uint8_t *>(view);
+		length = static_cast<size_t>(st.st_size);
+	}
+
+	MappedFile::~MappedFile() {
+		if (bytes != nullptr) {
+			munmap(const_cast<uint8_t *>(bytes), length);
+		}
+	}
+
+#endif
+
+} // hf_workshop
@@ -0,0 +1,37 @@
+/**
+ * HF Workshop - Memory mapped files
+ */
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <cstdint> // uint8_t
+#include <cstddef> // size_t
+
+namespace hf_workshop {
+
+	/**
+	 * A file mapped read-only into memory, so that its pages are only read
+	 * from disk when they're touched.
+	 */
+	class MappedFile {
+	public:
+		/// Maps the whole file. Throws std::runtime_error if it can't be opened or mapped.
+		explicit MappedFile(const std::string &filename);
+		~MappedFile();
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+
+		/// Contents of the file, nullptr if it's empty
+		const uint8_t *data() const { return bytes; }
+		size_t size() const { return length; }
+
+	private:
+		const uint8_t *bytes;
+		size_t length;
+	};
+
+} // hf_workshop
+
+#endif // MAPPED_FILE_HPP
@@ -268,12 +268,12 @@ namespace minizip {
 	}
 
 	void Zipper::add(const std::string &name, const std::string &comment,
-			int compressionLevel, std::string &s) {
+			int compressionLevel, const std::string &s) {
 		this->add(name, comment, compressionLevel, s.data(), s.size());
 	}
 
 	void Zipper::add(const std::string &name, const std::string &comment,
-			int compressionLevel, std::vector<uint8_t> &vec) {
+			int compressionLevel, const std::vector<uint8_t> &vec) {
 		this->add(name, comment, compressionLevel, vec.data(), vec.size());
 	}
 
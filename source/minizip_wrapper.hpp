@@ -141,8 +141,8 @@ namespace minizip {
 		Zipper(const std::string & filename, const std::string & comment);
 		~Zipper();
 		// Z_BEST_COMPRESSION
-		void add(const std::string& name, const std::string& comment, int compressionLevel, std::string& s);
-		void add(const std::string& name, const std::string& comment, int compressionLevel, std::vector<uint8_t>& vec);
+		void add(const std::string& name, const std::string& comment, int compressionLevel, const std::string& s);
+		void add(const std::string& name, const std::string& comment, int compressionLevel, const std::vector<uint8_t>& vec);
 		void add(const std::string& name, const std::string& comment, int compressionLevel, const void* buf, size_t bufLen);
 		void close();
 
@@ -0,0 +1,198 @@
+/**
+ * HF Workshop - Mod patches
+ *
+ * Patch files are little endian, so that they can be shared between machines.
+ *
+ * Header: magic[8], base size (u64), base hash (u64), result hash (u64),
+ *         tag count (u32)
+ * Tags:   character ID (u16), tag code (u16), compression (u8: 0 none,
+ *         1 zlib), record length (u32), stored length (u32), stored bytes
+ * Footer: XXH64 of everything before it (u64)
+ */
+
+#include "mod_patch.hpp"
+
+#include <cstring>   // memcmp
+#include <memory>    // make_shared
+#include <stdexcept> // runtime_error
+
+#include "mapped_file.hpp"
+#include "xxhash.hpp"
+#include "zlib_wrapper.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		constexpr char MAGIC[8] = {'H', 'F', 'W', 'P', 'T', 'C', 'H', '1'};
+		constexpr uint8_t STORED = 0;
+		constexpr uint8_t ZLIB = 1;
+
+		template<typename T>
+		void putLe(vector<uint8_t> &out, T value) {
+			for (size_t i = 0; i < sizeof(T); ++i) {
+				out.emplace_back(static_cast<uint8_t>(value >> (8 * i)));
+			}
+		}
+
+		class PatchReader {
+		public:
+			PatchReader(const uint8_t *_data, size_t _size) : data(_data), size(_size), pos(0) {}
+
+			template<typename T>
+			T get() {
+				check(sizeof(T));
+				T value = 0;
+				for (size_t i = 0; i < sizeof(T); ++i) {
+					value = static_cast<T>(value | static_cast<T>(static_cast<T>(data[pos + i]) << (8 * i)));
+				}
+				pos += sizeof(T);
+				return value;
+			}
+
+			const uint8_t *bytes(size_t length) {
+				check(length);
+				const uint8_t *at = data + pos;
+				pos += length;
+				return at;
+			}
+
+			bool atEnd() const { return pos == size; }
+
+		private:
+			const uint8_t *data;
+			size_t size;
+			size_t pos;
+
+			void check(size_t length) const {
+				if (length > size - pos) {
+					throw runtime_error("Patch is truncated.");
+				}
+			}
+		};
+
+		/// Whether a record is a whole tag of this code that defines this character
+		bool isCharacterRecord(const vector<uint8_t> &record, uint16_t code, uint16_t id) {
+			if (!definesCharacter(code) || record.size() < 2) {
+				return false;
+			}
+			PatchReader r(record.data(), record.size());
+			auto codeAndLength = r.get<uint16_t>();
+			size_t headerLength = 2;
+			size_t length = codeAndLength & 0x3F;
+			if (length == 0x3F) {
+				headerLength = 6;
+				length = r.get<uint32_t>();
+			}
+			return (codeAndLength >> 6) == code && record.size() - headerLength == length && length >= 2 &&
+			       r.get<uint16_t>() == id;
+		}
+
+	} // anonymous namespace
+
+	ModPatch diffSwf(const vector<uint8_t> &base, const vector<uint8_t> &result) {
+
+		map<size_t, TagRecord> baseTags;
+		for (const TagRecord &t : scanTags(base.data(), base.size())) {
+			if (definesCharacter(t.code)) {
+				baseTags.emplace(characterId(base.data(), t), t);
+			}
+		}
+
+		ModPatch patch{base.size(), xxh64(base), xxh64(result), {}};
+		for (const TagRecord &t : scanTags(result.data(), result.size())) {
+			if (!definesCharacter(t.code)) {
+				continue;
+			}
+			size_t id = characterId(result.data(), t);
+			auto it = baseTags.find(id);
+			if (it == baseTags.end()) {
+				throw runtime_error("Character " + to_string(id) + " isn't in the original game.");
+			}
+			const TagRecord &b = it->second;
+			size_t length = t.end() - t.offset;
+			if (b.end() - b.offset == length && memcmp(base.data() + b.offset, result.data() + t.offset, length) == 0) {
+				continue;
+			}
+			patch.tags.emplace(id, make_shared<const vector<uint8_t>>(result.begin() + static_cast<ptrdiff_t>(t.offset),
+			                                                          result.begin() + static_cast<ptrdiff_t>(t.end())));
+		}
+		return patch;
+	}
+
+	vector<uint8_t> serializePatch(const ModPatch &patch) {
+
+		vector<uint8_t> out(MAGIC, MAGIC + sizeof(MAGIC));
+		putLe<uint64_t>(out, patch.baseSize);
+		putLe<uint64_t>(out, patch.baseHash);
+		putLe<uint64_t>(out, patch.resultHash);
+		putLe<uint32_t>(out, static_cast<uint32_t>(patch.tags.size()));
+
+		for (const auto &tag : patch.tags) {
+			const vector<uint8_t> &record = *tag.second;
+			uint16_t code = static_cast<uint16_t>((record[0] | (record[1] << 8)) >> 6);
+			vector<uint8_t> compressed = zlib::zlib_compress(record);
+			bool zlib = compressed.size() < record.size();
+			const vector<uint8_t> &stored = zlib ? compressed : record;
+
+			putLe<uint16_t>(out, static_cast<uint16_t>(tag.first));
+			putLe<uint16_t>(out, code);
+			out.emplace_back(zlib ? ZLIB : STORED);
+			putLe<uint32_t>(out, static_cast<uint32_t>(record.size()));
+			putLe<uint32_t>(out, static_cast<uint32_t>(stored.size()));
+			out.insert(out.end(), stored.begin(), stored.end());
+		}
+
+		putLe<uint64_t>(out, xxh64(out));
+		return out;
+	}
+
+	ModPatch readPatch(const string &filename) {
+
+		MappedFile file(filename);
+		if (file.size() < sizeof(MAGIC) + 8 || memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0) {
+			throw runtime_error("Not an HF Workshop patch.");
+		}
+		size_t bodySize = file.size() - 8;
+		if (PatchReader(file.data() + bodySize, 8).get<uint64_t>() != xxh64(file.data(), bodySize)) {
+			throw runtime_error("Patch is damaged.");
+		}
+
+		PatchReader r(file.data() + sizeof(MAGIC), bodySize - sizeof(MAGIC));
+		ModPatch patch{};
+		patch.baseSize = r.get<uint64_t>();
+		patch.baseHash = r.get<uint64_t>();
+		patch.resultHash = r.get<uint64_t>();
+
+		auto count = r.get<uint32_t>();
+		for (uint32_t i = 0; i < count; ++i) {
+			auto id = r.get<uint16_t>();
+			auto code = r.get<uint16_t>();
+			auto compression = r.get<uint8_t>();
+			auto length = r.get<uint32_t>();
+			auto storedLength = r.get<uint32_t>();
+			const uint8_t *stored = r.bytes(storedLength);
+
+			vector<uint8_t> record;
+			if (compression == ZLIB) {
+				record = zlib::zlib_decompress(vector<uint8_t>(stored, stored + storedLength));
+			} else if (compression == STORED) {
+				record.assign(stored, stored + storedLength);
+			} else {
+				throw runtime_error("Patch has a tag with an unknown compression.");
+			}
+
+			if (record.size() != length || !isCharacterRecord(record, code, id)) {
+				throw runtime_error("Patch has a damaged tag.");
+			}
+			patch.tags.emplace(id, make_shared<const vector<uint8_t>>(move(record)));
+		}
+		if (!r.atEnd()) {
+			throw runtime_error("Patch is damaged.");
+		}
+		return patch;
+	}
+
+} // hf_workshop
@@ -0,0 +1,49 @@
+/**
+ * HF Workshop - Mod patches
+ *
+ * A mod as the tags it replaces in a game, instead of the whole modified
+ * game, so that it's only as large as what it changes.
+ */
+
+#ifndef MOD_PATCH_HPP
+#define MOD_PATCH_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint> // uint8_t, uint16_t, uint64_t
+#include <cstddef> // size_t
+
+#include "swf_tags.hpp" // SharedBytes
+
+namespace hf_workshop {
+
+	struct ModPatch {
+		uint64_t baseSize;    // of the uncompressed game the patch applies to
+		uint64_t baseHash;    // XXH64 of that game
+		uint64_t resultHash;  // XXH64 of the uncompressed game once patched
+		std::map<size_t, SharedBytes> tags;  // character ID -> complete tag record
+	};
+
+	/**
+	 * The character tags of the uncompressed SWF `result` that differ from
+	 * the ones of `base`. Throws std::runtime_error if either can't be
+	 * scanned, or if `result` has a character that `base` doesn't.
+	 */
+	ModPatch diffSwf(const std::vector<uint8_t> &base, const std::vector<uint8_t> &result);
+
+	/**
+	 * The patch file. Every tag record is stored zlib compressed, unless
+	 * that doesn't make it smaller.
+	 */
+	std::vector<uint8_t> serializePatch(const ModPatch &patch);
+
+	/**
+	 * Reads a patch file, inflating its tags one at a time. Throws
+	 * std::runtime_error if it isn't a patch or it's damaged.
+	 */
+	ModPatch readPatch(const std::string &filename);
+
+} // hf_workshop
+
+#endif // MOD_PATCH_HPP
@@ -0,0 +1,58 @@
+/**
+ * HF Workshop - Parallel loops
+ */
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm> // min, max
+#include <atomic>    // atomic
+#include <cstddef>   // size_t
+#include <thread>    // thread, hardware_concurrency
+#include <vector>
+
+namespace hf_workshop {
+
+	/**
+	 * Number of worker threads to use by default.
+	 */
+	inline unsigned defaultThreadCount() {
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	/**
+	 * Calls `fn(i)` for every `i` in [0, count), spread over at most `threads`
+	 * threads. Indices are handed out one at a time, so uneven jobs balance
+	 * themselves. `fn` must not throw.
+	 */
+	template<class Function>
+	void parallelFor(size_t count, Function fn, unsigned threads = defaultThreadCount()) {
+		size_t n = std::min<size_t>(std::max(1u, threads), count);
+		if (n <= 1) {
+			for (size_t i = 0; i < count; ++i) {
+				fn(i);
+			}
+			return;
+		}
+
+		std::atomic<size_t> next{0};
+		auto worker = [&]() {
+			for (size_t i = next++; i < count; i = next++) {
+				fn(i);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		workers.reserve(n - 1);
+		for (size_t t = 1; t < n; ++t) {
+			workers.emplace_back(worker);
+		}
+		worker();
+		for (auto &w : workers) {
+			w.join();
+		}
+	}
+
+} // hf_workshop
+
+#endif // PARALLEL_HPP
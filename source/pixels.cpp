@@ -0,0 +1,436 @@
+/**
+ * HF Workshop - Pixel format conversions
+ *
+ * Every conversion has a scalar version and vector versions for SSE2, AVX2
+ * (chosen at runtime) and NEON. The vector versions handle whole blocks of
+ * pixels and the scalar version does the rest, giving identical results.
+ */
+
+#include "pixels.hpp"
+
+#include <algorithm> // min
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+	#define HFW_SSE2 1
+	#include <immintrin.h>
+	#if defined(__GNUC__)
+		#define HFW_AVX2 1
+	#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define HFW_NEON 1
+	#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		/*
+		 * Division of x = color * alpha by 255, for x <= 255 * 255.
+		 * exact:    (x + 128 + ((x + 128) >> 8)) >> 8 == round(x / 255)
+		 * truncate: (x + 1 + (x >> 8)) >> 8           == floor(x / 255)
+		 * Both are (x + bias1 + ((x + bias2) >> 8)) >> 8, which is what the
+		 * vector versions compute in 16 bit lanes.
+		 */
+		struct Div255Bias {
+			uint16_t bias1;
+			uint16_t bias2;
+		};
+
+		inline Div255Bias div255Bias(AlphaRounding rounding) {
+			return rounding == AlphaRounding::exact ? Div255Bias{128, 128} : Div255Bias{1, 0};
+		}
+
+		inline uint8_t div255(uint32_t x, Div255Bias b) {
+			return static_cast<uint8_t>((x + b.bias1 + ((x + b.bias2) >> 8)) >> 8);
+		}
+
+		/*
+		 * Division of a premultiplied color by alpha:
+		 * min(255, (color * 255 + bias) / alpha), with bias = alpha / 2 when
+		 * rounding to nearest and 0 when truncating. 0 if alpha is 0.
+		 */
+		inline uint8_t unpremultiply(uint32_t c, uint32_t a, bool exact) {
+			if (a == 0) {
+				return 0;
+			}
+			uint32_t q = (c * 255 + (exact ? a / 2 : 0)) / a;
+			return static_cast<uint8_t>(min<uint32_t>(q, 255));
+		}
+
+		void premultiplyScalar(const uint8_t *in, uint8_t *out, size_t pixels, Div255Bias b) {
+			for (size_t i = 0; i < pixels; ++i, in += 4, out += 4) {
+				uint32_t r = in[0], g = in[1], bl = in[2], a = in[3];
+				out[0] = static_cast<uint8_t>(a);
+				out[1] = div255(r * a, b);
+				out[2] = div255(g * a, b);
+				out[3] = div255(bl * a, b);
+			}
+		}
+
+		void unpremultiplyScalar(const uint8_t *in, uint8_t *out, size_t pixels, bool exact) {
+			for (size_t i = 0; i < pixels; ++i, in += 4, out += 4) {
+				uint32_t a = in[0], r = in[1], g = in[2], bl = in[3];
+				out[0] = unpremultiply(r, a, exact);
+				out[1] = unpremultiply(g, a, exact);
+				out[2] = unpremultiply(bl, a, exact);
+				out[3] = static_cast<uint8_t>(a);
+			}
+		}
+
+		void rgbaToArgbScalar(const uint8_t *in, uint8_t *out, size_t pixels) {
+			for (size_t i = 0; i < pixels; ++i, in += 4, out += 4) {
+				uint8_t r = in[0], g = in[1], b = in[2], a = in[3];
+				out[0] = a;
+				out[1] = r;
+				out[2] = g;
+				out[3] = b;
+			}
+		}
+
+		void argbToRgbaScalar(const uint8_t *in, uint8_t *out, size_t pixels) {
+			for (size_t i = 0; i < pixels; ++i, in += 4, out += 4) {
+				uint8_t a = in[0], r = in[1], g = in[2], b = in[3];
+				out[0] = r;
+				out[1] = g;
+				out[2] = b;
+				out[3] = a;
+			}
+		}
+
+	#ifdef HFW_SSE2
+
+		/*
+		 * Loaded as little endian 32 bit lanes, an RGBA pixel is A<<24|B<<16|G<<8|R
+		 * and an ARGB pixel is B<<24|G<<16|R<<8|A, so swizzling between them is
+		 * a rotation by 8 bits.
+		 */
+		inline __m128i rotl8(__m128i v) {
+			return _mm_or_si128(_mm_slli_epi32(v, 8), _mm_srli_epi32(v, 24));
+		}
+
+		inline __m128i rotr8(__m128i v) {
+			return _mm_or_si128(_mm_srli_epi32(v, 8), _mm_slli_epi32(v, 24));
+		}
+
+		inline __m128i div255Sse2(__m128i x, __m128i bias1, __m128i bias2) {
+			return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, bias1), _mm_srli_epi16(_mm_add_epi16(x, bias2), 8)), 8);
+		}
+
+		inline __m128i unpremultiplySse2(__m128i px, __m128i exactMask) {
+			__m128i a = _mm_shuffle_epi32(px, 0);
+			__m128i n = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(px, 8), px),
+			                          _mm_and_si128(_mm_srli_epi32(a, 1), exactMask));
+			// Alpha 0 gives inf or NaN, which convert to INT_MIN and saturate to 0 when packing
+			return _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(n), _mm_cvtepi32_ps(a)));
+		}
+
+		size_t premultiplySse2(const uint8_t *in, uint8_t *out, size_t pixels, Div255Bias b) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i bias1 = _mm_set1_epi16(static_cast<short>(b.bias1));
+			const __m128i bias2 = _mm_set1_epi16(static_cast<short>(b.bias2));
+			const __m128i alphaMask = _mm_slli_epi32(_mm_set1_epi32(0xFF), 24);
+
+			size_t blocks = pixels / 4;
+			for (size_t i = 0; i < blocks; ++i, in += 16, out += 16) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+				__m128i lo = _mm_unpacklo_epi8(v, zero);
+				__m128i hi = _mm_unpackhi_epi8(v, zero);
+				__m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+				__m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+				lo = div255Sse2(_mm_mullo_epi16(lo, alo), bias1, bias2);
+				hi = div255Sse2(_mm_mullo_epi16(hi, ahi), bias1, bias2);
+				__m128i p = _mm_packus_epi16(lo, hi);
+				p = _mm_or_si128(_mm_andnot_si128(alphaMask, p), _mm_and_si128(alphaMask, v));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out), rotl8(p));
+			}
+			return blocks * 4;
+		}
+
+		size_t unpremultiplySse2(const uint8_t *in, uint8_t *out, size_t pixels, bool exact) {
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i exactMask = exact ? _mm_set1_epi32(-1) : zero;
+			const __m128i alphaMask = _mm_set1_epi32(0xFF);
+
+			size_t blocks = pixels / 4;
+			for (size_t i = 0; i < blocks; ++i, in += 16, out += 16) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+				__m128i lo = _mm_unpacklo_epi8(v, zero);
+				__m128i hi = _mm_unpackhi_epi8(v, zero);
+				__m128i q0 = unpremultiplySse2(_mm_unpacklo_epi16(lo, zero), exactMask);
+				__m128i q1 = unpremultiplySse2(_mm_unpackhi_epi16(lo, zero), exactMask);
+				__m128i q2 = unpremultiplySse2(_mm_unpacklo_epi16(hi, zero), exactMask);
+				__m128i q3 = unpremultiplySse2(_mm_unpackhi_epi16(hi, zero), exactMask);
+				__m128i p = _mm_packus_epi16(_mm_packs_epi32(q0, q1), _mm_packs_epi32(q2, q3));
+				p = _mm_or_si128(_mm_andnot_si128(alphaMask, p), _mm_and_si128(alphaMask, v));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out), rotr8(p));
+			}
+			return blocks * 4;
+		}
+
+		size_t rgbaToArgbSse2(const uint8_t *in, uint8_t *out, size_t pixels) {
+			size_t blocks = pixels / 4;
+			for (size_t i = 0; i < blocks; ++i, in += 16, out += 16) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out), rotl8(v));
+			}
+			return blocks * 4;
+		}
+
+		size_t argbToRgbaSse2(const uint8_t *in, uint8_t *out, size_t pixels) {
+			size_t blocks = pixels / 4;
+			for (size_t i = 0; i < blocks; ++i, in += 16, out += 16) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out), rotr8(v));
+			}
+			return blocks * 4;
+		}
+
+	#endif // HFW_SSE2
+
+	#ifdef HFW_AVX2
+
+		// Same as the SSE2 versions on 8 pixels. All the shuffles and packs
+		// work within 128 bit lanes, so the pixel order is kept.
+
+		bool hasAvx2() {
+			static const bool avx2 = __builtin_cpu_supports("avx2");
+			return avx2;
+		}
+
+		__attribute__((target("avx2")))
+		inline __m256i rotl8Avx2(__m256i v) {
+			return _mm256_or_si256(_mm256_slli_epi32(v, 8), _mm256_srli_epi32(v, 24));
+		}
+
+		__attribute__((target("avx2")))
+		inline __m256i rotr8Avx2(__m256i v) {
+			return _mm256_or_si256(_mm256_srli_epi32(v, 8), _mm256_slli_epi32(v, 24));
+		}
+
+		__attribute__((target("avx2")))
+		inline __m256i div255Avx2(__m256i x, __m256i bias1, __m256i bias2) {
+			return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, bias1),
+			                         _mm256_srli_epi16(_mm256_add_epi16(x, bias2), 8)), 8);
+		}
+
+		__attribute__((target("avx2")))
+		inline __m256i unpremultiplyAvx2(__m256i px, __m256i exactMask) {
+			__m256i a = _mm256_shuffle_epi32(px, 0);
+			__m256i n = _mm256_add_epi32(_mm256_sub_epi32(_mm256_slli_epi32(px, 8), px),
+			                             _mm256_and_si256(_mm256_srli_epi32(a, 1), exactMask));
+			return _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(n), _mm256_cvtepi32_ps(a)));
+		}
+
+		__attribute__((target("avx2")))
+		size_t premultiplyAvx2(const uint8_t *in, uint8_t *out, size_t pixels, Div255Bias b) {
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i bias1 = _mm256_set1_epi16(static_cast<short>(b.bias1));
+			const __m256i bias2 = _mm256_set1_epi16(static_cast<short>(b.bias2));
+			const __m256i alphaMask = _mm256_slli_epi32(_mm256_set1_epi32(0xFF), 24);
+
+			size_t blocks = pixels / 8;
+			for (size_t i = 0; i < blocks; ++i, in += 32, out += 32) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+				__m256i lo = _mm256_unpacklo_epi8(v, zero);
+				__m256i hi = _mm256_unpackhi_epi8(v, zero);
+				__m256i alo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, 0xFF), 0xFF);
+				__m256i ahi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, 0xFF), 0xFF);
+				lo = div255Avx2(_mm256_mullo_epi16(lo, alo), bias1, bias2);
+				hi = div255Avx2(_mm256_mullo_epi16(hi, ahi), bias1, bias2);
+				__m256i p = _mm256_packus_epi16(lo, hi);
+				p = _mm256_or_si256(_mm256_andnot_si256(alphaMask, p), _mm256_and_si256(alphaMask, v));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(out), rotl8Avx2(p));
+			}
+			return blocks * 8;
+		}
+
+		__attribute__((target("avx2")))
+		size_t unpremultiplyAvx2(const uint8_t *in, uint8_t *out, size_t pixels, bool exact) {
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i exactMask = exact ? _mm256_set1_epi32(-1) : zero;
+			const __m256i alphaMask = _mm256_set1_epi32(0xFF);
+
+			size_t blocks = pixels / 8;
+			for (size_t i = 0; i < blocks; ++i, in += 32, out += 32) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+				__m256i lo = _mm256_unpacklo_epi8(v, zero);
+				__m256i hi = _mm256_unpackhi_epi8(v, zero);
+				__m256i q0 = unpremultiplyAvx2(_mm256_unpacklo_epi16(lo, zero), exactMask);
+				__m256i q1 = unpremultiplyAvx2(_mm256_unpackhi_epi16(lo, zero), exactMask);
+				__m256i q2 = unpremultiplyAvx2(_mm256_unpacklo_epi16(hi, zero), exactMask);
+				__m256i q3 = unpremultiplyAvx2(_mm256_unpackhi_epi16(hi, zero), exactMask);
+				__m256i p = _mm256_packus_epi16(_mm256_packs_epi32(q0, q1), _mm256_packs_epi32(q2, q3));
+				p = _mm256_or_si256(_mm256_andnot_si256(alphaMask, p), _mm256_and_si256(alphaMask, v));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(out), rotr8Avx2(p));
+			}
+			return blocks * 8;
+		}
+
+		__attribute__((target("avx2")))
+		size_t rgbaToArgbAvx2(const uint8_t *in, uint8_t *out, size_t pixels) {
+			size_t blocks = pixels / 8;
+			for (size_t i = 0; i < blocks; ++i, in += 32, out += 32) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(out), rotl8Avx2(v));
+			}
+			return blocks * 8;
+		}
+
+		__attribute__((target("avx2")))
+		size_t argbToRgbaAvx2(const uint8_t *in, uint8_t *out, size_t pixels) {
+			size_t blocks = pixels / 8;
+			for (size_t i = 0; i < blocks; ++i, in += 32, out += 32) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in));
+				_mm256_storeu_si256(reinterpret_cast<__m256i *>(out), rotr8Avx2(v));
+			}
+			return blocks * 8;
+		}
+
+	#endif // HFW_AVX2
+
+	#ifdef HFW_NEON
+
+		// vld4/vst4 split 16 pixels into one register per channel, so
+		// swizzling is just storing the registers in another order.
+
+		inline uint8x8_t div255Neon(uint16x8_t x, uint16x8_t bias1, uint16x8_t bias2) {
+			return vshrn_n_u16(vaddq_u16(vaddq_u16(x, bias1), vshrq_n_u16(vaddq_u16(x, bias2), 8)), 8);
+		}
+
+		inline uint8x16_t premultiplyNeon(uint8x16_t c, uint8x16_t a, uint16x8_t bias1, uint16x8_t bias2) {
+			uint8x8_t lo = div255Neon(vmull_u8(vget_low_u8(c), vget_low_u8(a)), bias1, bias2);
+			uint8x8_t hi = div255Neon(vmull_u8(vget_high_u8(c), vget_high_u8(a)), bias1, bias2);
+			return vcombine_u8(lo, hi);
+		}
+
+		inline uint16x4_t unpremultiplyNeon(uint16x4_t c, uint16x4_t a, bool exact) {
+			uint32x4_t a32 = vmovl_u16(a);
+			uint32x4_t n = vmulq_n_u32(vmovl_u16(c), 255);
+			if (exact) {
+				n = vaddq_u32(n, vshrq_n_u32(a32, 1));
+			}
+			uint32x4_t q = vcvtq_u32_f32(vdivq_f32(vcvtq_f32_u32(n), vcvtq_f32_u32(a32)));
+			return vqmovn_u32(q);
+		}
+
+		inline uint8x16_t unpremultiplyNeon(uint8x16_t c, uint8x16_t a, bool exact) {
+			uint16x8_t c0 = vmovl_u8(vget_low_u8(c)), c1 = vmovl_u8(vget_high_u8(c));
+			uint16x8_t a0 = vmovl_u8(vget_low_u8(a)), a1 = vmovl_u8(vget_high_u8(a));
+			uint16x8_t lo = vcombine_u16(unpremultiplyNeon(vget_low_u16(c0), vget_low_u16(a0), exact),
+			                             unpremultiplyNeon(vget_high_u16(c0), vget_high_u16(a0), exact));
+			uint16x8_t hi = vcombine_u16(unpremultiplyNeon(vget_low_u16(c1), vget_low_u16(a1), exact),
+			                             unpremultiplyNeon(vget_high_u16(c1), vget_high_u16(a1), exact));
+			uint8x16_t q = vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi));
+			// Division by alpha 0 saturates, colors of transparent pixels must be 0
+			return vandq_u8(q, vcgtq_u8(a, vdupq_n_u8(0)));
+		}
+
+		size_t premultiplyNeon(const uint8_t *in, uint8_t *out, size_t pixels, Div255Bias b) {
+			const uint16x8_t bias1 = vdupq_n_u16(b.bias1);
+			const uint16x8_t bias2 = vdupq_n_u16(b.bias2);
+
+			size_t blocks = pixels / 16;
+			for (size_t i = 0; i < blocks; ++i, in += 64, out += 64) {
+				uint8x16x4_t rgba = vld4q_u8(in);
+				uint8x16x4_t argb;
+				argb.val[0] = rgba.val[3];
+				argb.val[1] = premultiplyNeon(rgba.val[0], rgba.val[3], bias1, bias2);
+				argb.val[2] = premultiplyNeon(rgba.val[1], rgba.val[3], bias1, bias2);
+				argb.val[3] = premultiplyNeon(rgba.val[2], rgba.val[3], bias1, bias2);
+				vst4q_u8(out, argb);
+			}
+			return blocks * 16;
+		}
+
+		size_t unpremultiplyNeon(const uint8_t *in, uint8_t *out, size_t pixels, bool exact) {
+			size_t blocks = pixels / 16;
+			for (size_t i = 0; i < blocks; ++i, in += 64, out += 64) {
+				uint8x16x4_t argb = vld4q_u8(in);
+				uint8x16x4_t rgba;
+				rgba.val[0] = unpremultiplyNeon(argb.val[1], argb.val[0], exact);
+				rgba.val[1] = unpremultiplyNeon(argb.val[2], argb.val[0], exact);
+				rgba.val[2] = unpremultiplyNeon(argb.val[3], argb.val[0], exact);
+				rgba.val[3] = argb.val[0];
+				vst4q_u8(out, rgba);
+			}
+			return blocks * 16;
+		}
+
+		size_t rgbaToArgbNeon(const uint8_t *in, uint8_t *out, size_t pixels) {
+			size_t blocks = pixels / 16;
+			for (size_t i = 0; i < blocks; ++i, in += 64, out += 64) {
+				uint8x16x4_t rgba = vld4q_u8(in);
+				uint8x16x4_t argb = {{rgba.val[3], rgba.val[0], rgba.val[1], rgba.val[2]}};
+				vst4q_u8(out, argb);
+			}
+			return blocks * 16;
+		}
+
+		size_t argbToRgbaNeon(const uint8_t *in, uint8_t *out, size_t pixels) {
+			size_t blocks = pixels / 16;
+			for (size_t i = 0; i < blocks; ++i, in += 64, out += 64) {
+				uint8x16x4_t argb = vld4q_u8(in);
+				uint8x16x4_t rgba = {{argb.val[1], argb.val[2], argb.val[3], argb.val[0]}};
+				vst4q_u8(out, rgba);
+			}
+			return blocks * 16;
+		}
+
+	#endif // HFW_NEON
+
+	} // anonymous namespace
+
+	void premultiplyRgbaToArgb(const uint8_t *rgba, uint8_t *argb, size_t pixels, AlphaRounding rounding) {
+		Div255Bias b = div255Bias(rounding);
+		size_t done = 0;
+	#if defined(HFW_AVX2)
+		done = hasAvx2() ? premultiplyAvx2(rgba, argb, pixels, b) : premultiplySse2(rgba, argb, pixels, b);
+	#elif defined(HFW_SSE2)
+		done = premultiplySse2(rgba, argb, pixels, b);
+	#elif defined(HFW_NEON)
+		done = premultiplyNeon(rgba, argb, pixels, b);
+	#endif
+		premultiplyScalar(rgba + 4 * done, argb + 4 * done, pixels - done, b);
+	}
+
+	void unpremultiplyArgbToRgba(const uint8_t *argb, uint8_t *rgba, size_t pixels, AlphaRounding rounding) {
+		bool exact = (rounding == AlphaRounding::exact);
+		size_t done = 0;
+	#if defined(HFW_AVX2)
+		done = hasAvx2() ? unpremultiplyAvx2(argb, rgba, pixels, exact) : unpremultiplySse2(argb, rgba, pixels, exact);
+	#elif defined(HFW_SSE2)
+		done = unpremultiplySse2(argb, rgba, pixels, exact);
+	#elif defined(HFW_NEON)
+		done = unpremultiplyNeon(argb, rgba, pixels, exact);
+	#endif
+		unpremultiplyScalar(argb + 4 * done, rgba + 4 * done, pixels - done, exact);
+	}
+
+	void rgbaToArgb(const uint8_t *rgba, uint8_t *argb, size_t pixels) {
+		size_t done = 0;
+	#if defined(HFW_AVX2)
+		done = hasAvx2() ? rgbaToArgbAvx2(rgba, argb, pixels) : rgbaToArgbSse2(rgba, argb, pixels);
+	#elif defined(HFW_SSE2)
+		done = rgbaToArgbSse2(rgba, argb, pixels);
+	#elif defined(HFW_NEON)
+		done = rgbaToArgbNeon(rgba, argb, pixels);
+	#endif
+		rgbaToArgbScalar(rgba + 4 * done, argb + 4 * done, pixels - done);
+	}
+
+	void argbToRgba(const uint8_t *argb, uint8_t *rgba, size_t pixels) {
+		size_t done = 0;
+	#if defined(HFW_AVX2)
+		done = hasAvx2() ? argbToRgbaAvx2(argb, rgba, pixels) : argbToRgbaSse2(argb, rgba, pixels);
+	#elif defined(HFW_SSE2)
+		done = argbToRgbaSse2(argb, rgba, pixels);
+	#elif defined(HFW_NEON)
+		done = argbToRgbaNeon(argb, rgba, pixels);
+	#endif
+		argbToRgbaScalar(argb + 4 * done, rgba + 4 * done, pixels - done);
+	}
+
+} // hf_workshop
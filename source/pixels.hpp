@@ -0,0 +1,49 @@
+/**
+ * HF Workshop - Pixel format conversions
+ */
+
+#ifndef PIXELS_HPP
+#define PIXELS_HPP
+
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t
+
+namespace hf_workshop {
+
+	/**
+	 * How colors are rounded when multiplying or dividing them by alpha.
+	 *
+	 * `truncate` rounds down, which loses a little of the color every time an
+	 * image goes through unpremultiply and premultiply again. `exact` rounds
+	 * to the nearest value, so that premultiplying an image that was just
+	 * unpremultiplied gives back the same pixels: exporting an image and
+	 * replacing it with the exported file doesn't change it.
+	 */
+	enum class AlphaRounding {
+		truncate,
+		exact
+	};
+
+	/**
+	 * Converts straight alpha RGBA pixels (as in PNG) to premultiplied ARGB
+	 * (as in DefineBitsLossless2). `rgba` and `argb` may be the same buffer.
+	 */
+	void premultiplyRgbaToArgb(const uint8_t *rgba, uint8_t *argb, size_t pixels, AlphaRounding rounding);
+
+	/**
+	 * Converts premultiplied ARGB pixels to straight alpha RGBA. Colors of
+	 * fully transparent pixels become 0 and colors greater than alpha are
+	 * clamped to 255. `argb` and `rgba` may be the same buffer.
+	 */
+	void unpremultiplyArgbToRgba(const uint8_t *argb, uint8_t *rgba, size_t pixels, AlphaRounding rounding);
+
+	/**
+	 * Reorders the channels of RGBA pixels to ARGB and back, without changing
+	 * them. The buffers may be the same.
+	 */
+	void rgbaToArgb(const uint8_t *rgba, uint8_t *argb, size_t pixels);
+	void argbToRgba(const uint8_t *argb, uint8_t *rgba, size_t pixels);
+
+} // hf_workshop
+
+#endif // PIXELS_HPP
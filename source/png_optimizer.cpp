@@ -0,0 +1,224 @@
+/**
+ * HF Workshop - PNG optimizer
+ */
+
+#include "png_optimizer.hpp"
+#include "parallel.hpp"
+
+#include <cstdlib>       // malloc, free
+#include <limits>        // numeric_limits
+#include <mutex>         // mutex, lock_guard
+#include <unordered_map> // unordered_map
+#include <exception>     // exception
+
+#include <zlib.h>
+#include <lodepng/lodepng.h>
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		const PngZlibSettings zlibSettings[] = {
+			{Z_BEST_COMPRESSION, Z_DEFAULT_STRATEGY},
+			{Z_BEST_COMPRESSION, Z_FILTERED}
+		};
+
+		const LodePNGFilterStrategy filterStrategies[] = { LFS_ZERO, LFS_MINSUM, LFS_ENTROPY };
+
+		struct ColorMode {
+			bool automatic; // let LodePNG pick
+			LodePNGColorType type;
+			unsigned bitdepth;
+		};
+
+		struct Image {
+			bool valid = false;
+			unsigned w = 0;
+			unsigned h = 0;
+			vector<unsigned char> rgba;
+			bool opaque = true;
+			bool grey = true;
+			vector<uint32_t> palette; // RGBA, empty if more than 256 colors
+
+			Image() : rgba(), palette() {}
+		};
+
+		struct Job {
+			size_t image;
+			ColorMode mode;
+			LodePNGFilterStrategy filter;
+			const PngZlibSettings *zlib;
+		};
+
+		Image analyze(const vector<uint8_t> &png) {
+			Image img;
+
+			lodepng::State state;
+			if (lodepng::decode(img.rgba, img.w, img.h, state, png) != 0 ||
+			    state.info_png.color.bitdepth > 8 || img.rgba.empty()) {
+				return img;
+			}
+
+			unordered_map<uint32_t, size_t> colors;
+			bool fitsPalette = true;
+			for (size_t i = 0; i + 3 < img.rgba.size(); i += 4) {
+				unsigned char r = img.rgba[i], g = img.rgba[i+1], b = img.rgba[i+2], a = img.rgba[i+3];
+				if (a != 255) {
+					img.opaque = false;
+				}
+				if (r != g || g != b) {
+					img.grey = false;
+				}
+				if (fitsPalette) {
+					uint32_t c = (static_cast<uint32_t>(r) << 24) | (static_cast<uint32_t>(g) << 16) |
+					             (static_cast<uint32_t>(b) << 8) | a;
+					if (colors.emplace(c, img.palette.size()).second) {
+						img.palette.emplace_back(c);
+						if (img.palette.size() > 256) {
+							fitsPalette = false;
+							img.palette.clear();
+						}
+					}
+				}
+			}
+
+			img.valid = true;
+			return img;
+		}
+
+		vector<ColorMode> colorModes(const Image &img) {
+			vector<ColorMode> modes = { {true, LCT_RGBA, 8}, {false, LCT_RGBA, 8} };
+			if (img.opaque) {
+				modes.push_back({false, LCT_RGB, 8});
+			}
+			if (img.grey) {
+				modes.push_back({false, (img.opaque ? LCT_GREY : LCT_GREY_ALPHA), 8});
+			}
+			if (!img.palette.empty()) {
+				size_t n = img.palette.size();
+				unsigned bits = (n <= 2 ? 1 : (n <= 4 ? 2 : (n <= 16 ? 4 : 8)));
+				modes.push_back({false, LCT_PALETTE, bits});
+			}
+			return modes;
+		}
+
+		bool encode(const Image &img, const Job &job, vector<unsigned char> &out) {
+			lodepng::State state;
+			state.encoder.auto_convert = job.mode.automatic ? 1 : 0;
+			state.encoder.filter_palette_zero = 0;
+			state.encoder.filter_strategy = job.filter;
+			state.encoder.add_id = 0;
+			state.encoder.zlibsettings.custom_zlib = pngZlibCompress;
+			state.encoder.zlibsettings.custom_context = job.zlib;
+
+			if (!job.mode.automatic) {
+				state.info_png.color.colortype = job.mode.type;
+				state.info_png.color.bitdepth = job.mode.bitdepth;
+				if (job.mode.type == LCT_PALETTE) {
+					for (uint32_t c : img.palette) {
+						lodepng_palette_add(&state.info_png.color, static_cast<unsigned char>(c >> 24),
+						                    static_cast<unsigned char>(c >> 16), static_cast<unsigned char>(c >> 8),
+						                    static_cast<unsigned char>(c));
+					}
+				}
+			}
+
+			return lodepng::encode(out, img.rgba, img.w, img.h, state) == 0;
+		}
+
+	} // anonymous namespace
+
+	// The output must be allocated with malloc because LodePNG frees it
+	unsigned pngZlibCompress(unsigned char **out, size_t *outSize, const unsigned char *in,
+	                         size_t inSize, const LodePNGCompressSettings *settings) {
+
+		auto zs = static_cast<const PngZlibSettings *>(settings->custom_context);
+		if (inSize > numeric_limits<uInt>::max()) {
+			return 1;
+		}
+
+		z_stream strm{};
+		if (deflateInit2(&strm, zs->level, Z_DEFLATED, MAX_WBITS, MAX_MEM_LEVEL, zs->strategy) != Z_OK) {
+			return 1;
+		}
+		uLong bound = deflateBound(&strm, static_cast<uLong>(inSize));
+		auto buf = static_cast<unsigned char *>(malloc(bound));
+		if (buf == nullptr) {
+			deflateEnd(&strm);
+			return 1;
+		}
+
+		strm.next_in = const_cast<Bytef *>(in);
+		strm.avail_in = static_cast<uInt>(inSize);
+		strm.next_out = buf;
+		strm.avail_out = static_cast<uInt>(bound);
+		int ret = deflate(&strm, Z_FINISH);
+		size_t written = strm.total_out;
+		deflateEnd(&strm);
+
+		if (ret != Z_STREAM_END) {
+			free(buf);
+			return 1;
+		}
+		*out = buf;
+		*outSize = written;
+		return 0;
+	}
+
+	void optimizePngs(const vector<vector<uint8_t> *> &pngs) {
+
+		vector<Image> images(pngs.size());
+		parallelFor(pngs.size(), [&](size_t i) {
+			try {
+				images[i] = analyze(*pngs[i]);
+			} catch (const exception &) {}
+		});
+
+		vector<Job> jobs;
+		for (size_t i = 0; i < images.size(); ++i) {
+			if (!images[i].valid) {
+				continue;
+			}
+			for (const auto &mode : colorModes(images[i])) {
+				for (auto filter : filterStrategies) {
+					for (const auto &zs : zlibSettings) {
+						jobs.push_back({i, mode, filter, &zs});
+					}
+				}
+			}
+		}
+
+		// Smallest candidate of each image. Ties go to the first job so that
+		// the result doesn't depend on thread scheduling.
+		constexpr size_t none = numeric_limits<size_t>::max();
+		vector<vector<unsigned char>> best(pngs.size());
+		vector<size_t> bestJob(pngs.size(), none);
+		mutex m;
+
+		parallelFor(jobs.size(), [&](size_t j) {
+			try {
+				const Job &job = jobs[j];
+				vector<unsigned char> out;
+				if (!encode(images[job.image], job, out)) {
+					return;
+				}
+				lock_guard<mutex> lock(m);
+				size_t &bj = bestJob[job.image];
+				size_t current = (bj == none ? pngs[job.image]->size() : best[job.image].size());
+				if (out.size() < current || (bj != none && out.size() == current && j < bj)) {
+					best[job.image] = move(out);
+					bj = j;
+				}
+			} catch (const exception &) {}
+		});
+
+		for (size_t i = 0; i < pngs.size(); ++i) {
+			if (bestJob[i] != none) {
+				pngs[i]->assign(best[i].begin(), best[i].end());
+			}
+		}
+	}
+
+} // hf_workshop
@@ -0,0 +1,48 @@
+/**
+ * HF Workshop - PNG optimizer
+ */
+
+#ifndef PNG_OPTIMIZER_HPP
+#define PNG_OPTIMIZER_HPP
+
+#include <vector>
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t
+
+struct LodePNGCompressSettings;
+
+namespace hf_workshop {
+
+	/**
+	 * Re-encodes PNG files losslessly, keeping the smallest result.
+	 *
+	 * Each image is tried with the color types that can hold it without loss
+	 * (palette, grey, grey with alpha, RGB without alpha, RGBA), several filter
+	 * strategies and zlib settings. All candidates of all images are encoded
+	 * concurrently. A PNG is left as it is when no candidate is smaller, when
+	 * it has 16 bits per channel, or when it can't be decoded.
+	 *
+	 * Ancillary chunks (text, gamma, color profiles) are not kept.
+	 */
+	void optimizePngs(const std::vector<std::vector<uint8_t> *> &pngs);
+
+	inline void optimizePng(std::vector<uint8_t> &png) {
+		optimizePngs({&png});
+	}
+
+	struct PngZlibSettings {
+		int level;
+		int strategy;
+	};
+
+	/**
+	 * LodePNG `custom_zlib` callback that compresses with zlib, which is
+	 * faster than LodePNG's own deflate and lets the strategy be chosen.
+	 * `custom_context` must point to a PngZlibSettings.
+	 */
+	unsigned pngZlibCompress(unsigned char **out, size_t *outSize, const unsigned char *in,
+	                         size_t inSize, const LodePNGCompressSettings *settings);
+
+} // hf_workshop
+
+#endif // PNG_OPTIMIZER_HPP
@@ -0,0 +1,236 @@
+/**
+ * HF Workshop - Index of opened games
+ *
+ * An index is the key, the SWF version, the stage and data file IDs, the
+ * symbols by tag type and the tag records, in the byte order of the machine
+ * that wrote it. Entries are named after the hash of the path of the game.
+ */
+
+#include "swf_index.hpp"
+
+#include <cstring>      // memcpy, memcmp
+#include <exception>    // exception
+#include <filesystem>   // path, absolute, file_size, last_write_time
+#include <stdexcept>    // runtime_error
+#include <system_error> // error_code
+
+#include "compression_cache.hpp"
+#include "io_wrapper.hpp" // writeBinaryFile
+#include "mapped_file.hpp"
+#include "swf_tags.hpp"
+#include "xxhash.hpp"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace hf_workshop {
+
+	namespace {
+
+		constexpr char MAGIC[8] = {'H', 'F', 'W', 'I', 'N', 'D', 'X', '2'};
+		constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+		class IndexWriter {
+		public:
+			vector<uint8_t> out;
+
+			IndexWriter() : out() {}
+
+			template<typename T>
+			void put(const T &value) {
+				size_t at = out.size();
+				out.resize(at + sizeof(T));
+				memcpy(out.data() + at, &value, sizeof(T));
+			}
+
+			void putString(const string &s) {
+				put(static_cast<uint32_t>(s.size()));
+				out.insert(out.end(), s.begin(), s.end());
+			}
+		};
+
+		class IndexReader {
+		public:
+			IndexReader(const uint8_t *_data, size_t _size) : data(_data), size(_size), pos(0) {}
+
+			template<typename T>
+			T get() {
+				check(sizeof(T));
+				T value;
+				memcpy(&value, data + pos, sizeof(T));
+				pos += sizeof(T);
+				return value;
+			}
+
+			string getString() {
+				auto length = get<uint32_t>();
+				check(length);
+				string s(reinterpret_cast<const char *>(data + pos), length);
+				pos += length;
+				return s;
+			}
+
+			bool atEnd() const { return pos == size; }
+
+		private:
+			const uint8_t *data;
+			size_t size;
+			size_t pos;
+
+			void check(size_t length) const {
+				if (length > size - pos) {
+					throw runtime_error("Index is truncated.");
+				}
+			}
+		};
+
+		void putIds(IndexWriter &w, const vector<size_t> &ids) {
+			w.put(static_cast<uint32_t>(ids.size()));
+			for (auto id : ids) {
+				w.put(static_cast<uint32_t>(id));
+			}
+		}
+
+		vector<size_t> getIds(IndexReader &r) {
+			auto count = r.get<uint32_t>();
+			vector<size_t> ids;
+			for (uint32_t i = 0; i < count; ++i) {
+				ids.emplace_back(r.get<uint32_t>());
+			}
+			return ids;
+		}
+
+	} // anonymous namespace
+
+	SwfIndex::SwfIndex() : key(), version(0), stageIds(), dataIds(), symbols(), tags() {}
+
+	SwfIndex::SwfIndex(SwfIndex &&) noexcept = default;
+
+	SwfIndex &SwfIndex::operator=(SwfIndex &&) noexcept = default;
+
+	SwfIndex::~SwfIndex() = default;
+
+	SwfIndexKey swfIndexKey(const string &filename, const vector<uint8_t> &contents) {
+		fs::path path(filename);
+		return {static_cast<uint64_t>(fs::file_size(path)),
+		        static_cast<int64_t>(fs::last_write_time(path).time_since_epoch().count()),
+		        xxh64(contents)};
+	}
+
+	vector<IndexedTag> indexSwfTags(const vector<uint8_t> &fws) {
+		try {
+			vector<IndexedTag> tags;
+			for (const TagRecord &t : scanTags(fws.data(), fws.size())) {
+				uint32_t id = definesCharacter(t.code) ? characterId(fws.data(), t) : IndexedTag::NO_ID;
+				tags.push_back({t, id});
+			}
+			return tags;
+		} catch (const exception &) {
+			return {};
+		}
+	}
+
+	string swfIndexPath(const string &filename) {
+		error_code ec;
+		fs::path absolute = fs::absolute(fs::path(filename), ec);
+		string key = ec ? filename : absolute.string();
+		fs::path directory = fs::path(CompressionCache::defaultDirectory()).parent_path() / "index";
+		return (directory / (hashToHex(xxh64(key.data(), key.size())) + ".idx")).string();
+	}
+
+	optional<SwfIndex> loadSwfIndex(const string &path, const SwfIndexKey &key) {
+		error_code ec;
+		if (!fs::exists(path, ec)) {
+			return nullopt;
+		}
+		try {
+			MappedFile file(path);
+			if (file.size() < sizeof(MAGIC) || memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0) {
+				return nullopt;
+			}
+			IndexReader r(file.data() + sizeof(MAGIC), file.size() - sizeof(MAGIC));
+			if (r.get<uint32_t>() != BYTE_ORDER_MARK) {
+				return nullopt;
+			}
+
+			SwfIndex index;
+			index.key.size = r.get<uint64_t>();
+			index.key.modified = r.get<int64_t>();
+			index.key.hash = r.get<uint64_t>();
+			if (!(index.key == key)) {
+				return nullopt;
+			}
+			index.version = r.get<int32_t>();
+			index.stageIds = getIds(r);
+			index.dataIds = getIds(r);
+
+			auto typeCount = r.get<uint32_t>();
+			for (uint32_t t = 0; t < typeCount; ++t) {
+				auto &symbols = index.symbols[r.get<int32_t>()];
+				auto count = r.get<uint32_t>();
+				for (uint32_t i = 0; i < count; ++i) {
+					auto id = r.get<uint32_t>();
+					symbols.push_back({id, r.getString()});
+				}
+			}
+
+			auto tagCount = r.get<uint32_t>();
+			for (uint32_t i = 0; i < tagCount; ++i) {
+				IndexedTag tag{};
+				tag.record.code = r.get<uint16_t>();
+				tag.id = r.get<uint32_t>();
+				tag.record.offset = r.get<uint64_t>();
+				tag.record.headerLength = r.get<uint8_t>();
+				tag.record.length = r.get<uint64_t>();
+				index.tags.emplace_back(tag);
+			}
+
+			if (!r.atEnd()) {
+				return nullopt;
+			}
+			return index;
+		} catch (const exception &) {
+			return nullopt;
+		}
+	}
+
+	void saveSwfIndex(const string &path, const SwfIndex &index) {
+		IndexWriter w;
+		w.out.assign(MAGIC, MAGIC + sizeof(MAGIC));
+		w.put(BYTE_ORDER_MARK);
+		w.put(index.key.size);
+		w.put(index.key.modified);
+		w.put(index.key.hash);
+		w.put(static_cast<int32_t>(index.version));
+		putIds(w, index.stageIds);
+		putIds(w, index.dataIds);
+
+		w.put(static_cast<uint32_t>(index.symbols.size()));
+		for (const auto &type : index.symbols) {
+			w.put(static_cast<int32_t>(type.first));
+			w.put(static_cast<uint32_t>(type.second.size()));
+			for (const auto &s : type.second) {
+				w.put(static_cast<uint32_t>(s.id));
+				w.putString(s.name);
+			}
+		}
+
+		w.put(static_cast<uint32_t>(index.tags.size()));
+		for (const auto &tag : index.tags) {
+			w.put(tag.record.code);
+			w.put(tag.id);
+			w.put(static_cast<uint64_t>(tag.record.offset));
+			w.put(static_cast<uint8_t>(tag.record.headerLength));
+			w.put(static_cast<uint64_t>(tag.record.length));
+		}
+
+		// The index is best effort, like the compression cache
+		error_code ec;
+		try {
+			fs::path entry(path);
+			fs::create_directories(entry.parent_path(), ec);
+			l18n::writeBinaryFile(path, w.out);
+		} catch (const exception &) {}
+	}
+
+} // hf_workshop
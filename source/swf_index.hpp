@@ -0,0 +1,87 @@
+/**
+ * HF Workshop - Index of opened games
+ *
+ * What HF Workshop learns from a game when opening it, kept on disk so that
+ * the next time the same file is opened the menus can be shown before
+ * libswf parses it.
+ */
+
+#ifndef SWF_INDEX_HPP
+#define SWF_INDEX_HPP
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include <cstdint> // uint8_t, uint16_t, uint32_t, uint64_t
+#include <cstddef> // size_t
+
+#include "swf_tags.hpp" // TagRecord
+
+namespace hf_workshop {
+
+	/// Identifies the contents of an opened file
+	struct SwfIndexKey {
+		uint64_t size;      // of the file
+		int64_t modified;   // time of the file
+		uint64_t hash;      // XXH64 of the game read from it
+
+		bool operator==(const SwfIndexKey &other) const {
+			return size == other.size && modified == other.modified && hash == other.hash;
+		}
+	};
+
+	/// A tag with a character ID and its symbol name, as libswf has it
+	struct IndexedSymbol {
+		size_t id;
+		std::string name;
+	};
+
+	/// A tag record of the uncompressed SWF
+	struct IndexedTag {
+		static constexpr uint32_t NO_ID = static_cast<uint32_t>(-1);
+
+		TagRecord record;
+		uint32_t id;  // character ID, NO_ID if the tag doesn't define one
+	};
+
+	struct SwfIndex {
+		SwfIndexKey key;
+		int version;
+		std::vector<size_t> stageIds;
+		std::vector<size_t> dataIds;
+		std::map<int, std::vector<IndexedSymbol>> symbols;  // libswf tag type -> tags of that type
+		std::vector<IndexedTag> tags;
+
+		SwfIndex();
+		SwfIndex(SwfIndex &&) noexcept;
+		SwfIndex &operator=(SwfIndex &&) noexcept;
+		~SwfIndex();
+	};
+
+	/**
+	 * Key of a file, `contents` being the game read from it (the SWF inside
+	 * an APK). Throws std::filesystem::filesystem_error if the file can't be
+	 * inspected.
+	 */
+	SwfIndexKey swfIndexKey(const std::string &filename, const std::vector<uint8_t> &contents);
+
+	/// Tag records of an uncompressed ('FWS') SWF, empty if it can't be scanned
+	std::vector<IndexedTag> indexSwfTags(const std::vector<uint8_t> &fws);
+
+	/**
+	 * Entry of a file in the per-user index directory:
+	 * %LOCALAPPDATA%\hfworkshop\index on Windows,
+	 * $XDG_CACHE_HOME/hfworkshop/index or ~/.cache/hfworkshop/index elsewhere.
+	 */
+	std::string swfIndexPath(const std::string &filename);
+
+	/// Reads an index, nullopt if there's none, it's corrupted or it's for another key
+	std::optional<SwfIndex> loadSwfIndex(const std::string &path, const SwfIndexKey &key);
+
+	/// Writes an index, replacing the previous one only once it's complete. Errors are ignored.
+	void saveSwfIndex(const std::string &path, const SwfIndex &index);
+
+} // hf_workshop
+
+#endif // SWF_INDEX_HPP
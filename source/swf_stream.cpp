@@ -0,0 +1,217 @@
+/**
+ * HF Workshop - Streaming export of SWF files
+ */
+
+#include "swf_stream.hpp"
+
+#include <algorithm> // min
+#include <limits>    // numeric_limits
+#include <memory>    // make_unique
+#include <optional>
+#include <stdexcept> // runtime_error
+
+#ifdef __linux__
+	#include <fcntl.h>  // open
+	#include <unistd.h> // copy_file_range, close
+#endif
+
+#include "mapped_file.hpp"
+
+// Because of libintl conflict with json, this header must come last
+#include "io_wrapper.hpp" // AtomicFile
+
+using namespace std;
+
+namespace hf_workshop {
+
+	FileSink::FileSink(const string &filename) : out(make_unique<l18n::AtomicFile>(filename)), written(0) {}
+
+	FileSink::~FileSink() = default;
+
+	void FileSink::commit(bool sync) {
+		out->commit(sync);
+	}
+
+	void FileSink::write(const uint8_t *data, size_t size) {
+		if (size > 0 && fwrite(data, 1, size, out->get()) != size) {
+			throw runtime_error("Error writing file: fwrite");
+		}
+		written += size;
+	}
+
+	void FileSink::finish() {
+		if (fflush(out->get()) != 0 || ferror(out->get())) {
+			throw runtime_error("Error writing file: fflush");
+		}
+	}
+
+	void FileSink::copyFrom(const string &filename, size_t offset, size_t length) {
+	#ifdef __linux__
+		FILE *file = out->get();
+		int in = open(filename.c_str(), O_RDONLY);
+		if (in >= 0 && fflush(file) == 0) {
+			loff_t from = static_cast<loff_t>(offset);
+			size_t copied = 0;
+			while (copied < length) {
+				ssize_t n = copy_file_range(in, &from, fileno(file), nullptr, length - copied, 0);
+				if (n <= 0) {
+					// Not supported between these files, or the file is short: the rest is written below
+					break;
+				}
+				copied += static_cast<size_t>(n);
+			}
+			close(in);
+			written += copied;
+			offset += copied;
+			length -= copied;
+			// The stream's position is behind the descriptor's
+			if (fseek(file, 0, SEEK_END) != 0) {
+				throw runtime_error("Error writing file: fseek");
+			}
+		} else if (in >= 0) {
+			close(in);
+		}
+		if (length == 0) {
+			return;
+		}
+	#endif
+		MappedFile source(filename);
+		if (offset > source.size() || length > source.size() - offset) {
+			throw runtime_error("File is shorter than expected: " + filename);
+		}
+		write(source.data() + offset, length);
+	}
+
+	void FileSink::patch(size_t offset, const uint8_t *data, size_t size) {
+		FILE *file = out->get();
+		if (offset + size > written || offset > static_cast<size_t>(numeric_limits<long>::max())) {
+			throw runtime_error("Error writing file: patch past the end");
+		}
+		if (fseek(file, static_cast<long>(offset), SEEK_SET) != 0 || fwrite(data, 1, size, file) != size ||
+		    fseek(file, 0, SEEK_END) != 0 || fflush(file) != 0) {
+			throw runtime_error("Error writing file: fseek");
+		}
+	}
+
+	DeflateSink::DeflateSink(ByteSink &_next, int level, size_t chunkSize) : next(_next), stream(), chunk(chunkSize) {
+		if (deflateInit(&stream, level) != Z_OK) {
+			throw runtime_error("Error compressing: deflateInit");
+		}
+	}
+
+	DeflateSink::~DeflateSink() {
+		deflateEnd(&stream);
+	}
+
+	void DeflateSink::deflateInput(int flush) {
+		int ret;
+		do {
+			stream.next_out = chunk.data();
+			stream.avail_out = static_cast<uInt>(chunk.size());
+			ret = deflate(&stream, flush);
+			if (ret == Z_STREAM_ERROR) {
+				throw runtime_error("Error compressing: deflate");
+			}
+			next.write(chunk.data(), chunk.size() - stream.avail_out);
+		} while (stream.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+	}
+
+	void DeflateSink::write(const uint8_t *data, size_t size) {
+		while (size > 0) {
+			// avail_in is 32 bits wide
+			size_t n = min<size_t>(size, 1 << 30);
+			stream.next_in = const_cast<Bytef *>(data);
+			stream.avail_in = static_cast<uInt>(n);
+			deflateInput(Z_NO_FLUSH);
+			data += n;
+			size -= n;
+		}
+	}
+
+	void DeflateSink::finish() {
+		stream.next_in = nullptr;
+		stream.avail_in = 0;
+		deflateInput(Z_FINISH);
+		next.finish();
+	}
+
+	uint64_t streamSwf(const vector<uint8_t> &fws, const map<size_t, SharedBytes> &records, bool compress, FileSink &file) {
+
+		vector<TagRecord> tags = scanTags(fws.data(), fws.size());
+		uint64_t start = file.size();
+
+		// The length is patched in once the body has been written
+		uint8_t header[8] = {static_cast<uint8_t>(compress ? 'C' : 'F'), 'W', 'S', fws[3], 0, 0, 0, 0};
+		file.write(header, sizeof(header));
+
+		optional<DeflateSink> deflater;
+		if (compress) {
+			deflater.emplace(file);
+		}
+		ByteSink &body = deflater ? static_cast<ByteSink &>(*deflater) : static_cast<ByteSink &>(file);
+		uint64_t length = sizeof(header);
+		auto copy = [&](const uint8_t *data, size_t size) {
+			body.write(data, size);
+			length += size;
+		};
+
+		size_t copied = sizeof(header);
+		for (const auto &tag : tags) {
+			if (records.empty()) {
+				break;
+			}
+			if (!definesCharacter(tag.code)) {
+				continue;
+			}
+			auto it = records.find(characterId(fws.data(), tag));
+			if (it == records.end()) {
+				continue;
+			}
+			copy(fws.data() + copied, tag.offset - copied);
+			copy(it->second->data(), it->second->size());
+			copied = tag.end();
+		}
+		copy(fws.data() + copied, fws.size() - copied);
+		body.finish();
+
+		if (length > 0xFFFFFFFF) {
+			throw runtime_error("SWF file is too large.");
+		}
+		for (size_t i = 0; i < 4; ++i) {
+			header[4 + i] = static_cast<uint8_t>(length >> (8 * i));
+		}
+		file.patch(static_cast<size_t>(start) + 4, header + 4, 4);
+		return file.size() - start;
+	}
+
+	optional<size_t> projectorSize(const string &exeFile) {
+		MappedFile exe(exeFile);
+		size_t size = exe.size();
+		if (size < 8) {
+			return nullopt;
+		}
+		const uint8_t *footer = exe.data() + size - 8;
+		if (footer[0] != 0x56 || footer[1] != 0x34 || footer[2] != 0x12 || footer[3] != 0xFA) {
+			return nullopt;
+		}
+		size_t swfLength = static_cast<size_t>(footer[4]) | (static_cast<size_t>(footer[5]) << 8) |
+		                   (static_cast<size_t>(footer[6]) << 16) | (static_cast<size_t>(footer[7]) << 24);
+		if (swfLength + 8 > size) {
+			return nullopt;
+		}
+		return size - 8 - swfLength;
+	}
+
+	void streamExe(const string &projectorFile, size_t projectorLength, const vector<uint8_t> &fws,
+	               const map<size_t, SharedBytes> &records, bool compress, FileSink &file) {
+		file.copyFrom(projectorFile, 0, projectorLength);
+		uint64_t swfLength = streamSwf(fws, records, compress, file);
+		uint8_t footer[8] = {0x56, 0x34, 0x12, 0xFA, 0, 0, 0, 0};
+		for (size_t i = 0; i < 4; ++i) {
+			footer[4 + i] = static_cast<uint8_t>(swfLength >> (8 * i));
+		}
+		file.write(footer, sizeof(footer));
+		file.finish();
+	}
+
+} // hf_workshop
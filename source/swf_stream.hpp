@@ -0,0 +1,132 @@
+/**
+ * HF Workshop - Streaming export of SWF files
+ *
+ * Writes a game to a file as it's produced, so that neither the whole
+ * output nor its compressed copy is ever held in memory.
+ */
+
+#ifndef SWF_STREAM_HPP
+#define SWF_STREAM_HPP
+
+#include <map>
+#include <memory>  // unique_ptr
+#include <optional>
+#include <string>
+#include <vector>
+#include <cstdint> // uint8_t, uint64_t
+#include <cstddef> // size_t
+
+#include <zlib.h>
+
+#include "swf_tags.hpp" // SharedBytes
+
+namespace l18n {
+	class AtomicFile;
+}
+
+namespace hf_workshop {
+
+	/// Where exported bytes go, a chunk at a time
+	class ByteSink {
+	public:
+		virtual ~ByteSink() = default;
+
+		virtual void write(const uint8_t *data, size_t size) = 0;
+
+		/// Writes out what's still buffered, nothing is written after it
+		virtual void finish() = 0;
+	};
+
+	/**
+	 * Writes to a file as the bytes come. The file is only replaced once
+	 * it's committed (see l18n::AtomicFile).
+	 */
+	class FileSink : public ByteSink {
+	public:
+		/// Throws std::runtime_error if the file can't be created
+		explicit FileSink(const std::string &filename);
+		~FileSink() override;
+
+		FileSink(const FileSink &) = delete;
+		FileSink &operator=(const FileSink &) = delete;
+
+		void write(const uint8_t *data, size_t size) override;
+		void finish() override;
+
+		/**
+		 * Appends `length` bytes of another file from `offset`, without
+		 * reading them into memory: on Linux the kernel copies them, elsewhere
+		 * they're written from a mapping of the file. Throws
+		 * std::runtime_error if the file can't be read or is too short.
+		 */
+		void copyFrom(const std::string &filename, size_t offset, size_t length);
+
+		/// Overwrites bytes written before, `offset` bytes from the start of the file
+		void patch(size_t offset, const uint8_t *data, size_t size);
+
+		/// Bytes written so far
+		uint64_t size() const { return written; }
+
+		/// Replaces the file with what was written, with `sync` once it's on disk
+		void commit(bool sync = false);
+
+	private:
+		std::unique_ptr<l18n::AtomicFile> out;
+		uint64_t written;
+	};
+
+	/**
+	 * Deflates into another sink as a zlib stream, holding at most
+	 * `chunkSize` bytes of compressed output at once.
+	 */
+	class DeflateSink : public ByteSink {
+	public:
+		/// Throws std::runtime_error if zlib can't be initialized
+		explicit DeflateSink(ByteSink &next, int level = Z_BEST_COMPRESSION, size_t chunkSize = 1 << 16);
+		~DeflateSink() override;
+
+		DeflateSink(const DeflateSink &) = delete;
+		DeflateSink &operator=(const DeflateSink &) = delete;
+
+		void write(const uint8_t *data, size_t size) override;
+
+		/// Ends the zlib stream and finishes the next sink
+		void finish() override;
+
+	private:
+		ByteSink &next;
+		z_stream stream;
+		std::vector<uint8_t> chunk;
+
+		void deflateInput(int flush);
+	};
+
+	/**
+	 * Writes an uncompressed ('FWS') SWF to a file with the tag records of
+	 * some characters replaced, like replaceCharacterTags, deflated into a
+	 * 'CWS' SWF if `compress`. The records are copied one at a time and the
+	 * file length in the header is written last. Throws std::runtime_error
+	 * if the SWF is malformed, too large, or the file can't be written.
+	 * Returns the number of bytes written.
+	 */
+	uint64_t streamSwf(const std::vector<uint8_t> &fws, const std::map<size_t, SharedBytes> &records,
+	                   bool compress, FileSink &file);
+
+	/**
+	 * Size of the Flash Player projector at the start of an executable with
+	 * a SWF, nullopt if the file doesn't end with the projector footer:
+	 * 0xFA123456 and the SWF length, both little endian.
+	 */
+	std::optional<size_t> projectorSize(const std::string &exeFile);
+
+	/**
+	 * Writes an executable: the first `projectorLength` bytes of
+	 * `projectorFile` (see FileSink::copyFrom), the SWF as streamSwf writes
+	 * it, and the projector footer.
+	 */
+	void streamExe(const std::string &projectorFile, size_t projectorLength, const std::vector<uint8_t> &fws,
+	               const std::map<size_t, SharedBytes> &records, bool compress, FileSink &file);
+
+} // hf_workshop
+
+#endif // SWF_STREAM_HPP
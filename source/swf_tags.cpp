@@ -0,0 +1,209 @@
+/**
+ * HF Workshop - SWF tag scanner
+ */
+
+#include "swf_tags.hpp"
+
+#include <stdexcept> // runtime_error
+#include <string>
+
+#include "zlib_wrapper.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	size_t swfHeaderLength(const uint8_t *swf, size_t size) {
+		if (size < 9 || swf[0] != 'F' || swf[1] != 'W' || swf[2] != 'S') {
+			throw runtime_error("Not an uncompressed SWF file.");
+		}
+		// RECT: 5 bits for the number of bits of each of the 4 fields
+		size_t nBits = swf[8] >> 3;
+		size_t rectBytes = (5 + 4 * nBits + 7) / 8;
+		// Frame rate (2) + frame count (2)
+		size_t headerLength = 8 + rectBytes + 4;
+		if (headerLength > size) {
+			throw runtime_error("SWF header goes past the end of the file.");
+		}
+		return headerLength;
+	}
+
+	vector<uint8_t> uncompressedSwf(const vector<uint8_t> &swf) {
+		if (swf.size() < 8 || swf[1] != 'W' || swf[2] != 'S') {
+			throw runtime_error("Not an SWF file.");
+		}
+		if (swf[0] == 'F') {
+			return swf;
+		}
+		if (swf[0] != 'C') {
+			throw runtime_error("Not a zlib compressed SWF file.");
+		}
+		// The header stays the same but for the signature
+		vector<uint8_t> fws(swf.begin(), swf.begin() + 8);
+		fws[0] = 'F';
+		vector<uint8_t> body = zlib::zlib_decompress(vector<uint8_t>(swf.begin() + 8, swf.end()));
+		fws.insert(fws.end(), body.begin(), body.end());
+		return fws;
+	}
+
+	TagRecord readTagRecord(const uint8_t *data, size_t size, size_t pos) {
+		if (pos + 2 > size) {
+			throw runtime_error("Tag header at offset " + to_string(pos) + " goes past the end of the file.");
+		}
+		uint16_t codeAndLength = static_cast<uint16_t>(data[pos] | (data[pos+1] << 8));
+
+		TagRecord tag{};
+		tag.code = static_cast<uint16_t>(codeAndLength >> 6);
+		tag.offset = pos;
+		tag.headerLength = 2;
+		tag.length = codeAndLength & 0x3F;
+
+		// Long record header
+		if (tag.length == 0x3F) {
+			if (pos + 6 > size) {
+				throw runtime_error("Tag header at offset " + to_string(pos) + " goes past the end of the file.");
+			}
+			tag.headerLength = 6;
+			tag.length = static_cast<size_t>(data[pos+2]) | (static_cast<size_t>(data[pos+3]) << 8) |
+			             (static_cast<size_t>(data[pos+4]) << 16) | (static_cast<size_t>(data[pos+5]) << 24);
+		}
+
+		if (tag.end() > size) {
+			throw runtime_error("Tag at offset " + to_string(pos) + " goes past the end of the file.");
+		}
+		return tag;
+	}
+
+	vector<TagRecord> scanTags(const uint8_t *swf, size_t size) {
+
+		vector<TagRecord> tags;
+		size_t pos = swfHeaderLength(swf, size);
+
+		while (pos + 2 <= size) {
+			TagRecord tag = readTagRecord(swf, size, pos);
+			tags.emplace_back(tag);
+			pos = tag.end();
+
+			// End tag
+			if (tag.code == 0) {
+				break;
+			}
+		}
+
+		return tags;
+	}
+
+	bool definesCharacter(uint16_t code) {
+		switch (code) {
+			case 2:  // DefineShape
+			case 6:  // DefineBits
+			case 7:  // DefineButton
+			case 10: // DefineFont
+			case 11: // DefineText
+			case 14: // DefineSound
+			case 20: // DefineBitsLossless
+			case 21: // DefineBitsJPEG2
+			case 22: // DefineShape2
+			case 32: // DefineShape3
+			case 33: // DefineText2
+			case 34: // DefineButton2
+			case 35: // DefineBitsJPEG3
+			case 36: // DefineBitsLossless2
+			case 37: // DefineEditText
+			case 39: // DefineSprite
+			case 46: // DefineMorphShape
+			case 48: // DefineFont2
+			case 60: // DefineVideoStream
+			case 75: // DefineFont3
+			case 83: // DefineShape4
+			case 84: // DefineMorphShape2
+			case 87: // DefineBinaryData
+			case 90: // DefineBitsJPEG4
+			case 91: // DefineFont4
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	uint16_t characterId(const uint8_t *swf, const TagRecord &tag) {
+		if (tag.length < 2) {
+			throw runtime_error("Tag at offset " + to_string(tag.offset) + " is too short to have a character ID.");
+		}
+		size_t body = tag.bodyOffset();
+		return static_cast<uint16_t>(swf[body] | (swf[body+1] << 8));
+	}
+
+	vector<uint8_t> makeTagRecord(uint16_t code, const vector<uint8_t> &body) {
+		if (body.size() > 0xFFFFFFFF) {
+			throw runtime_error("Tag is too large.");
+		}
+		uint16_t codeAndLength = static_cast<uint16_t>((code << 6) | 0x3F);
+		uint32_t length = static_cast<uint32_t>(body.size());
+
+		vector<uint8_t> record;
+		record.reserve(6 + body.size());
+		record.emplace_back(static_cast<uint8_t>(codeAndLength));
+		record.emplace_back(static_cast<uint8_t>(codeAndLength >> 8));
+		for (int i = 0; i < 4; ++i) {
+			record.emplace_back(static_cast<uint8_t>(length >> (8 * i)));
+		}
+		record.insert(record.end(), body.begin(), body.end());
+		return record;
+	}
+
+	vector<uint8_t> makeBinaryDataRecord(uint16_t id, const vector<uint8_t> &data) {
+		vector<uint8_t> body;
+		body.reserve(6 + data.size());
+		body.emplace_back(static_cast<uint8_t>(id));
+		body.emplace_back(static_cast<uint8_t>(id >> 8));
+		body.insert(body.end(), 4, 0);
+		body.insert(body.end(), data.begin(), data.end());
+		return makeTagRecord(TAG_DEFINE_BINARY_DATA, body);
+	}
+
+	vector<uint8_t> binaryDataOfRecord(const vector<uint8_t> &record) {
+		// Header, character ID and reserved bytes
+		size_t headerLength = (record.size() >= 2 && (record[0] & 0x3F) == 0x3F) ? 6 : 2;
+		if (record.size() < headerLength + 6) {
+			throw runtime_error("DefineBinaryData record is too short.");
+		}
+		return vector<uint8_t>(record.begin() + static_cast<ptrdiff_t>(headerLength + 6), record.end());
+	}
+
+	vector<uint8_t> replaceCharacterTags(const vector<uint8_t> &fws, const map<size_t, SharedBytes> &records) {
+
+		if (records.empty()) {
+			return fws;
+		}
+
+		vector<TagRecord> tags = scanTags(fws.data(), fws.size());
+
+		vector<uint8_t> out;
+		out.reserve(fws.size());
+		size_t copied = 0;
+		for (const auto &tag : tags) {
+			if (!definesCharacter(tag.code)) {
+				continue;
+			}
+			auto it = records.find(characterId(fws.data(), tag));
+			if (it == records.end()) {
+				continue;
+			}
+			out.insert(out.end(), fws.begin() + static_cast<ptrdiff_t>(copied), fws.begin() + static_cast<ptrdiff_t>(tag.offset));
+			out.insert(out.end(), it->second->begin(), it->second->end());
+			copied = tag.end();
+		}
+		out.insert(out.end(), fws.begin() + static_cast<ptrdiff_t>(copied), fws.end());
+
+		if (out.size() > 0xFFFFFFFF) {
+			throw runtime_error("SWF file is too large.");
+		}
+		uint32_t fileLength = static_cast<uint32_t>(out.size());
+		for (int i = 0; i < 4; ++i) {
+			out[4 + static_cast<size_t>(i)] = static_cast<uint8_t>(fileLength >> (8 * i));
+		}
+		return out;
+	}
+
+} // hf_workshop
@@ -0,0 +1,103 @@
+/**
+ * HF Workshop - SWF tag scanner
+ *
+ * Locates the tag records inside an uncompressed SWF buffer without
+ * parsing their contents.
+ */
+
+#ifndef SWF_TAGS_HPP
+#define SWF_TAGS_HPP
+
+#include <vector>
+#include <map>
+#include <memory>  // shared_ptr
+#include <cstdint> // uint8_t, uint16_t
+#include <cstddef> // size_t
+
+namespace hf_workshop {
+
+	constexpr uint16_t TAG_DEFINE_BINARY_DATA = 87;
+
+	/// Bytes that several owners keep, such as a tag record; never modified once shared
+	using SharedBytes = std::shared_ptr<const std::vector<uint8_t>>;
+
+	/**
+	 * Position of a tag record inside an uncompressed SWF buffer.
+	 * Offsets are relative to the start of the buffer (the 'FWS' signature).
+	 */
+	struct TagRecord {
+		uint16_t code;
+		size_t offset;       // start of the record header
+		size_t headerLength; // 2 for short records, 6 for long records
+		size_t length;       // length of the tag body
+
+		inline size_t bodyOffset() const { return offset + headerLength; }
+		inline size_t end() const { return offset + headerLength + length; }
+	};
+
+	/**
+	 * Returns the length of the SWF header, that is, the offset of the
+	 * first tag record. The header has the signature, version, file length,
+	 * frame size (RECT), frame rate and frame count.
+	 */
+	size_t swfHeaderLength(const uint8_t *swf, size_t size);
+
+	/**
+	 * Returns a plain ('FWS') or zlib compressed ('CWS') SWF uncompressed.
+	 * Throws std::runtime_error for anything else, or if it can't be inflated.
+	 */
+	std::vector<uint8_t> uncompressedSwf(const std::vector<uint8_t> &swf);
+
+	/**
+	 * Reads the header of the tag record at `pos`, such as the start of a
+	 * record built by makeTagRecord. Throws std::runtime_error if the record
+	 * goes past `size`.
+	 */
+	TagRecord readTagRecord(const uint8_t *data, size_t size, size_t pos);
+
+	/**
+	 * Scans the tag records of an uncompressed ('FWS') SWF buffer.
+	 * Throws std::runtime_error if the buffer is not an uncompressed SWF
+	 * or if a record goes past the end of the buffer.
+	 */
+	std::vector<TagRecord> scanTags(const uint8_t *swf, size_t size);
+
+	/**
+	 * Whether tags with this code define a character, in which case their
+	 * body starts with the 16 bit character ID.
+	 */
+	bool definesCharacter(uint16_t code);
+
+	/**
+	 * Character ID of a tag for which definesCharacter() is true.
+	 */
+	uint16_t characterId(const uint8_t *swf, const TagRecord &tag);
+
+	/**
+	 * Builds a tag record with a long header.
+	 */
+	std::vector<uint8_t> makeTagRecord(uint16_t code, const std::vector<uint8_t> &body);
+
+	/**
+	 * Builds a DefineBinaryData tag record: the character ID, 4 reserved
+	 * bytes and the data.
+	 */
+	std::vector<uint8_t> makeBinaryDataRecord(uint16_t id, const std::vector<uint8_t> &data);
+
+	/**
+	 * The data of a DefineBinaryData tag record.
+	 * Throws std::runtime_error if it's too short.
+	 */
+	std::vector<uint8_t> binaryDataOfRecord(const std::vector<uint8_t> &record);
+
+	/**
+	 * Returns a copy of the uncompressed SWF `fws` where the records of the
+	 * characters in `records` (character ID -> complete tag record) are
+	 * replaced, and the file length in the header updated.
+	 */
+	std::vector<uint8_t> replaceCharacterTags(const std::vector<uint8_t> &fws,
+	                                          const std::map<size_t, SharedBytes> &records);
+
+} // hf_workshop
+
+#endif // SWF_TAGS_HPP
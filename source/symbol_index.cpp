@@ -0,0 +1,132 @@
+/**
+ * HF Workshop - Symbol index
+ */
+
+#include "symbol_index.hpp"
+
+#include <algorithm> // sort, lower_bound
+#include <regex>
+
+#include "utils.hpp" // wildcardMatch
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		/// Whether `s` starts with `prefix`, for the binary searches
+		bool hasPrefix(string_view s, string_view prefix) {
+			return s.substr(0, prefix.size()) == prefix;
+		}
+
+		/// IDs of the entries at the given indices, in name order
+		vector<size_t> idsOf(const vector<SymbolEntry> &entries, vector<size_t> indices) {
+			sort(indices.begin(), indices.end());
+			vector<size_t> ids;
+			ids.reserve(indices.size());
+			for (auto i : indices) {
+				ids.push_back(entries[i].id);
+			}
+			return ids;
+		}
+
+	} // anonymous namespace
+
+	SymbolIndex::SymbolIndex(vector<SymbolEntry> entries) : byName(move(entries)), byReversedName() {
+		sort(byName.begin(), byName.end(), [](const SymbolEntry &a, const SymbolEntry &b) {
+			return a.name != b.name ? a.name < b.name : a.id < b.id;
+		});
+		byReversedName.reserve(byName.size());
+		for (size_t i = 0; i < byName.size(); ++i) {
+			byReversedName.emplace_back(string(byName[i].name.rbegin(), byName[i].name.rend()), i);
+		}
+		sort(byReversedName.begin(), byReversedName.end());
+	}
+
+	vector<const SymbolEntry *> SymbolIndex::ofType(int type) const {
+		vector<const SymbolEntry *> entries;
+		for (const auto &e : byName) {
+			if (e.type == type) {
+				entries.push_back(&e);
+			}
+		}
+		return entries;
+	}
+
+	pair<size_t, size_t> SymbolIndex::prefixRange(string_view prefix) const {
+		auto first = lower_bound(byName.begin(), byName.end(), prefix,
+		                         [](const SymbolEntry &e, string_view p) { return string_view(e.name) < p; });
+		auto last = first;
+		while (last != byName.end() && hasPrefix(last->name, prefix)) {
+			++last;
+		}
+		return {static_cast<size_t>(first - byName.begin()), static_cast<size_t>(last - byName.begin())};
+	}
+
+	pair<size_t, size_t> SymbolIndex::suffixRange(string_view suffix) const {
+		string reversed(suffix.rbegin(), suffix.rend());
+		auto first = lower_bound(byReversedName.begin(), byReversedName.end(), reversed,
+		                         [](const pair<string, size_t> &e, const string &r) { return e.first < r; });
+		auto last = first;
+		while (last != byReversedName.end() && hasPrefix(last->first, reversed)) {
+			++last;
+		}
+		return {static_cast<size_t>(first - byReversedName.begin()), static_cast<size_t>(last - byReversedName.begin())};
+	}
+
+	vector<size_t> SymbolIndex::glob(const string &pattern) const {
+		size_t firstWildcard = pattern.find_first_of("*?");
+		if (firstWildcard == string::npos) {
+			auto range = prefixRange(pattern);
+			vector<size_t> ids;
+			for (size_t i = range.first; i < range.second && byName[i].name == pattern; ++i) {
+				ids.push_back(byName[i].id);
+			}
+			return ids;
+		}
+		size_t lastWildcard = pattern.find_last_of("*?");
+
+		// The candidates are the names with the literal prefix or the ones with the literal suffix
+		auto prefix = prefixRange(string_view(pattern).substr(0, firstWildcard));
+		auto suffix = suffixRange(string_view(pattern).substr(lastWildcard + 1));
+		vector<size_t> indices;
+		if (prefix.second - prefix.first <= suffix.second - suffix.first) {
+			for (size_t i = prefix.first; i < prefix.second; ++i) {
+				if (wildcardMatch(pattern, byName[i].name)) {
+					indices.push_back(i);
+				}
+			}
+		} else {
+			for (size_t i = suffix.first; i < suffix.second; ++i) {
+				size_t e = byReversedName[i].second;
+				if (wildcardMatch(pattern, byName[e].name)) {
+					indices.push_back(e);
+				}
+			}
+		}
+		return idsOf(byName, move(indices));
+	}
+
+	vector<size_t> SymbolIndex::regex(const string &pattern) const {
+		std::regex re(pattern, regex_constants::ECMAScript | regex_constants::optimize);
+		vector<size_t> ids;
+		for (const auto &e : byName) {
+			if (regex_match(e.name, re)) {
+				ids.push_back(e.id);
+			}
+		}
+		return ids;
+	}
+
+	SymbolIndex symbolIndexOf(const map<int, vector<IndexedSymbol>> &symbols) {
+		vector<SymbolEntry> entries;
+		for (const auto &type : symbols) {
+			for (const auto &s : type.second) {
+				entries.push_back({s.name, s.id, type.first});
+			}
+		}
+		return SymbolIndex(move(entries));
+	}
+
+} // hf_workshop
@@ -0,0 +1,71 @@
+/**
+ * HF Workshop - Symbol index
+ *
+ * The symbol names of the tags of a game, sorted once when it's opened, so
+ * that tags can be listed in name order and picked by name patterns.
+ */
+
+#ifndef SYMBOL_INDEX_HPP
+#define SYMBOL_INDEX_HPP
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility> // pair
+#include <vector>
+#include <cstddef> // size_t
+
+#include "swf_index.hpp" // IndexedSymbol
+
+namespace hf_workshop {
+
+	struct SymbolEntry {
+		std::string name;
+		size_t id;
+		int type;  // libswf tag type
+	};
+
+	/**
+	 * Tags by symbol name, and by symbol name read backwards, so that names
+	 * with a given prefix or suffix are found with a binary search.
+	 */
+	class SymbolIndex {
+	public:
+		SymbolIndex() : byName(), byReversedName() {}
+		explicit SymbolIndex(std::vector<SymbolEntry> entries);
+
+		/// All the tags, sorted by name and then ID
+		const std::vector<SymbolEntry> &entries() const { return byName; }
+
+		/// The tags of a type, sorted by name and then ID
+		std::vector<const SymbolEntry *> ofType(int type) const;
+
+		/**
+		 * IDs of the tags whose names match a pattern where * is any run of
+		 * characters and ? any character, in name order. Only the names with
+		 * the pattern's literal prefix or suffix, whichever are fewer, are
+		 * checked.
+		 */
+		std::vector<size_t> glob(const std::string &pattern) const;
+
+		/**
+		 * IDs of the tags whose whole names match an ECMAScript regular
+		 * expression, in name order. All the names are checked. Throws
+		 * std::regex_error if the expression is malformed.
+		 */
+		std::vector<size_t> regex(const std::string &pattern) const;
+
+	private:
+		std::vector<SymbolEntry> byName;
+		std::vector<std::pair<std::string, size_t>> byReversedName;  // reversed name, index in byName
+
+		std::pair<size_t, size_t> prefixRange(std::string_view prefix) const;
+		std::pair<size_t, size_t> suffixRange(std::string_view suffix) const;
+	};
+
+	/// Index of the symbols of an SwfIndex, by libswf tag type
+	SymbolIndex symbolIndexOf(const std::map<int, std::vector<IndexedSymbol>> &symbols);
+
+} // hf_workshop
+
+#endif // SYMBOL_INDEX_HPP
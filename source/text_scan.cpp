@@ -0,0 +1,261 @@
+/**
+ * HF Workshop - Text scanning
+ *
+ * The runs of plain characters are found 16 bytes at a time with SSE2 and
+ * NEON, and 32 at a time with AVX2 (chosen at runtime). The scalar version
+ * does the rest and the special characters themselves.
+ */
+
+#include "text_scan.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+	#define HFW_SSE2 1
+	#include <immintrin.h>
+	#if defined(__GNUC__)
+		#define HFW_AVX2 1
+	#elif defined(_MSC_VER)
+		#include <intrin.h> // _BitScanForward
+	#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#define HFW_NEON 1
+	#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		inline bool jsonPlain(uint8_t c) {
+			return c >= 0x20 && c < 0x7F && c != '"' && c != '\\';
+		}
+
+		size_t jsonPlainRunScalar(const uint8_t *s, size_t n) {
+			size_t i = 0;
+			while (i < n && jsonPlain(s[i])) {
+				++i;
+			}
+			return i;
+		}
+
+		size_t asciiRunScalar(const uint8_t *s, size_t n) {
+			size_t i = 0;
+			while (i < n && s[i] < 0x80) {
+				++i;
+			}
+			return i;
+		}
+
+	#ifdef HFW_SSE2
+
+		/// Index of the lowest set bit of a mask that isn't 0
+		inline size_t lowestBit(unsigned mask) {
+		#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return index;
+		#else
+			return static_cast<size_t>(__builtin_ctz(mask));
+		#endif
+		}
+
+		/*
+		 * A byte is special if it's '"', '\\' or DEL, or if it's below 0x20
+		 * as a signed byte, which catches the control characters and all the
+		 * bytes from 0x80 up.
+		 */
+		inline int jsonSpecialMaskSse2(__m128i v) {
+			__m128i special = _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(0x20)),
+			                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+			                  _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\')),
+			                               _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)))));
+			return _mm_movemask_epi8(special);
+		}
+
+		/// Returns the number of bytes done: up to the first special one, or the whole blocks
+		size_t jsonPlainRunSse2(const uint8_t *s, size_t n) {
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				int mask = jsonSpecialMaskSse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i)));
+				if (mask != 0) {
+					return i + lowestBit(static_cast<unsigned>(mask));
+				}
+			}
+			return i;
+		}
+
+		size_t asciiRunSse2(const uint8_t *s, size_t n) {
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i)));
+				if (mask != 0) {
+					return i + lowestBit(static_cast<unsigned>(mask));
+				}
+			}
+			return i;
+		}
+
+	#endif // HFW_SSE2
+
+	#ifdef HFW_AVX2
+
+		bool hasAvx2() {
+			static const bool avx2 = __builtin_cpu_supports("avx2");
+			return avx2;
+		}
+
+		__attribute__((target("avx2")))
+		size_t jsonPlainRunAvx2(const uint8_t *s, size_t n) {
+			size_t i = 0;
+			for (; i + 32 <= n; i += 32) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+				__m256i special = _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v),
+				                  _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+				                  _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')),
+				                                  _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F)))));
+				auto mask = static_cast<unsigned>(_mm256_movemask_epi8(special));
+				if (mask != 0) {
+					return i + lowestBit(mask);
+				}
+			}
+			return i;
+		}
+
+		__attribute__((target("avx2")))
+		size_t asciiRunAvx2(const uint8_t *s, size_t n) {
+			size_t i = 0;
+			for (; i + 32 <= n; i += 32) {
+				auto mask = static_cast<unsigned>(_mm256_movemask_epi8(
+					_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i))));
+				if (mask != 0) {
+					return i + lowestBit(mask);
+				}
+			}
+			return i;
+		}
+
+	#endif // HFW_AVX2
+
+	#ifdef HFW_NEON
+
+		// NEON has no movemask, so a block with a special byte is left to the scalar version
+
+		size_t jsonPlainRunNeon(const uint8_t *s, size_t n) {
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				uint8x16_t v = vld1q_u8(s + i);
+				uint8x16_t special = vorrq_u8(vorrq_u8(vcltq_u8(v, vdupq_n_u8(0x20)), vcgeq_u8(v, vdupq_n_u8(0x7F))),
+				                              vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\\'))));
+				if (vmaxvq_u8(special) != 0) {
+					break;
+				}
+			}
+			return i;
+		}
+
+		size_t asciiRunNeon(const uint8_t *s, size_t n) {
+			size_t i = 0;
+			for (; i + 16 <= n; i += 16) {
+				if (vmaxvq_u8(vld1q_u8(s + i)) >= 0x80) {
+					break;
+				}
+			}
+			return i;
+		}
+
+	#endif // HFW_NEON
+
+	} // anonymous namespace
+
+	size_t jsonPlainRun(const char *str, size_t n) {
+		const auto *s = reinterpret_cast<const uint8_t *>(str);
+		size_t done = 0;
+	#if defined(HFW_AVX2)
+		done = hasAvx2() ? jsonPlainRunAvx2(s, n) : jsonPlainRunSse2(s, n);
+	#elif defined(HFW_SSE2)
+		done = jsonPlainRunSse2(s, n);
+	#elif defined(HFW_NEON)
+		done = jsonPlainRunNeon(s, n);
+	#endif
+		return done + jsonPlainRunScalar(s + done, n - done);
+	}
+
+	size_t asciiRun(const uint8_t *s, size_t n) {
+		size_t done = 0;
+	#if defined(HFW_AVX2)
+		done = hasAvx2() ? asciiRunAvx2(s, n) : asciiRunSse2(s, n);
+	#elif defined(HFW_SSE2)
+		done = asciiRunSse2(s, n);
+	#elif defined(HFW_NEON)
+		done = asciiRunNeon(s, n);
+	#endif
+		return done + asciiRunScalar(s + done, n - done);
+	}
+
+	size_t decodeUtf8(const uint8_t *s, size_t n, uint32_t &codePoint) {
+		if (n == 0) {
+			return 0;
+		}
+		uint8_t c = s[0];
+		if (c < 0x80) {
+			codePoint = c;
+			return 1;
+		}
+
+		size_t len;
+		uint32_t cp;
+		uint8_t low = 0x80, high = 0xBF;  // range of the second byte
+		if (c >= 0xC2 && c <= 0xDF) {
+			len = 2;
+			cp = c & 0x1Fu;
+		} else if (c >= 0xE0 && c <= 0xEF) {
+			len = 3;
+			cp = c & 0x0Fu;
+			if (c == 0xE0) {
+				low = 0xA0;   // overlong
+			} else if (c == 0xED) {
+				high = 0x9F;  // surrogates
+			}
+		} else if (c >= 0xF0 && c <= 0xF4) {
+			len = 4;
+			cp = c & 0x07u;
+			if (c == 0xF0) {
+				low = 0x90;   // overlong
+			} else if (c == 0xF4) {
+				high = 0x8F;  // past U+10FFFF
+			}
+		} else {
+			return 0;
+		}
+
+		if (n < len || s[1] < low || s[1] > high) {
+			return 0;
+		}
+		for (size_t i = 1; i < len; ++i) {
+			if ((s[i] & 0xC0) != 0x80) {
+				return 0;
+			}
+			cp = (cp << 6) | (s[i] & 0x3Fu);
+		}
+		codePoint = cp;
+		return len;
+	}
+
+	bool isValidUtf8(const uint8_t *s, size_t n) {
+		size_t i = 0;
+		while (true) {
+			i += asciiRun(s + i, n - i);
+			if (i == n) {
+				return true;
+			}
+			uint32_t codePoint;
+			size_t len = decodeUtf8(s + i, n - i, codePoint);
+			if (len == 0) {
+				return false;
+			}
+			i += len;
+		}
+	}
+
+} // hf_workshop
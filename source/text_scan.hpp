@@ -0,0 +1,34 @@
+/**
+ * HF Workshop - Text scanning
+ */
+
+#ifndef TEXT_SCAN_HPP
+#define TEXT_SCAN_HPP
+
+#include <cstddef> // size_t
+#include <cstdint> // uint8_t, uint32_t
+
+namespace hf_workshop {
+
+	/**
+	 * Length of the run at the start of `s` that a JSON string holds as it
+	 * is: ASCII characters other than control characters, DEL, '"' and '\\'.
+	 */
+	size_t jsonPlainRun(const char *s, size_t n);
+
+	/// Length of the run of ASCII characters at the start of `s`
+	size_t asciiRun(const uint8_t *s, size_t n);
+
+	/**
+	 * Decodes the UTF-8 character at the start of `s` into `codePoint`,
+	 * returning its length in bytes, or 0 if it's invalid: truncated,
+	 * overlong, a surrogate or past U+10FFFF.
+	 */
+	size_t decodeUtf8(const uint8_t *s, size_t n, uint32_t &codePoint);
+
+	/// True if `s` is valid UTF-8, as decodeUtf8 reads it
+	bool isValidUtf8(const uint8_t *s, size_t n);
+
+} // hf_workshop
+
+#endif // TEXT_SCAN_HPP
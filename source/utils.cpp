@@ -56,6 +56,30 @@ bool endsWith(const std::string& str, const std::string& suffix) {
 	return str.size() >= suffix.size() &&
 	    str.compare(str.size()-suffix.size(), suffix.size(), suffix) == 0;
 }
+
+bool wildcardMatch(const std::string& pattern, const std::string& str) {
+	// On a mismatch, the last * takes one more character
+	size_t p = 0, s = 0, star = std::string::npos, resume = 0;
+	while (s < str.size()) {
+		if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == str[s])) {
+			++p;
+			++s;
+		} else if (p < pattern.size() && pattern[p] == '*') {
+			star = p++;
+			resume = s;
+		} else if (star != std::string::npos) {
+			p = star + 1;
+			s = ++resume;
+		} else {
+			return false;
+		}
+	}
+	while (p < pattern.size() && pattern[p] == '*') {
+		++p;
+	}
+	return p == pattern.size();
+}
+
 bool replace(std::string& str, const std::string& from, const std::string& to) {
 	size_t start_pos = str.find(from);
 	if(start_pos == std::string::npos)
@@ -59,6 +59,12 @@ bool endsWith(const std::string& str, const std::string& suffix);
  */
 bool startsWith(const std::string& str, const std::string& prefix);
 
+/**
+ * Checks if string matches a pattern where * is any run of characters
+ * and ? is any character, case sensitive
+ */
+bool wildcardMatch(const std::string& pattern, const std::string& str);
+
 /**
  * Replaces a substring in a string.
  */
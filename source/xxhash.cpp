@@ -0,0 +1,117 @@
+/**
+ * HF Workshop - xxHash
+ */
+
+#include "xxhash.hpp"
+
+using namespace std;
+
+namespace hf_workshop {
+
+	namespace {
+
+		constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+		constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+		constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+		constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+		constexpr uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+		inline uint64_t rotl(uint64_t x, int r) {
+			return (x << r) | (x >> (64 - r));
+		}
+
+		// Little-endian reads
+		inline uint64_t read64(const uint8_t *p) {
+			uint64_t v = 0;
+			for (int i = 7; i >= 0; --i) {
+				v = (v << 8) | p[i];
+			}
+			return v;
+		}
+		inline uint64_t read32(const uint8_t *p) {
+			return static_cast<uint64_t>(p[0]) | (static_cast<uint64_t>(p[1]) << 8) |
+			       (static_cast<uint64_t>(p[2]) << 16) | (static_cast<uint64_t>(p[3]) << 24);
+		}
+
+		inline uint64_t round(uint64_t acc, uint64_t input) {
+			acc += input * prime2;
+			acc = rotl(acc, 31);
+			return acc * prime1;
+		}
+
+		inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+			acc ^= round(0, val);
+			return acc * prime1 + prime4;
+		}
+
+	} // anonymous namespace
+
+	uint64_t xxh64(const void *data, size_t len, uint64_t seed) {
+
+		const uint8_t *p = static_cast<const uint8_t *>(data);
+		const uint8_t *end = p + len;
+		uint64_t h;
+
+		if (len >= 32) {
+			uint64_t v1 = seed + prime1 + prime2;
+			uint64_t v2 = seed + prime2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - prime1;
+
+			const uint8_t *limit = end - 32;
+			do {
+				v1 = round(v1, read64(p));
+				v2 = round(v2, read64(p + 8));
+				v3 = round(v3, read64(p + 16));
+				v4 = round(v4, read64(p + 24));
+				p += 32;
+			} while (p <= limit);
+
+			h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+			h = mergeRound(h, v1);
+			h = mergeRound(h, v2);
+			h = mergeRound(h, v3);
+			h = mergeRound(h, v4);
+		} else {
+			h = seed + prime5;
+		}
+
+		h += static_cast<uint64_t>(len);
+
+		while (p + 8 <= end) {
+			h ^= round(0, read64(p));
+			h = rotl(h, 27) * prime1 + prime4;
+			p += 8;
+		}
+		if (p + 4 <= end) {
+			h ^= read32(p) * prime1;
+			h = rotl(h, 23) * prime2 + prime3;
+			p += 4;
+		}
+		while (p < end) {
+			h ^= *p * prime5;
+			h = rotl(h, 11) * prime1;
+			++p;
+		}
+
+		// Avalanche
+		h ^= h >> 33;
+		h *= prime2;
+		h ^= h >> 29;
+		h *= prime3;
+		h ^= h >> 32;
+
+		return h;
+	}
+
+	string hashToHex(uint64_t hash) {
+		static const char digits[] = "0123456789abcdef";
+		string s(16, '0');
+		for (int i = 15; i >= 0; --i) {
+			s[static_cast<size_t>(i)] = digits[hash & 0xF];
+			hash >>= 4;
+		}
+		return s;
+	}
+
+} // hf_workshop
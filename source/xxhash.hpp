@@ -0,0 +1,34 @@
+/**
+ * HF Workshop - xxHash
+ *
+ * Implementation of the 64-bit xxHash algorithm (XXH64).
+ * Reference: https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+ */
+
+#ifndef XXHASH_HPP
+#define XXHASH_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint> // uint8_t, uint64_t
+#include <cstddef> // size_t
+
+namespace hf_workshop {
+
+	/**
+	 * Computes the XXH64 hash of a buffer.
+	 */
+	uint64_t xxh64(const void *data, size_t len, uint64_t seed = 0);
+
+	inline uint64_t xxh64(const std::vector<uint8_t> &data, uint64_t seed = 0) {
+		return xxh64(data.data(), data.size(), seed);
+	}
+
+	/**
+	 * Hexadecimal representation of a hash, always 16 characters long
+	 */
+	std::string hashToHex(uint64_t hash);
+
+} // hf_workshop
+
+#endif // XXHASH_HPP
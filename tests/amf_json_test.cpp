@@ -0,0 +1,151 @@
+/**
+ * HF Workshop - AMF to JSON test
+ *
+ * The JSON that AmfJsonWriter gives for AMF0 and AMF3 values like the ones
+ * in HF data files must be the text of libswf's to_json_str() for the same
+ * bytes, which is what exportData wrote before the writer.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstdint> // uint8_t
+#include <cstddef> // size_t
+
+#include "amf0.hpp"
+#include "amf3.hpp"
+#include "amf_json.hpp"
+
+using namespace std;
+using namespace hf_workshop;
+
+namespace {
+
+	int failures = 0;
+
+	void expect(const char *name, bool written, const string &out, const string &expected) {
+		if (!written) {
+			printf("FAIL %s: not written\n", name);
+			++failures;
+		} else if (out != expected) {
+			printf("FAIL %s:\n%s\n--- libswf ---\n%s\n", name, out.c_str(), expected.c_str());
+			++failures;
+		} else {
+			printf("ok   %s\n", name);
+		}
+	}
+
+	void append(vector<uint8_t> &v, const string &s) {
+		v.insert(v.end(), s.begin(), s.end());
+	}
+
+	/// AMF0 object key or string without its marker
+	void amf0Utf8(vector<uint8_t> &v, const string &s) {
+		v.push_back(static_cast<uint8_t>(s.size() >> 8));
+		v.push_back(static_cast<uint8_t>(s.size()));
+		append(v, s);
+	}
+
+	void amf0Number(vector<uint8_t> &v, const vector<uint8_t> &bigEndian) {
+		v.push_back(0x00);
+		v.insert(v.end(), bigEndian.begin(), bigEndian.end());
+	}
+
+	const vector<uint8_t> TWO = {0x40, 0x00, 0, 0, 0, 0, 0, 0};
+	const vector<uint8_t> ONE_AND_HALF = {0x3F, 0xF8, 0, 0, 0, 0, 0, 0};
+	const vector<uint8_t> MINUS_TEN = {0xC0, 0x24, 0, 0, 0, 0, 0, 0};
+	const vector<uint8_t> TENTH = {0x3F, 0xB9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9A};
+	const vector<uint8_t> HUGE_NUMBER = {0x7E, 0x37, 0xE4, 0x3C, 0x88, 0x00, 0x75, 0x9C};  // 1e300
+	const vector<uint8_t> TINY = {0x3E, 0x7A, 0xD7, 0xF2, 0x9A, 0xBC, 0xAF, 0x48};        // 1e-7
+	const vector<uint8_t> TWO_POW_53 = {0x43, 0x40, 0, 0, 0, 0, 0, 0};
+
+	void amf0Object() {
+		// Keys out of alphabetical order, to check that their order is kept
+		vector<uint8_t> v = {0x03};
+		amf0Utf8(v, "name");
+		v.push_back(0x02);
+		amf0Utf8(v, "Davis \"D\"\t\\/\xC3\xA9\x01\x1F\x7F");
+		amf0Utf8(v, "x");
+		amf0Number(v, TWO);
+		amf0Utf8(v, "b");
+		amf0Number(v, ONE_AND_HALF);
+		amf0Utf8(v, "a");
+		amf0Number(v, TENTH);
+		amf0Utf8(v, "list");
+		v.insert(v.end(), {0x0A, 0, 0, 0, 6});
+		amf0Number(v, MINUS_TEN);
+		amf0Number(v, HUGE_NUMBER);
+		amf0Number(v, TINY);
+		amf0Number(v, TWO_POW_53);
+		v.insert(v.end(), {0x01, 0x01});
+		v.push_back(0x05);
+		amf0Utf8(v, "empty");
+		v.insert(v.end(), {0x03, 0, 0, 0x09});
+		amf0Utf8(v, "none");
+		v.insert(v.end(), {0x0A, 0, 0, 0, 0});
+		amf0Utf8(v, "");
+		v.push_back(0x09);
+
+		AmfJsonWriter writer;
+		string out;
+		bool written = writer.writeAmf0(v.data(), v.size(), out);
+		expect("amf0 object", written, out, swf::AMF0{v.data()}.to_json_str());
+	}
+
+	void amf3Object() {
+		// Anonymous dynamic objects: the second one refers to the traits and
+		// the strings of the first
+		vector<uint8_t> v = {0x0A, 0x0B, 0x01};
+		v.push_back(0x05);
+		append(v, "id");
+		v.insert(v.end(), {0x04, 0xFF, 0xFF, 0xFF, 0xFF});  // -1
+		v.push_back(0x07);
+		append(v, "min");
+		v.insert(v.end(), {0x04, 0xC0, 0x80, 0x80, 0x00});  // -2^28
+		v.push_back(0x0B);
+		append(v, "parts");
+		v.insert(v.end(), {0x09, 0x09, 0x01});
+		v.push_back(0x05);
+		v.insert(v.end(), TWO.begin(), TWO.end());
+		v.push_back(0x05);
+		v.insert(v.end(), TENTH.begin(), TENTH.end());
+		v.insert(v.end(), {0x06, 0x07});
+		append(v, "\xC3\xA9\n");
+		v.insert(v.end(), {0x0A, 0x01});
+		v.insert(v.end(), {0x00, 0x04, 0x81, 0x00});  // "id": 128
+		v.insert(v.end(), {0x02, 0x06, 0x06});        // "min": the string "é\n" again
+		v.push_back(0x01);
+		v.push_back(0x03);
+		append(v, "a");
+		v.insert(v.end(), {0x09, 0x01, 0x01});  // empty array
+		v.push_back(0x01);
+
+		AmfJsonWriter writer;
+		string out;
+		size_t pos = 0;
+		bool written = writer.writeAmf3(v.data(), v.size(), pos, out);
+		size_t libswfPos = 0;
+		string expected = swf::AMF3{v.data(), libswfPos}.to_json_str();
+		expect("amf3 object", written, out, expected);
+		if (pos != libswfPos) {
+			printf("FAIL amf3 object: read %zu bytes, libswf %zu\n", pos, libswfPos);
+			++failures;
+		}
+	}
+
+	void unsupported() {
+		AmfJsonWriter writer;
+		string out;
+		const uint8_t amf0Date[] = {0x0B, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+		bool written = writer.writeAmf0(amf0Date, sizeof(amf0Date), out);
+		expect("amf0 date left to libswf", !written, "", "");
+	}
+
+} // anonymous namespace
+
+int main() {
+	amf0Object();
+	amf3Object();
+	unsupported();
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,309 @@
+/**
+ * HF Workshop - AMF0/AMF3 transcoder test
+ *
+ * AMF0 values like the ones in HF data files must come back unchanged from
+ * AMF3, and their AMF3 must number references the way AMF3 does, where
+ * dates take a slot of the reference table that they don't take in AMF0.
+ */
+
+#include <cstdio>
+#include <cstring> // memcpy
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstdint> // uint8_t, uint64_t
+#include <cstddef> // size_t
+
+#include "amf_transcoder.hpp"
+
+using namespace std;
+using namespace hf_workshop;
+
+namespace {
+
+	int failures = 0;
+
+	void printBytes(const vector<uint8_t> &bytes) {
+		for (uint8_t b : bytes) {
+			printf(" %02x", b);
+		}
+		printf("\n");
+	}
+
+	void expectThrown(const string &name, bool thrown) {
+		if (thrown) {
+			printf("ok   %s\n", name.c_str());
+		} else {
+			printf("FAIL %s: not rejected\n", name.c_str());
+			++failures;
+		}
+	}
+
+	void expect(const string &name, const vector<uint8_t> &out, const vector<uint8_t> &expected) {
+		if (out == expected) {
+			printf("ok   %s\n", name.c_str());
+			return;
+		}
+		printf("FAIL %s:", name.c_str());
+		printBytes(out);
+		printf("--- expected ---\n");
+		printBytes(expected);
+		++failures;
+	}
+
+	void append(vector<uint8_t> &v, const string &s) {
+		v.insert(v.end(), s.begin(), s.end());
+	}
+
+	/// AMF0 object key or string without its marker
+	void amf0Utf8(vector<uint8_t> &v, const string &s) {
+		v.push_back(static_cast<uint8_t>(s.size() >> 8));
+		v.push_back(static_cast<uint8_t>(s.size()));
+		append(v, s);
+	}
+
+	void amf0Number(vector<uint8_t> &v, double d) {
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof(bits));
+		v.push_back(0x00);
+		for (int shift = 56; shift >= 0; shift -= 8) {
+			v.push_back(static_cast<uint8_t>(bits >> shift));
+		}
+	}
+
+	void amf0String(vector<uint8_t> &v, const string &s) {
+		v.push_back(0x02);
+		amf0Utf8(v, s);
+	}
+
+	void amf0ObjectEnd(vector<uint8_t> &v) {
+		v.insert(v.end(), {0x00, 0x00, 0x09});
+	}
+
+	void amf0EcmaArray(vector<uint8_t> &v, uint8_t count) {
+		v.insert(v.end(), {0x08, 0, 0, 0, count});
+	}
+
+	const vector<uint8_t> AMF0_DATE = {0x0B, 0x42, 0x76, 0x3A, 0xE9, 0x5C, 0x80, 0x00, 0x00, 0x00, 0x00};
+
+	/// The AMF3 of an AMF0 value, and the AMF0 that comes back from it
+	vector<uint8_t> roundTrip(const string &name, const vector<uint8_t> &amf0, vector<uint8_t> &amf3) {
+		amf0ToAmf3(amf0.data(), amf0.size(), amf3);
+		vector<uint8_t> back;
+		size_t pos = 0;
+		amf3ToAmf0(amf3.data(), amf3.size(), pos, back);
+		if (pos != amf3.size()) {
+			printf("FAIL %s: read %zu bytes of %zu\n", name.c_str(), pos, amf3.size());
+			++failures;
+		}
+		return back;
+	}
+
+	/// Typed objects, traits and strings sent again, references and both kinds of ECMA arrays
+	void limbLikeValue() {
+		vector<uint8_t> v;
+		amf0EcmaArray(v, 7);
+		amf0Utf8(v, "0");
+		v.push_back(0x10);
+		amf0Utf8(v, "Point");
+		amf0Utf8(v, "x");
+		amf0Number(v, 1.0);
+		amf0Utf8(v, "y");
+		amf0Number(v, 1.5);
+		amf0ObjectEnd(v);
+		amf0Utf8(v, "1");
+		v.push_back(0x03);
+		amf0Utf8(v, "name");
+		amf0String(v, "a");
+		amf0Utf8(v, "tags");
+		amf0EcmaArray(v, 2);  // keys out of order, so associative
+		amf0Utf8(v, "1");
+		v.insert(v.end(), {0x01, 0x01});
+		amf0Utf8(v, "0");
+		v.push_back(0x05);
+		amf0ObjectEnd(v);
+		amf0ObjectEnd(v);
+		amf0Utf8(v, "2");
+		v.insert(v.end(), AMF0_DATE.begin(), AMF0_DATE.end());
+		amf0Utf8(v, "3");
+		v.push_back(0x10);
+		amf0Utf8(v, "Point");
+		amf0Utf8(v, "x");
+		amf0Number(v, -2.0);
+		amf0Utf8(v, "y");
+		amf0Number(v, 1e300);
+		amf0ObjectEnd(v);
+		amf0Utf8(v, "4");
+		v.insert(v.end(), {0x07, 0x00, 0x02});  // the anonymous object
+		amf0Utf8(v, "5");
+		v.insert(v.end(), {0x07, 0x00, 0x04});  // the second Point
+		amf0Utf8(v, "6");
+		v.insert(v.end(), {0x0C, 0x00, 0x01, 0x11, 0x70});  // 70000 characters
+		append(v, string(70000, 'x'));
+		amf0ObjectEnd(v);
+
+		vector<uint8_t> amf3;
+		expect("limb-like value round trip", roundTrip("limb-like value", v, amf3), v);
+	}
+
+	/**
+	 * The AMF0 reference table has the array and both objects, the AMF3 one
+	 * has the date too
+	 */
+	void referencesAfterDate() {
+		vector<uint8_t> v = {0x0A, 0, 0, 0, 4};
+		v.insert(v.end(), {0x03, 0x00, 0x00, 0x09});
+		v.insert(v.end(), AMF0_DATE.begin(), AMF0_DATE.end());
+		v.push_back(0x03);
+		amf0Utf8(v, "k");
+		amf0Number(v, 1.0);
+		amf0ObjectEnd(v);
+		v.insert(v.end(), {0x07, 0x00, 0x02});
+
+		vector<uint8_t> expected = {0x09, 0x09, 0x01};
+		expected.insert(expected.end(), {0x0A, 0x0B, 0x01, 0x01});
+		expected.insert(expected.end(), {0x08, 0x01});
+		expected.insert(expected.end(), AMF0_DATE.begin() + 1, AMF0_DATE.end() - 2);
+		expected.insert(expected.end(), {0x0A, 0x01, 0x03, 'k', 0x04, 0x01, 0x01});
+		expected.insert(expected.end(), {0x0A, 0x06});
+
+		// Strict arrays come back as ECMA arrays
+		vector<uint8_t> expectedBack;
+		amf0EcmaArray(expectedBack, 4);
+		amf0Utf8(expectedBack, "0");
+		expectedBack.insert(expectedBack.end(), {0x03, 0x00, 0x00, 0x09});
+		amf0Utf8(expectedBack, "1");
+		expectedBack.insert(expectedBack.end(), AMF0_DATE.begin(), AMF0_DATE.end());
+		amf0Utf8(expectedBack, "2");
+		expectedBack.push_back(0x03);
+		amf0Utf8(expectedBack, "k");
+		amf0Number(expectedBack, 1.0);
+		amf0ObjectEnd(expectedBack);
+		amf0Utf8(expectedBack, "3");
+		expectedBack.insert(expectedBack.end(), {0x07, 0x00, 0x02});
+		amf0ObjectEnd(expectedBack);
+
+		vector<uint8_t> amf3;
+		vector<uint8_t> back = roundTrip("references after a date", v, amf3);
+		expect("references after a date to AMF3", amf3, expected);
+		expect("references after a date back to AMF0", back, expectedBack);
+	}
+
+	void ecmaArrays() {
+		vector<uint8_t> dense;
+		amf0EcmaArray(dense, 2);
+		amf0Utf8(dense, "0");
+		amf0Number(dense, 268435455.0);
+		amf0Utf8(dense, "1");
+		amf0Number(dense, -268435456.0);
+		amf0ObjectEnd(dense);
+		vector<uint8_t> amf3;
+		vector<uint8_t> back = roundTrip("dense array", dense, amf3);
+		expect("dense array to AMF3", amf3, {0x09, 0x05, 0x01, 0x04, 0xBF, 0xFF, 0xFF, 0xFF, 0x04, 0xC0, 0x80, 0x80, 0x00});
+		expect("dense array back to AMF0", back, dense);
+
+		vector<uint8_t> associative;
+		amf0EcmaArray(associative, 2);
+		amf0Utf8(associative, "0");
+		amf0Number(associative, 268435456.0);
+		amf0Utf8(associative, "2");
+		amf0String(associative, "0");
+		amf0ObjectEnd(associative);
+		amf3.clear();
+		back = roundTrip("associative array", associative, amf3);
+		expect("associative array to AMF3", amf3,
+		       {0x09, 0x01, 0x03, '0', 0x05, 0x41, 0xB0, 0, 0, 0, 0, 0, 0, 0x03, '2', 0x06, 0x00, 0x01});
+		expect("associative array back to AMF0", back, associative);
+	}
+
+	/// HF v0.7 data files wrap each AMF0 element in an AMF3 byte array
+	void byteArray(vector<uint8_t> &v, const vector<uint8_t> &amf0) {
+		v.push_back(0x0C);
+		v.push_back(static_cast<uint8_t>((amf0.size() << 1) | 1));
+		v.insert(v.end(), amf0.begin(), amf0.end());
+	}
+
+	void dataFile() {
+		vector<uint8_t> limbPic;
+		limbPic.push_back(0x03);
+		amf0Utf8(limbPic, "name");
+		amf0String(limbPic, "arm");
+		amf0ObjectEnd(limbPic);
+		vector<uint8_t> limb;
+		limb.push_back(0x10);
+		amf0Utf8(limb, "Limb");
+		amf0Utf8(limb, "pic");
+		amf0Number(limb, 0.0);
+		amf0ObjectEnd(limb);
+
+		vector<uint8_t> hf;
+		amf0Utf8(hf, "limbInfo");
+		hf.insert(hf.end(), {0, 0, 0, 1});
+		byteArray(hf, limbPic);
+		hf.push_back(0x01);  // no PNG
+		hf.insert(hf.end(), {0, 0, 0, 1});
+		byteArray(hf, limb);
+
+		vector<uint8_t> expected;
+		amf0Utf8(expected, "limbInfoO");
+		expected.insert(expected.end(), {0, 0, 0, 1});
+		amf0ToAmf3(limbPic.data(), limbPic.size(), expected);
+		expected.push_back(0x01);
+		expected.insert(expected.end(), {0, 0, 0, 1});
+		amf0ToAmf3(limb.data(), limb.size(), expected);
+
+		vector<uint8_t> hfx = convertDataFile(hf);
+		expect("limbInfo to limbInfoO", hfx, expected);
+		expect("limbInfoO to limbInfo", convertDataFile(hfx), hf);
+
+		vector<uint8_t> gdat;
+		amf0Utf8(gdat, "gdat");
+		gdat.insert(gdat.end(), {0, 0, 0, 0, 0, 0, 0, 0});
+		expect("gdat left as it is", convertDataFile(gdat), gdat);
+	}
+
+	void malformed() {
+		const vector<vector<uint8_t>> amf0Values = {
+			{0x07, 0x00, 0x00},                 // reference to nothing
+			{0x03, 0x00, 0x01, 'a'},            // truncated object
+			{0x0D},                             // unsupported
+		};
+		for (size_t i = 0; i < amf0Values.size(); ++i) {
+			vector<uint8_t> out;
+			bool thrown = false;
+			try {
+				amf0ToAmf3(amf0Values[i].data(), amf0Values[i].size(), out);
+			} catch (const runtime_error &) {
+				thrown = true;
+			}
+			expectThrown("malformed AMF0 " + to_string(i), thrown);
+		}
+
+		const vector<vector<uint8_t>> amf3Values = {
+			{0x0C, 0x03, 0x00},                 // byte array
+			{0x09, 0x05, 0x01, 0x08, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0x08, 0x02},  // reference to a date
+			{0x0A, 0x07, 0x01},                 // externalizable object
+		};
+		for (size_t i = 0; i < amf3Values.size(); ++i) {
+			vector<uint8_t> out;
+			size_t pos = 0;
+			bool thrown = false;
+			try {
+				amf3ToAmf0(amf3Values[i].data(), amf3Values[i].size(), pos, out);
+			} catch (const runtime_error &) {
+				thrown = true;
+			}
+			expectThrown("malformed AMF3 " + to_string(i), thrown);
+		}
+	}
+
+} // anonymous namespace
+
+int main() {
+	limbLikeValue();
+	referencesAfterDate();
+	ecmaArrays();
+	dataFile();
+	malformed();
+	return failures == 0 ? 0 : 1;
+}
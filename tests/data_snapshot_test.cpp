@@ -0,0 +1,232 @@
+/**
+ * HF Workshop - Data snapshot test
+ *
+ * A snapshot written by DataSnapshotWriter must read back through
+ * DataSnapshot with the same tables, column types and missing values, and
+ * with every column aligned for scanning in place.
+ */
+
+#include <cmath>   // isnan
+#include <cstdio>
+#include <cstring> // memcpy
+#include <string>
+#include <vector>
+#include <cstdint> // uint8_t, uint32_t, uint64_t, uintptr_t
+#include <cstddef> // size_t
+
+#include "data_model.hpp"
+#include "data_snapshot.hpp"
+
+using namespace std;
+using namespace hf_workshop;
+
+namespace {
+
+	int failures = 0;
+
+	void expect(const string &name, bool ok) {
+		if (ok) {
+			printf("ok   %s\n", name.c_str());
+		} else {
+			printf("FAIL %s\n", name.c_str());
+			++failures;
+		}
+	}
+
+	void append(vector<uint8_t> &v, const string &s) {
+		v.insert(v.end(), s.begin(), s.end());
+	}
+
+	/// AMF0 object key or string without its marker
+	void amf0Utf8(vector<uint8_t> &v, const string &s) {
+		v.push_back(static_cast<uint8_t>(s.size() >> 8));
+		v.push_back(static_cast<uint8_t>(s.size()));
+		append(v, s);
+	}
+
+	void amf0Number(vector<uint8_t> &v, double d) {
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof(bits));
+		v.push_back(0x00);
+		for (int shift = 56; shift >= 0; shift -= 8) {
+			v.push_back(static_cast<uint8_t>(bits >> shift));
+		}
+	}
+
+	void amf0String(vector<uint8_t> &v, const string &s) {
+		v.push_back(0x02);
+		amf0Utf8(v, s);
+	}
+
+	void amf0Boolean(vector<uint8_t> &v, bool b) {
+		v.push_back(0x01);
+		v.push_back(b ? 1 : 0);
+	}
+
+	void amf0ObjectEnd(vector<uint8_t> &v) {
+		v.insert(v.end(), {0x00, 0x00, 0x09});
+	}
+
+	/// HF v0.7 data files wrap each AMF0 element in an AMF3 byte array
+	void byteArray(vector<uint8_t> &v, const vector<uint8_t> &amf0) {
+		size_t u = (amf0.size() << 1) | 1;
+		v.push_back(0x0C);
+		if (u >= 0x80) {
+			v.push_back(static_cast<uint8_t>((u >> 7) | 0x80));
+		}
+		v.push_back(static_cast<uint8_t>(u & 0x7F));
+		v.insert(v.end(), amf0.begin(), amf0.end());
+	}
+
+	/**
+	 * A limb info file whose LimbPics don't all have the same members, and
+	 * whose "size" is a number in one and a string in another
+	 */
+	vector<uint8_t> limbInfo() {
+		vector<vector<uint8_t>> pics(3);
+		pics[0].push_back(0x03);
+		amf0Utf8(pics[0], "name");
+		amf0String(pics[0], "arm");
+		amf0Utf8(pics[0], "disabled");
+		amf0Boolean(pics[0], true);
+		amf0Utf8(pics[0], "size");
+		amf0Number(pics[0], 2.0);
+		amf0Utf8(pics[0], "x");
+		amf0Number(pics[0], 1.5);
+		amf0ObjectEnd(pics[0]);
+
+		pics[1].push_back(0x03);
+		amf0Utf8(pics[1], "name");
+		amf0String(pics[1], "leg");
+		amf0Utf8(pics[1], "size");
+		amf0String(pics[1], "big");
+		amf0ObjectEnd(pics[1]);
+
+		pics[2].push_back(0x03);
+		amf0Utf8(pics[2], "name");
+		amf0String(pics[2], "head");
+		amf0Utf8(pics[2], "disabled");
+		amf0Boolean(pics[2], false);
+		amf0Utf8(pics[2], "parts");
+		pics[2].insert(pics[2].end(), {0x08, 0, 0, 0, 2});
+		amf0Utf8(pics[2], "0");
+		amf0Number(pics[2], 1.0);
+		amf0Utf8(pics[2], "1");
+		amf0Number(pics[2], 2.0);
+		amf0ObjectEnd(pics[2]);
+		amf0ObjectEnd(pics[2]);
+
+		vector<uint8_t> file;
+		amf0Utf8(file, "limbInfo");
+		file.insert(file.end(), {0, 0, 0, 3});
+		for (const auto &pic : pics) {
+			byteArray(file, pic);
+		}
+		file.insert(file.end(), {0x01, 0x01, 0x01});  // no PNGs
+		file.insert(file.end(), {0, 0, 0, 0});        // no Limbs
+		return file;
+	}
+
+	bool hasType(const SnapshotTable::Column *c, SnapshotType type) {
+		return c != nullptr && c->type == type;
+	}
+
+	bool textIs(const DataSnapshot &snapshot, const SnapshotTable::Column *c, size_t row, const string &expected) {
+		return hasType(c, SnapshotType::string) && c->strings()[row] != SnapshotTable::NO_STRING &&
+		       snapshot.text(c->strings()[row]) == expected;
+	}
+
+	uint64_t tableIndex(const DataSnapshot &snapshot, const SnapshotTable *t) {
+		return static_cast<uint64_t>(t - snapshot.tables().data());
+	}
+
+	bool writeSnapshot(const string &fileName) {
+		DataModel model(limbInfo());
+		DataSnapshotWriter writer;
+		writer.add(7, model);
+		vector<uint8_t> bytes = writer.serialize();
+		FILE *f = fopen(fileName.c_str(), "wb");
+		if (f == nullptr) {
+			return false;
+		}
+		bool written = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+		return fclose(f) == 0 && written;
+	}
+
+	void readSnapshot(const DataSnapshot &snapshot) {
+		const SnapshotTable *pics = snapshot.table("LimbPic");
+		expect("LimbPic table", pics != nullptr && pics->rows == 3);
+		if (pics == nullptr || pics->rows != 3) {
+			return;
+		}
+
+		const auto *file = pics->column("$file");
+		const auto *parent = pics->column("$parent");
+		const auto *field = pics->column("$field");
+		const auto *index = pics->column("$index");
+		bool ok = hasType(file, SnapshotType::integer) && hasType(parent, SnapshotType::ref) &&
+		          hasType(field, SnapshotType::string) && hasType(index, SnapshotType::integer);
+		for (size_t i = 0; ok && i < 3; ++i) {
+			ok = file->integers()[i] == 7 && parent->refs()[i] == SnapshotTable::NO_REF &&
+			     field->strings()[i] == SnapshotTable::NO_STRING && index->integers()[i] == i;
+		}
+		expect("LimbPic bookkeeping columns", ok);
+
+		const auto *name = pics->column("name");
+		expect("string column", textIs(snapshot, name, 0, "arm") && textIs(snapshot, name, 1, "leg") &&
+		                        textIs(snapshot, name, 2, "head"));
+
+		const auto *disabled = pics->column("disabled");
+		expect("boolean column with a missing value", hasType(disabled, SnapshotType::boolean) &&
+		       disabled->booleans()[0] == 1 && disabled->booleans()[1] == SnapshotTable::MISSING_BOOLEAN &&
+		       disabled->booleans()[2] == 0);
+
+		const auto *x = pics->column("x");
+		expect("number column with missing values", hasType(x, SnapshotType::number) &&
+		       x->numbers()[0] == 1.5 && isnan(x->numbers()[1]) && isnan(x->numbers()[2]));
+
+		const auto *size = pics->column("size");
+		expect("mixed column kept as text", textIs(snapshot, size, 0, "2") && textIs(snapshot, size, 1, "big") &&
+		       size->strings()[2] == SnapshotTable::NO_STRING);
+
+		expect("member holding a record has no column", pics->column("parts") == nullptr);
+
+		const SnapshotTable *parts = snapshot.table("LimbPic.parts");
+		const SnapshotTable *items = snapshot.table("LimbPic.parts.item");
+		ok = parts != nullptr && parts->rows == 1 && items != nullptr && items->rows == 2;
+		if (ok) {
+			const auto *partsParent = parts->column("$parent");
+			const auto *partsField = parts->column("$field");
+			const auto *itemsParent = items->column("$parent");
+			const auto *value = items->column("value");
+			ok = hasType(partsParent, SnapshotType::ref) && partsParent->refs()[0] == (tableIndex(snapshot, pics) << 32 | 2) &&
+			     textIs(snapshot, partsField, 0, "parts") &&
+			     hasType(itemsParent, SnapshotType::ref) && itemsParent->refs()[1] == tableIndex(snapshot, parts) << 32 &&
+			     hasType(value, SnapshotType::number) && value->numbers()[0] == 1.0 && value->numbers()[1] == 2.0;
+		}
+		expect("array and its items", ok);
+
+		ok = true;
+		for (const auto &t : snapshot.tables()) {
+			for (const auto &c : t.columns) {
+				ok = ok && reinterpret_cast<uintptr_t>(c.data) % 64 == 0;
+			}
+		}
+		expect("columns aligned to 64 bytes", ok);
+	}
+
+} // anonymous namespace
+
+int main() {
+	const string fileName = "data_snapshot_test.hfs";
+	bool written = writeSnapshot(fileName);
+	expect("snapshot written", written);
+	if (written) {
+		{
+			DataSnapshot snapshot(fileName);
+			readSnapshot(snapshot);
+		}
+		remove(fileName.c_str());
+	}
+	return failures == 0 ? 0 : 1;
+}
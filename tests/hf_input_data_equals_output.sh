@@ -33,7 +33,7 @@ out=HF_out.swf
 testFiles() {
 
 	echo "Processing $in...";
-	echo -e "$in\n5\n2\nall\n0\n0\n" | ./HFWorkshop >/dev/null 2>&1
+	echo -e "$in\n5\n2\nall\n0\n0\n" | ./HFWorkshop --no-png-optimization >/dev/null 2>&1
 
 	# Working with bash arrays: 
 	# - https://linuxconfig.org/how-to-use-arrays-in-bash-script
@@ -59,7 +59,7 @@ testFiles() {
 
 		input_str+="0\n\n6\n0\n\n0\n"
 
-		echo -e "$input_str" | ./HFWorkshop >/dev/null 2>&1
+		echo -e "$input_str" | ./HFWorkshop --no-png-optimization >/dev/null 2>&1
 
 		echo "Processing $value...";
 
@@ -0,0 +1,119 @@
+/**
+ * HF Workshop - JSON to AMF test
+ *
+ * The AMF that JsonAmfWriter gives for JSON like the one exportData writes
+ * must be the bytes of libswf's serialize() for the same JSON, which is
+ * what replaceData wrote before the writer.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstdint> // uint8_t
+#include <cstddef> // size_t
+
+#include <json.hpp>
+
+#include "amf0.hpp"
+#include "amf3.hpp"
+#include "json_amf.hpp"
+
+using namespace std;
+using namespace hf_workshop;
+
+namespace {
+
+	int failures = 0;
+
+	void printBytes(const vector<uint8_t> &bytes) {
+		for (uint8_t b : bytes) {
+			printf(" %02x", b);
+		}
+		printf("\n");
+	}
+
+	void expect(const string &name, bool written, const vector<uint8_t> &out, const vector<uint8_t> &expected) {
+		if (written && out == expected) {
+			printf("ok   %s\n", name.c_str());
+			return;
+		}
+		printf("FAIL %s:%s", name.c_str(), written ? "" : " not written\n");
+		if (written) {
+			printBytes(out);
+			printf("--- libswf ---\n");
+			printBytes(expected);
+		}
+		++failures;
+	}
+
+	/// JSON shaped like the data files of both games, from exportData
+	const vector<string> SAMPLES = {
+		"{}",
+		"[]",
+		"{\n"
+		"    \"name\": \"a\",\n"
+		"    \"n\": -2,\n"
+		"    \"x\": 2.0,\n"
+		"    \"y\": 1.5,\n"
+		"    \"big\": 268435456,\n"
+		"    \"small\": -268435457,\n"
+		"    \"max\": 268435455,\n"
+		"    \"min\": -268435456,\n"
+		"    \"huge\": 18446744073709551615,\n"
+		"    \"parts\": [\n"
+		"        {\n"
+		"            \"name\": \"b\"\n"
+		"        },\n"
+		"        {\n"
+		"            \"name\": \"a\"\n"
+		"        }\n"
+		"    ],\n"
+		"    \"ok\": true,\n"
+		"    \"off\": false,\n"
+		"    \"none\": null\n"
+		"}",
+		"{\"list\": [[1, 2], [], {}, [{\"a\": [\"\", \"x\", \"x\"]}]], \"e\": {\"\xC3\xA9\": \"\xC3\xA9\\u0001\"}}",
+		"{\"a\": {\"p\": [1, 2]}, \"b\": {\"p\": [1, 2]}, \"c\": [1, 2]}",
+		"{\"z\": -0.0, \"e\": 1e300, \"f\": 0.1, \"i\": 1E2}",
+		"[\"" + string(70000, 'x') + "\", \"" + string(300, 'y') + "\"]",
+	};
+
+	void compareWithLibswf() {
+		for (size_t i = 0; i < SAMPLES.size(); ++i) {
+			swf::json json = swf::json::parse(SAMPLES[i], nullptr, true, true);
+
+			JsonAmfWriter writer;
+			vector<uint8_t> out;
+			bool written = writer.writeAmf3(SAMPLES[i], out);
+			expect("amf3 sample " + to_string(i), written, out, swf::AMF3{json}.serialize());
+
+			out.clear();
+			written = writer.writeAmf0(SAMPLES[i], out);
+			expect("amf0 sample " + to_string(i), written, out, swf::AMF0{json}.serialize());
+		}
+	}
+
+	void topLevelBooleans() {
+		JsonAmfWriter writer;
+		vector<uint8_t> out;
+		bool written = writer.writeAmf3("{\"disabled\": true, \"n\": 1, \"o\": {\"embeded\": false}}", out);
+		const auto &booleans = writer.topLevelBooleans();
+		bool ok = written && booleans.size() == 1 && booleans[0].first == "disabled" && booleans[0].second;
+		expect("top-level booleans", ok, {}, {});
+	}
+
+	void unsupported() {
+		JsonAmfWriter writer;
+		vector<uint8_t> out = {0xAB};
+		bool written = writer.writeAmf3("{\"a\": 1, \"a\": 2}", out);
+		expect("repeated key left to libswf", !written, out, {0xAB});
+	}
+
+} // anonymous namespace
+
+int main() {
+	compareWithLibswf();
+	topLevelBooleans();
+	unsupported();
+	return failures == 0 ? 0 : 1;
+}
@@ -2,7 +2,8 @@
 
 # Place this file in a folder with uncompressed SWFs to test. HFW will parse
 # each SWF file and export it uncompressed, then the script will compare
-# if the saved file is exactly equal to the original.
+# if the saved file is exactly equal to the original. The same check is then
+# made for all the files at once with the batch mode.
 
 printf " ------------------------------------------------------------\n"
 printf " \tHFW test if SWF output is equal to SWF input.\n"
@@ -20,9 +21,15 @@ LGREEN='\e[102m'
 BOLD='\e[1m'
 
 out=HF_out.swf
+failed=0
 
+# One process per file through the "Export SWF" menu, which writes the file
+# the way the batch mode doesn't
 for f in *.swf;
 do
+	if [ "$f" = "$out" ]; then
+		continue
+	fi
 	echo "Processing $f...";
 	echo -e "$f\n6\n0\n\n0\n" | ./HFWorkshop >/dev/null 2>&1
 
@@ -30,5 +37,18 @@ do
 		echo -e "${BOLD}${GREEN}${INV}OK!${NC}"
 	else
 		echo -e "${BOLD}${RED}${BLINK1}${INV}FAIL${NC}"
+		failed=1
 	fi
 done
+rm -f -- "$out"
+
+# All the SWFs are checked by one process, on every core
+echo "Verifying all the files in batch mode...";
+if ./HFWorkshop --batch verify *.swf; then
+	echo -e "${BOLD}${GREEN}${INV}OK!${NC}"
+else
+	echo -e "${BOLD}${RED}${BLINK1}${INV}FAIL${NC}"
+	failed=1
+fi
+
+exit $failed